@@ -0,0 +1,739 @@
+/* zbench.c - Micro-benchmarks for the Frotz core
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * zbench times parts of the interpreter core on a story, with no
+ * screen or terminal in the way, so that changes to them can be
+ * measured.  It is built with "make zbench" and run as
+ *
+ *	zbench [-t seconds] [-r repetitions] [-f text|csv|json] [story]
+ *
+ * With no story, a large synthetic V8 story is made in a temporary
+ * file.  Besides random data it holds what the kernels below work on:
+ * a dictionary of 1000 words, a text buffer, an object with 63
+ * properties, an encoded string, a table to copy and a pair of
+ * routines that loop through about 8000 instructions.  Given a story,
+ * only the save and restore kernels run, since the others need these.
+ *
+ * Before timing starts, dynamic memory outside these is changed at
+ * random so that saves look like those made in the middle of a game.
+ * Each kernel is first run, doubling the number of runs, until a batch
+ * takes at least the given time (a tenth of a second unless -t says
+ * otherwise); this also warms the caches.  Then that many runs are
+ * timed the given number of times (5 unless -r says otherwise), and
+ * the fastest, median, mean, standard deviation and slowest time per
+ * run over those repetitions are printed as a table, CSV or JSON.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../common/frotz.h"
+
+extern void init_memory (void);
+extern void init_undo (void);
+extern void reset_memory (void);
+extern zword restore_quetzal (FILE *, FILE *);
+extern long mem_diff (zbyte *, zbyte *, zword, zbyte *);
+extern bool mem_undiff (zbyte *, long, zbyte *, zword);
+extern void tokenise_line (zword, zword, zword, bool);
+extern int direct_call (zword);
+
+/* The synthetic story: 256K with nearly 60K of dynamic memory */
+#define SYNTH_SIZE	0x40000L
+#define SYNTH_DYNAMIC	0xF000
+
+/* Where the kernels' data lives in the synthetic story */
+#define GLOBALS		0x0100
+#define ABBREVIATIONS	0x02e0
+#define OBJECTS		0x0300
+#define OBJECT_COUNT	16
+#define PROPERTIES	0x0460
+#define DICTIONARY	0x1000
+#define DICTIONARY_WORDS 1000
+#define TEXT_BUFFER	0x3400
+#define PARSE_BUFFER	0x3500
+#define WORD_BUFFER	0x3600
+#define ENCODED_WORD	0x3680
+#define STRING		0x3700
+#define COPY_FROM	0x3800
+#define COPY_TO		0x3c00
+#define COPY_SIZE	0x0400
+#define ARRAY		0x4000
+#define FIXTURES_END	0x4100
+#define MAIN_ROUTINE	0x10000L
+#define SUB_ROUTINE	0x10040L
+#define STORE_TO_STACK	0x10080L
+
+static double min_time = 0.1;
+static int repetitions = 5;
+static zlong seed = 12345;
+
+static enum { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON } format = FORMAT_TEXT;
+
+static bool synthetic = FALSE;
+static FILE *story = NULL;
+static FILE *save_file = NULL;
+static membuf_t save_data = { NULL, 0, 0 };
+static zbyte *orig = NULL;
+static zbyte *prev = NULL;
+static zbyte *diff = NULL;
+static long diff_length = 0;
+
+
+/*
+ * next_random
+ *
+ * Return the next number from a generator of our own, so that runs
+ * are repeatable.
+ *
+ */
+static zlong next_random(void)
+{
+	return xorshift(&seed);
+} /* next_random */
+
+
+/*
+ * put_word
+ *
+ * Store a word in story data, high byte first.
+ *
+ */
+static void put_word(zbyte *data, long addr, zword value)
+{
+	data[addr] = value >> 8;
+	data[addr + 1] = value & 0xff;
+} /* put_word */
+
+
+/*
+ * encode_string
+ *
+ * Encode lower case letters, spaces and the punctuation of alphabet 2
+ * as Z-characters, padded to at least min_length of them, and store
+ * the result at out.  Return the number of bytes stored.
+ *
+ */
+static int encode_string(zbyte *out, const char *s, int min_length)
+{
+	static const char a2[] = "\n0123456789.,!?_#'\"/\\-:()";
+	zbyte zchars[600];
+	const char *p;
+	zword w;
+	int n = 0;
+	int i;
+
+	for (; *s != '\0' && n < 590; s++) {
+		if (*s == ' ')
+			zchars[n++] = 0;
+		else if (*s >= 'a' && *s <= 'z')
+			zchars[n++] = *s - 'a' + 6;
+		else if ((p = strchr(a2, *s)) != NULL) {
+			zchars[n++] = 5;
+			zchars[n++] = p - a2 + 7;
+		}
+	}
+	while (n < min_length || n % 3 != 0)
+		zchars[n++] = 5;
+
+	for (i = 0; i < n; i += 3) {
+		w = (zchars[i] << 10) | (zchars[i + 1] << 5) | zchars[i + 2];
+		if (i + 3 == n)
+			w |= 0x8000;
+		put_word(out, i / 3 * 2, w);
+	}
+	return n / 3 * 2;
+} /* encode_string */
+
+
+/*
+ * dictionary_word
+ *
+ * Return the i-th word of the synthetic dictionary.  The words are six
+ * letters long and come out in alphabetical order, which is also the
+ * order of their encoded forms.
+ *
+ */
+static const char *dictionary_word(int i)
+{
+	static char word[7];
+	long n = i * 307L + 11;
+	int k;
+
+	for (k = 5; k >= 0; k--) {
+		word[k] = 'a' + n % 26;
+		n /= 26;
+	}
+	word[6] = '\0';
+	return word;
+} /* dictionary_word */
+
+
+/*
+ * put_text_buffer
+ *
+ * Store a V5 text buffer holding the given line.
+ *
+ */
+static void put_text_buffer(zbyte *data, long addr, const char *line)
+{
+	data[addr] = 200;
+	data[addr + 1] = strlen(line);
+	memcpy(data + addr + 2, line, strlen(line));
+} /* put_text_buffer */
+
+
+/*
+ * put_fixtures
+ *
+ * Lay out the data and code the kernels work on.
+ *
+ */
+static void put_fixtures(zbyte *data)
+{
+	static const zbyte main_routine[] = {
+		0x04,				/* 4 locals */
+		0xcd, 0x4f, 0x01, 0x03, 0xe8,	/* store L1 1000 */
+		0x74, 0x02, 0x01, 0x02,		/* loop: add L2 L1 -> L2 */
+		0xc9, 0x8f, 0x02, 0x7f, 0xff, 0x02, /* and L2 $7fff -> L2 */
+		0xe1, 0x1b, 0x40, 0x00, 0x05, 0x01, /* storew ARRAY 5 L1 */
+		0xcf, 0x1f, 0x40, 0x00, 0x05, 0x03, /* loadw ARRAY 5 -> L3 */
+		0xd9, 0x2f, 0x20, 0x08, 0x03, 0x04, /* call_2s sub L3 -> L4 */
+		0x04, 0x01, 0x01, 0x3f, 0xe1,	/* dec_chk L1 1 ?~loop */
+		0xab, 0x02			/* ret L2 */
+	};
+	static const zbyte sub_routine[] = {
+		0x01,				/* 1 local */
+		0x56, 0x01, 0x03, 0x00,		/* mul L1 3 -> sp */
+		0xb8				/* ret_popped */
+	};
+	char line[400];
+	long addr;
+	int i;
+
+	memset(data + 64, 0, FIXTURES_END - 64);
+
+	/* Objects: the first has properties 63 down to 1, so that looking
+	 * up property 1 goes through the whole list; the rest have none */
+	for (i = 0; i < OBJECT_COUNT; i++)
+		put_word(data, OBJECTS + 126 + 14 * i + 12,
+			 i == 0 ? PROPERTIES : PROPERTIES + 192);
+	addr = PROPERTIES + 1;
+	for (i = 63; i > 0; i--) {
+		data[addr++] = 0x40 | i;
+		put_word(data, addr, i * 11);
+		addr += 2;
+	}
+
+	/* Dictionary: three separators, then 9-byte entries */
+	addr = DICTIONARY;
+	data[addr++] = 3;
+	data[addr++] = ',';
+	data[addr++] = '.';
+	data[addr++] = '"';
+	data[addr++] = 9;
+	put_word(data, addr, DICTIONARY_WORDS);
+	addr += 2;
+	for (i = 0; i < DICTIONARY_WORDS; i++, addr += 9)
+		encode_string(data + addr, dictionary_word(i), 9);
+
+	/* A line of input with known and unknown words */
+	snprintf(line, sizeof(line), "%s the ", dictionary_word(12));
+	strcat(line, dictionary_word(345));
+	strcat(line, ", ");
+	strcat(line, dictionary_word(678));
+	strcat(line, " and ");
+	strcat(line, dictionary_word(999));
+	strcat(line, ". xyzzy ");
+	strcat(line, dictionary_word(0));
+	strcat(line, " plugh \"");
+	strcat(line, dictionary_word(500));
+	strcat(line, "\" ");
+	strcat(line, dictionary_word(501));
+	put_text_buffer(data, TEXT_BUFFER, line);
+	data[PARSE_BUFFER] = 60;
+	put_text_buffer(data, WORD_BUFFER, dictionary_word(777));
+
+	strcpy(line, "");
+	for (i = 0; i < 4; i++)
+		strcat(line, "the quick brown fox jumps over the lazy dog, "
+			"again and again! ");
+	encode_string(data + STRING, line, 0);
+
+	for (i = 0; i < COPY_SIZE; i++)
+		data[COPY_FROM + i] = (zbyte) next_random();
+
+	memcpy(data + MAIN_ROUTINE, main_routine, sizeof(main_routine));
+	memcpy(data + SUB_ROUTINE, sub_routine, sizeof(sub_routine));
+	data[STORE_TO_STACK] = 0x00;
+} /* put_fixtures */
+
+
+/*
+ * make_story
+ *
+ * Write a synthetic V8 story to a temporary file and return its name.
+ * It holds a header, the kernels' data and random data, and its first
+ * instruction is a quit; nothing here runs it.
+ *
+ */
+static char *make_story(void)
+{
+	static char name[] = "/tmp/zbenchXXXXXX";
+	zbyte *data;
+	FILE *fp;
+	long i;
+	int fd;
+
+	if ((data = malloc(SYNTH_SIZE)) == NULL)
+		return NULL;
+	for (i = 0; i < SYNTH_SIZE; i++)
+		data[i] = (next_random() & 3) ? (zbyte) next_random() : 0;
+
+	memset(data, 0, 64);
+	data[H_VERSION] = V8;
+	data[H_RELEASE + 1] = 1;
+	data[H_RESIDENT_SIZE] = SYNTH_DYNAMIC >> 8;
+	data[H_START_PC] = SYNTH_DYNAMIC >> 8;
+	put_word(data, H_DICTIONARY, DICTIONARY);
+	put_word(data, H_OBJECTS, OBJECTS);
+	put_word(data, H_GLOBALS, GLOBALS);
+	data[H_DYNAMIC_SIZE] = SYNTH_DYNAMIC >> 8;
+	memcpy(data + H_SERIAL, "000000", 6);
+	put_word(data, H_ABBREVIATIONS, ABBREVIATIONS);
+	put_word(data, H_FILE_SIZE, SYNTH_SIZE / 8);
+	data[SYNTH_DYNAMIC] = 0xba;
+	put_fixtures(data);
+
+	if ((fd = mkstemp(name)) < 0 || (fp = fdopen(fd, "wb")) == NULL) {
+		free(data);
+		return NULL;
+	}
+	i = fwrite(data, 1, SYNTH_SIZE, fp);
+	free(data);
+	if (fclose(fp) != 0 || i != SYNTH_SIZE) {
+		unlink(name);
+		return NULL;
+	}
+	return name;
+} /* make_story */
+
+
+/*
+ * dirty_memory
+ *
+ * Change dynamic memory the way a game in progress might: a few bytes
+ * here and there in about a quarter of it.  The kernels' data in the
+ * synthetic story is left alone.
+ *
+ */
+static void dirty_memory(void)
+{
+	zword block, n;
+
+	block = synthetic ? FIXTURES_END : 64;
+	for (; block < z_header.dynamic_size - 64; block += 64) {
+		if (next_random() & 3)
+			continue;
+		for (n = next_random() % 8 + 1; n > 0; n--)
+			zmp[block + next_random() % 64] = (zbyte) next_random();
+	}
+	reset_property_index();
+	reset_object_tree();
+} /* dirty_memory */
+
+
+/*
+ * now
+ *
+ * Return the time in seconds from some fixed point.
+ *
+ */
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+} /* now */
+
+
+/*
+ * The kernels.  Each does one run and returns FALSE if it failed.
+ */
+
+static bool decode(void)
+{
+	zargs[0] = STRING;
+	zargc = 1;
+	z_print_addr();
+	flush_buffer();
+	return TRUE;
+}
+
+static bool encode(void)
+{
+	zargs[0] = WORD_BUFFER + 2;
+	zargs[1] = 6;
+	zargs[2] = 0;
+	zargs[3] = ENCODED_WORD;
+	zargc = 4;
+	z_encode_text();
+	return TRUE;
+}
+
+static bool tokenise_word(void)
+{
+	tokenise_line(WORD_BUFFER, PARSE_BUFFER, 0, FALSE);
+	return zmp[PARSE_BUFFER + 1] == 1 &&
+		(zmp[PARSE_BUFFER + 2] | zmp[PARSE_BUFFER + 3]) != 0;
+}
+
+static bool tokenise(void)
+{
+	tokenise_line(TEXT_BUFFER, PARSE_BUFFER, 0, FALSE);
+	return zmp[PARSE_BUFFER + 1] == 15;
+}
+
+static bool diff_mem(void)
+{
+	memcpy(prev, orig, z_header.dynamic_size);
+	diff_length = mem_diff(zmp, prev, z_header.dynamic_size, diff);
+	return TRUE;
+}
+
+static bool undiff_mem(void)
+{
+	return mem_undiff(diff, diff_length, prev, z_header.dynamic_size);
+}
+
+static bool get_prop(void)
+{
+	zargs[0] = 1;
+	zargs[1] = 1;
+	zargc = 2;
+	SET_PC(STORE_TO_STACK)
+	z_get_prop();
+	return *sp++ == 11;
+}
+
+static bool copy_table(void)
+{
+	zargs[0] = COPY_FROM;
+	zargs[1] = COPY_TO;
+	zargs[2] = COPY_SIZE;
+	zargc = 3;
+	z_copy_table();
+	return TRUE;
+}
+
+static bool dispatch(void)
+{
+	return direct_call(MAIN_ROUTINE / 8) != 0;
+}
+
+static bool save_mem(void)
+{
+	return save_frotz_mem(&save_data) != 0;
+}
+
+static bool restore_mem(void)
+{
+	return restore_frotz_mem(save_data.data, save_data.size) == 2;
+}
+
+static bool save_disk(void)
+{
+	rewind(save_file);
+	return save_frotz(save_file) != 0 && fflush(save_file) == 0;
+}
+
+static bool restore_disk(void)
+{
+	rewind(save_file);
+	return restore_quetzal(save_file, story) == 2;
+}
+
+static struct {
+	const char *name;
+	bool (*run)(void);
+	bool synthetic_only;
+} kernels[] = {
+	{ "decode_text", decode, TRUE },
+	{ "encode_text", encode, TRUE },
+	{ "tokenise_word", tokenise_word, TRUE },
+	{ "tokenise_line", tokenise, TRUE },
+	{ "get_prop", get_prop, TRUE },
+	{ "copy_table", copy_table, TRUE },
+	{ "interpret", dispatch, TRUE },
+	{ "mem_diff", diff_mem, FALSE },
+	{ "mem_undiff", undiff_mem, FALSE },
+	{ "save_mem", save_mem, FALSE },
+	{ "restore_mem", restore_mem, FALSE },
+	{ "save_file", save_disk, FALSE },
+	{ "restore_file", restore_disk, FALSE },
+	{ NULL, NULL, FALSE }
+};
+
+
+/*
+ * time_runs
+ *
+ * Run a kernel the given number of times and return the time taken.
+ *
+ */
+static double time_runs(const char *name, bool (*run)(void), long runs)
+{
+	double start;
+	long n;
+
+	start = now();
+	for (n = 0; n < runs; n++) {
+		if (!run()) {
+			fprintf(stderr, "zbench: %s failed\n", name);
+			exit(EXIT_FAILURE);
+		}
+	}
+	return now() - start;
+} /* time_runs */
+
+
+static int compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+
+/*
+ * print_json_string
+ *
+ * Print a string in quotes, escaped as JSON wants.
+ *
+ */
+static void print_json_string(const char *s)
+{
+	putchar('"');
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\')
+			putchar('\\');
+		if ((unsigned char) *s >= 0x20)
+			putchar(*s);
+	}
+	putchar('"');
+} /* print_json_string */
+
+
+/*
+ * run_kernel
+ *
+ * Time one kernel, doubling the number of runs until they take at
+ * least min_time, then timing that many runs repeatedly, and print
+ * the statistics over the repetitions in nanoseconds per run.
+ *
+ */
+static void run_kernel(const char *name, bool (*run)(void), bool first)
+{
+	double *samples;
+	double sum = 0, mean, median, var = 0;
+	long runs;
+	int i;
+
+	for (runs = 1; time_runs(name, run, runs) < min_time; runs *= 2)
+		;
+
+	if ((samples = malloc(repetitions * sizeof(double))) == NULL) {
+		fprintf(stderr, "zbench: out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < repetitions; i++) {
+		samples[i] = time_runs(name, run, runs) * 1e9 / runs;
+		sum += samples[i];
+	}
+	qsort(samples, repetitions, sizeof(double), compare_doubles);
+
+	mean = sum / repetitions;
+	median = (repetitions % 2) ? samples[repetitions / 2] :
+		(samples[repetitions / 2 - 1] + samples[repetitions / 2]) / 2;
+	for (i = 0; i < repetitions; i++)
+		var += (samples[i] - mean) * (samples[i] - mean);
+	if (repetitions > 1)
+		var /= repetitions - 1;
+
+	switch (format) {
+	case FORMAT_TEXT:
+		printf("%-14s %9ld %11.0f %11.0f %11.0f %9.1f %11.0f\n",
+			name, runs, samples[0], median, mean, sqrt(var),
+			samples[repetitions - 1]);
+		break;
+	case FORMAT_CSV:
+		printf("%s,%ld,%d,%.1f,%.1f,%.1f,%.1f,%.1f\n", name, runs,
+			repetitions, samples[0], median, mean, sqrt(var),
+			samples[repetitions - 1]);
+		break;
+	case FORMAT_JSON:
+		printf("%s\n    {\"kernel\": \"%s\", \"runs\": %ld, "
+			"\"repetitions\": %d, \"min_ns\": %.1f, "
+			"\"median_ns\": %.1f, \"mean_ns\": %.1f, "
+			"\"stddev_ns\": %.1f, \"max_ns\": %.1f}",
+			first ? "" : ",", name, runs, repetitions,
+			samples[0], median, mean, sqrt(var),
+			samples[repetitions - 1]);
+		break;
+	}
+	fflush(stdout);
+	free(samples);
+} /* run_kernel */
+
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: zbench [-t seconds] [-r repetitions] "
+		"[-f text|csv|json] [story]\n");
+	exit(EXIT_FAILURE);
+}
+
+
+int main(int argc, char *argv[])
+{
+	char *synthetic_name = NULL;
+	const char *story_name;
+	bool first = TRUE;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "f:r:t:")) != -1) {
+		switch (c) {
+		case 'f':
+			if (!strcmp(optarg, "text"))
+				format = FORMAT_TEXT;
+			else if (!strcmp(optarg, "csv"))
+				format = FORMAT_CSV;
+			else if (!strcmp(optarg, "json"))
+				format = FORMAT_JSON;
+			else
+				usage();
+			break;
+		case 'r':
+			if ((repetitions = atoi(optarg)) < 1)
+				usage();
+			break;
+		case 't':
+			min_time = atof(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	init_header();
+	init_setup();
+	os_init_setup();
+
+	if (optind < argc)
+		f_setup.story_file = strdup(argv[optind]);
+	else if ((synthetic_name = make_story()) != NULL) {
+		f_setup.story_file = strdup(synthetic_name);
+		synthetic = TRUE;
+	} else {
+		fprintf(stderr, "zbench: can't make a story file\n");
+		return EXIT_FAILURE;
+	}
+	f_setup.story_name = strdup(f_setup.story_file);
+
+	init_buffer();
+	init_err();
+	init_memory();
+	init_process();
+	init_sound();
+	os_init_screen();
+	init_undo();
+	z_restart();
+
+	/* Text the kernels print goes nowhere */
+	ostream_screen = FALSE;
+
+	story = fopen(f_setup.story_file, "rb");
+	save_file = tmpfile();
+	if (synthetic)
+		unlink(synthetic_name);
+	orig = malloc(z_header.dynamic_size);
+	prev = malloc(z_header.dynamic_size);
+	diff = malloc(2 * (long) z_header.dynamic_size + 8);
+	if (story == NULL || save_file == NULL || orig == NULL ||
+	    prev == NULL || diff == NULL) {
+		fprintf(stderr, "zbench: can't open files\n");
+		return EXIT_FAILURE;
+	}
+
+	memcpy(orig, zmp, z_header.dynamic_size);
+	dirty_memory();
+	memcpy(prev, orig, z_header.dynamic_size);
+	diff_length = mem_diff(zmp, prev, z_header.dynamic_size, diff);
+	if (!save_mem() || !save_disk()) {
+		fprintf(stderr, "zbench: can't save\n");
+		return EXIT_FAILURE;
+	}
+
+	story_name = synthetic ? "(synthetic)" : f_setup.story_file;
+	switch (format) {
+	case FORMAT_TEXT:
+		printf("Story %s: V%d, %u bytes of dynamic memory, "
+			"%ld byte saves\n", story_name, z_header.version,
+			z_header.dynamic_size, save_data.size);
+		printf("%-14s %9s %11s %11s %11s %9s %11s\n", "kernel",
+			"runs", "min ns", "median ns", "mean ns", "stddev",
+			"max ns");
+		break;
+	case FORMAT_CSV:
+		printf("kernel,runs,repetitions,min_ns,median_ns,mean_ns,"
+			"stddev_ns,max_ns\n");
+		break;
+	case FORMAT_JSON:
+		printf("{\n  \"story\": ");
+		print_json_string(story_name);
+		printf(",\n  \"version\": %d,\n  \"dynamic_size\": %u,\n"
+			"  \"save_size\": %ld,\n  \"kernels\": [",
+			z_header.version, z_header.dynamic_size,
+			save_data.size);
+		break;
+	}
+
+	for (i = 0; kernels[i].name != NULL; i++) {
+		if (kernels[i].synthetic_only && !synthetic)
+			continue;
+		run_kernel(kernels[i].name, kernels[i].run, first);
+		first = FALSE;
+	}
+	if (format == FORMAT_JSON)
+		printf("\n  ]\n}\n");
+
+	fclose(save_file);
+	fclose(story);
+	free(orig);
+	free(prev);
+	free(diff);
+	reset_memory();
+	return EXIT_SUCCESS;
+} /* main */
@@ -0,0 +1,259 @@
+/* bgsave.c - Writing saved games on a background thread
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Writing a save file means encoding the game state as Quetzal data,
+ * writing it out and waiting for it to reach the disk, which on slow
+ * or network storage takes far longer than the turn itself.  Instead,
+ * bg_save copies dynamic memory, the stack and the program counter and
+ * queues the copy; a writer thread does the rest while the game goes
+ * on.  At most SAVE_QUEUE_DEPTH saves wait at a time; beyond that
+ * bg_save waits for room, so a slow disk holds the game back rather
+ * than piling up memory.
+ *
+ * Once a save has been queued the game has been told it succeeded.  If
+ * writing it fails after all, a warning is given as soon as the game
+ * saves again, restores or ends, whichever comes first, and the next
+ * save is made in the foreground so any error is reported as usual.
+ * Files are finished before the interpreter exits and before any save
+ * file is read, so a game never restores a save that is still being
+ * written.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frotz.h"
+
+#ifndef NO_THREADS
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#define SAVE_QUEUE_DEPTH 4
+
+extern zword save_quetzal_snapshot (FILE *, const zbyte *, const zsnapshot_t *);
+
+typedef struct {
+	char *name;
+	zsnapshot_t snap;
+} save_job_t;
+
+static save_job_t queue[SAVE_QUEUE_DEPTH];
+static int queue_first = 0;
+static int queue_count = 0;
+static bool writing = FALSE;
+static bool failed = FALSE;
+static const zbyte *queue_orig = NULL;
+
+static bool started = FALSE;
+static pthread_t writer;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_changed = PTHREAD_COND_INITIALIZER;
+
+
+/*
+ * write_job
+ *
+ * Write one save to its file and wait for it to reach the disk.
+ * Return TRUE if all went well.
+ *
+ */
+static bool write_job(save_job_t *job, const zbyte *orig)
+{
+	FILE *fp;
+	bool ok;
+
+	if ((fp = fopen(job->name, "wb")) == NULL)
+		return FALSE;
+	ok = save_quetzal_snapshot(fp, orig, &job->snap) != 0;
+	ok = fflush(fp) == 0 && ok;
+	ok = fsync(fileno(fp)) == 0 && ok;
+	return fclose(fp) == 0 && ok;
+} /* write_job */
+
+
+/*
+ * free_job
+ *
+ * Free what a save in the queue holds.
+ *
+ */
+static void free_job(save_job_t *job)
+{
+	free(job->name);
+	free(job->snap.mem);
+	free(job->snap.stack);
+	job->name = NULL;
+	job->snap.mem = NULL;
+	job->snap.stack = NULL;
+} /* free_job */
+
+
+/*
+ * write_saves
+ *
+ * The writer thread: write queued saves, oldest first.
+ *
+ */
+static void *write_saves(void * UNUSED (arg))
+{
+	save_job_t *job;
+	bool ok;
+
+	pthread_mutex_lock(&queue_lock);
+	for (;;) {
+		while (queue_count == 0)
+			pthread_cond_wait(&queue_changed, &queue_lock);
+
+		job = &queue[queue_first];
+		writing = TRUE;
+		pthread_mutex_unlock(&queue_lock);
+
+		ok = write_job(job, queue_orig);
+		free_job(job);
+
+		pthread_mutex_lock(&queue_lock);
+		if (!ok)
+			failed = TRUE;
+		queue_first = (queue_first + 1) % SAVE_QUEUE_DEPTH;
+		queue_count--;
+		writing = FALSE;
+		pthread_cond_broadcast(&queue_changed);
+	}
+	return NULL;
+} /* write_saves */
+
+
+/*
+ * bg_save_flush
+ *
+ * Wait until every queued save has been written.  Return FALSE if any
+ * of them failed since the last check.
+ *
+ */
+bool bg_save_flush(void)
+{
+	bool ok;
+
+	if (!started)
+		return TRUE;
+
+	pthread_mutex_lock(&queue_lock);
+	while (queue_count > 0 || writing)
+		pthread_cond_wait(&queue_changed, &queue_lock);
+	ok = !failed;
+	failed = FALSE;
+	pthread_mutex_unlock(&queue_lock);
+	return ok;
+} /* bg_save_flush */
+
+
+/*
+ * finish_saves
+ *
+ * Called at exit, so that no save is lost half written.
+ *
+ */
+static void finish_saves(void)
+{
+	if (!bg_save_flush())
+		fprintf(stderr, "Error writing save file\n");
+} /* finish_saves */
+
+
+/*
+ * bg_save
+ *
+ * Queue a save of the game to the named file.  orig holds the original
+ * contents of dynamic memory, and must stay put until bg_save_flush
+ * has been called.  Return 1 if the save was queued, or 0 if it must
+ * be made in the foreground.
+ *
+ */
+zword bg_save(const char *name, const zbyte *orig)
+{
+	save_job_t *job;
+	sigset_t mask, old_mask;
+	int error;
+
+	if (!started) {
+		/* Leave the sampling profiler's ticks to the game */
+		sigemptyset(&mask);
+		sigaddset(&mask, SIGPROF);
+		pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+		error = pthread_create(&writer, NULL, write_saves, NULL);
+		pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+		if (error != 0)
+			return 0;
+		pthread_detach(writer);
+		atexit(finish_saves);
+		started = TRUE;
+	}
+
+	pthread_mutex_lock(&queue_lock);
+	while (queue_count == SAVE_QUEUE_DEPTH && !failed)
+		pthread_cond_wait(&queue_changed, &queue_lock);
+	if (failed) {
+		failed = FALSE;
+		pthread_mutex_unlock(&queue_lock);
+		print_string("Error writing an earlier save file\n");
+		return 0;
+	}
+	job = &queue[(queue_first + queue_count) % SAVE_QUEUE_DEPTH];
+	pthread_mutex_unlock(&queue_lock);
+
+	/* Only this thread adds to the queue, so the slot stays free */
+	job->name = strdup(name);
+	job->snap.mem = malloc(z_header.dynamic_size);
+	job->snap.stack = malloc(STACK_SIZE * sizeof(zword));
+	if (job->name == NULL || job->snap.mem == NULL ||
+	    job->snap.stack == NULL) {
+		free_job(job);
+		return 0;
+	}
+	memcpy(job->snap.mem, zmp, z_header.dynamic_size);
+	memcpy(job->snap.stack, stack, STACK_SIZE * sizeof(zword));
+	job->snap.sp = sp - stack;
+	job->snap.fp = fp - stack;
+	GET_PC(job->snap.pc);
+	job->snap.copy = TRUE;
+
+	pthread_mutex_lock(&queue_lock);
+	queue_orig = orig;
+	queue_count++;
+	pthread_cond_broadcast(&queue_changed);
+	pthread_mutex_unlock(&queue_lock);
+	return 1;
+} /* bg_save */
+
+#else /* NO_THREADS */
+
+zword bg_save(const char * UNUSED (name), const zbyte * UNUSED (orig))
+{
+	return 0;
+} /* bg_save */
+
+bool bg_save_flush(void)
+{
+	return TRUE;
+} /* bg_save_flush */
+
+#endif /* NO_THREADS */
@@ -18,6 +18,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include "frotz.h"
 
@@ -25,8 +26,18 @@ extern void stream_char (zchar);
 extern void stream_word (const zchar *);
 extern void stream_new_line (void);
 
-static zchar buffer[TEXT_BUFFER_SIZE];
+/*
+ * The text buffer starts out TEXT_BUFFER_SIZE characters long and
+ * doubles whenever a single unbroken word fills it.  It is never
+ * shrunk or freed between flushes; flush_buffer() just rewinds it.
+ * stream_word() reads the buffer in place, so a buffer outgrown while
+ * a flush is in progress is kept in old_buffer until the flush ends.
+ */
+static zchar *buffer = NULL;
+static zchar *old_buffer = NULL;
+static int bufsize = 0;
 static int bufpos = 0;
+static bool locked = FALSE;
 
 static zchar prev_c = 0;
 
@@ -34,18 +45,59 @@ static zchar prev_c = 0;
 /*
  * init_buffer
  *
- * Initialize buffer variables.
+ * Initialize buffer variables.  This may be called again to empty the
+ * buffer, even if a flush of it was cut short.
  *
  */
 
 void init_buffer(void)
 {
-	memset(buffer, 0, sizeof (zchar) * TEXT_BUFFER_SIZE);
+	if (buffer == NULL) {
+		if ((buffer = malloc(sizeof (zchar) * TEXT_BUFFER_SIZE)) == NULL)
+			os_fatal("Out of memory");
+		bufsize = TEXT_BUFFER_SIZE;
+	}
+	if (old_buffer != NULL) {
+		free(old_buffer);
+		old_buffer = NULL;
+	}
+	memset(buffer, 0, sizeof (zchar) * bufsize);
 	bufpos = 0;
 	prev_c = 0;
+	locked = FALSE;
 }
 
 
+/*
+ * grow_buffer
+ *
+ * Double the size of the text buffer.  Return FALSE if that's not
+ * possible.
+ *
+ */
+static bool grow_buffer(void)
+{
+	zchar *p;
+	int newsize = bufsize * 2;
+
+	if (newsize <= bufsize)
+		return FALSE;
+	if ((size_t) newsize > ((size_t) -1) / sizeof (zchar))
+		return FALSE;
+	if ((p = malloc(sizeof (zchar) * newsize)) == NULL)
+		return FALSE;
+
+	memcpy(p, buffer, sizeof (zchar) * bufpos);
+	if (locked && old_buffer == NULL)
+		old_buffer = buffer;
+	else
+		free(buffer);
+	buffer = p;
+	bufsize = newsize;
+	return TRUE;
+} /* grow_buffer */
+
+
 /*
  * flush_buffer
  *
@@ -54,8 +106,6 @@ void init_buffer(void)
  */
 void flush_buffer(void)
 {
-	static bool locked = FALSE;
-
 	/* Make sure we stop when flush_buffer is called from flush_buffer.
 	 * Note that this is difficult to avoid as we might print a newline
 	 * during flush_buffer, which might cause a newline interrupt, that
@@ -70,6 +120,13 @@ void flush_buffer(void)
 
 	locked = TRUE; stream_word (buffer); locked = FALSE;
 
+	/* Release a buffer outgrown during the flush */
+
+	if (old_buffer != NULL) {
+		free(old_buffer);
+		old_buffer = NULL;
+	}
+
 	/* Reset the buffer */
 
 	bufpos = 0;
@@ -116,8 +173,10 @@ void print_char(zchar c)
 
 		/* Insert the character into the buffer */
 		buffer[bufpos++] = c;
-		if (bufpos == TEXT_BUFFER_SIZE)
+		if (bufpos == bufsize && !grow_buffer()) {
 			runtime_error (ERR_TEXT_BUF_OVF);
+			bufpos--;
+		}
 	} else stream_char (c);
 } /* print_char */
 
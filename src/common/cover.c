@@ -0,0 +1,300 @@
+/* cover.c - Z-code execution coverage map
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * When a coverage file is given, two bitmaps with one bit for every
+ * byte of the story are kept.  interpret() sets the bit for the address
+ * of each instruction it runs in cover_code, and decode_text() sets the
+ * bit for the start of each string it prints in cover_text.  Addresses
+ * that never turn up in them are code and text no player has reached.
+ *
+ * The maps are added to whatever the file already holds, so one file
+ * gathers the coverage of any number of sessions, and written back
+ * at exit and, if COVER_INTERVAL seconds have passed, when the story
+ * waits for input.  src/misc/zcovmerge.pl joins files from different
+ * machines.  A file looks like this, with numbers big-endian:
+ *
+ *	"ZCOV"			4 bytes
+ *	release			2 bytes
+ *	serial			6 bytes
+ *	checksum		2 bytes
+ *	story size		4 bytes
+ *	code map length		4 bytes, then the code map
+ *	text map length		4 bytes, then the text map
+ *
+ * Each map is (story size + 7) / 8 bytes long, the bit for address a
+ * being bit a & 7 of byte a >> 3.  It is stored run-length encoded
+ * the way Quetzal's CMem chunk is: a zero byte is followed by a count
+ * of further zero bytes, and other bytes stand for themselves.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "frotz.h"
+
+#define COVER_INTERVAL 60
+
+bool coverage = FALSE;
+zbyte *cover_code = NULL;
+zbyte *cover_text = NULL;
+
+static long map_size;
+static time_t last_write;
+
+
+/*
+ * put_number, get_number
+ *
+ * Write and read a big-endian number of the given number of bytes.
+ *
+ */
+static void put_number(FILE *out, zlong value, int bytes)
+{
+	while (bytes-- > 0)
+		putc((int) (value >> (8 * bytes)) & 0xff, out);
+} /* put_number */
+
+static bool get_number(FILE *in, zlong *value, int bytes)
+{
+	int c;
+
+	*value = 0;
+	while (bytes-- > 0) {
+		if ((c = getc(in)) == EOF)
+			return FALSE;
+		*value = (*value << 8) | c;
+	}
+	return TRUE;
+} /* get_number */
+
+
+/*
+ * encoded_size
+ *
+ * Return the size of a map once run-length encoded.
+ *
+ */
+static long encoded_size(const zbyte *map)
+{
+	long size = 0;
+	long i = 0;
+	int run;
+
+	while (i < map_size) {
+		if (map[i++] != 0) {
+			size++;
+			continue;
+		}
+		for (run = 0; run < 255 && i < map_size && map[i] == 0; run++)
+			i++;
+		size += 2;
+	}
+	return size;
+} /* encoded_size */
+
+
+/*
+ * write_map
+ *
+ * Write a map, run-length encoded, after its length.
+ *
+ */
+static void write_map(FILE *out, const zbyte *map)
+{
+	long i = 0;
+	int run;
+
+	put_number(out, encoded_size(map), 4);
+	while (i < map_size) {
+		putc(map[i], out);
+		if (map[i++] != 0)
+			continue;
+		for (run = 0; run < 255 && i < map_size && map[i] == 0; run++)
+			i++;
+		putc(run, out);
+	}
+} /* write_map */
+
+
+/*
+ * read_map
+ *
+ * Read a map and add it to the one in memory.
+ *
+ */
+static bool read_map(FILE *in, zbyte *map)
+{
+	zlong length;
+	long i = 0;
+	int c;
+	int run;
+
+	if (!get_number(in, &length, 4))
+		return FALSE;
+	while (length-- > 0) {
+		if ((c = getc(in)) == EOF || i >= map_size)
+			return FALSE;
+		if (c != 0) {
+			map[i++] |= c;
+			continue;
+		}
+		if (length-- == 0 || (run = getc(in)) == EOF)
+			return FALSE;
+		i += run + 1;
+	}
+	return i == map_size;
+} /* read_map */
+
+
+/*
+ * read_header
+ *
+ * Read the header of a coverage file, and return TRUE if it is for
+ * the story being played.
+ *
+ */
+static bool read_header(FILE *in)
+{
+	char magic[4];
+	zbyte serial[6];
+	zlong release;
+	zlong checksum;
+	zlong size;
+
+	return fread(magic, 1, 4, in) == 4 && memcmp(magic, "ZCOV", 4) == 0 &&
+		get_number(in, &release, 2) &&
+		fread(serial, 1, 6, in) == 6 &&
+		get_number(in, &checksum, 2) &&
+		get_number(in, &size, 4) &&
+		release == z_header.release &&
+		memcmp(serial, z_header.serial, 6) == 0 &&
+		checksum == z_header.checksum &&
+		size == (zlong) story_size;
+} /* read_header */
+
+
+/*
+ * cover_write
+ *
+ * Write the maps out.  Unless forced, only do so if COVER_INTERVAL
+ * seconds have passed since they were last written.  They are written
+ * under a temporary name and then moved, so that a run cut short never
+ * leaves half a map, and with it the coverage of earlier runs, behind.
+ *
+ */
+void cover_write(bool force)
+{
+	char *temp;
+	FILE *out;
+	bool ok;
+
+	/* The fuzzer keeps the maps in memory only */
+	if (f_setup.coverage_file == NULL ||
+	    (!force && time(NULL) - last_write < COVER_INTERVAL))
+		return;
+	last_write = time(NULL);
+
+	if ((temp = malloc(strlen(f_setup.coverage_file) + 5)) == NULL)
+		return;
+	sprintf(temp, "%s.new", f_setup.coverage_file);
+	if ((out = fopen(temp, "wb")) != NULL) {
+		fwrite("ZCOV", 1, 4, out);
+		put_number(out, z_header.release, 2);
+		fwrite(z_header.serial, 1, 6, out);
+		put_number(out, z_header.checksum, 2);
+		put_number(out, story_size, 4);
+		write_map(out, cover_code);
+		write_map(out, cover_text);
+		ok = !ferror(out);
+		if (fclose(out) == 0 && ok) {
+			remove(f_setup.coverage_file);
+			rename(temp, f_setup.coverage_file);
+		} else
+			remove(temp);
+	}
+	free(temp);
+} /* cover_write */
+
+
+/*
+ * cover_close
+ *
+ * Called at exit to write the maps.
+ *
+ */
+static void cover_close(void)
+{
+	cover_write(TRUE);
+} /* cover_close */
+
+
+/*
+ * cover_start
+ *
+ * Start keeping the maps, if they are not kept already.  Unless
+ * cover_open found a coverage file they are only kept in memory, for
+ * the fuzzer in the dumb interface to see what each run reaches.
+ *
+ */
+void cover_start(void)
+{
+	if (coverage)
+		return;
+
+	map_size = (story_size + 7) / 8;
+	cover_code = calloc(map_size, 1);
+	cover_text = calloc(map_size, 1);
+	if (cover_code == NULL || cover_text == NULL)
+		os_fatal("Out of memory");
+	coverage = TRUE;
+} /* cover_start */
+
+
+/*
+ * cover_open
+ *
+ * Start keeping the maps if a coverage file was asked for, and take
+ * in what the file already holds.
+ *
+ */
+void cover_open(void)
+{
+	FILE *in;
+	int c;
+
+	if (f_setup.coverage_file == NULL || coverage)
+		return;
+
+	cover_start();
+	if ((in = fopen(f_setup.coverage_file, "rb")) != NULL &&
+	    (c = getc(in)) != EOF) {
+		ungetc(c, in);
+		if (!read_header(in))
+			os_fatal("The coverage file (-X) is for another story.");
+		if (!read_map(in, cover_code) || !read_map(in, cover_text))
+			os_fatal("The coverage file (-X) is damaged.");
+	}
+	if (in != NULL)
+		fclose(in);
+
+	last_write = time(NULL);
+	atexit(cover_close);
+} /* cover_open */
@@ -0,0 +1,10 @@
+#ifndef COMMON_DEFINES_H
+#define COMMON_DEFINES_H
+#define UNIX
+#define MAX_UNDO_SLOTS 500
+#define MAX_FILE_NAME 80
+#define TEXT_BUFFER_SIZE 512
+#define INPUT_BUFFER_SIZE 200
+#define STACK_SIZE 1024
+#define USE_UTF8
+#endif /* COMMON_DEFINES_H */
@@ -60,6 +60,11 @@ extern void script_close (void);
 
 extern zword save_quetzal (FILE *, FILE *);
 extern zword restore_quetzal (FILE *, FILE *);
+extern zword save_quetzal_mem (membuf_t *, const zbyte *);
+extern zword restore_quetzal_mem (const zbyte *, long, const zbyte *);
+extern zword save_quetzal_delta (membuf_t *, zbyte far *);
+
+extern zword bg_save (const char *, const zbyte *);
 
 extern void erase_window (zword);
 
@@ -76,6 +81,17 @@ zbyte far *pcp = NULL;
 
 static FILE *story_fp = NULL;
 
+/* Original contents of dynamic memory, for saving to memory and
+ * restarting */
+static zbyte far *story_dynamic = NULL;
+
+/* Dynamic memory as of the last save restored from memory, or delta
+ * save made since; delta saves are made against it */
+static zbyte far *delta_parent = NULL;
+static bool delta_ready = FALSE;
+
+static zbyte far *original_memory(void);
+
 /*
  * Data for the undo mechanism.
  * This undo mechanism is based on the scheme used in Evin Robertson's
@@ -103,10 +119,17 @@ static int undo_count = 0;
 
 zword save_frotz(FILE *qfp)
 {
-	return save_quetzal(qfp, story_fp);
+	long start = ftell(qfp);
+	zword success = save_quetzal(qfp, story_fp);
+
+	turn_stats.saves++;
+	if (success && start >= 0)
+		turn_stats.save_bytes += ftell(qfp) - start;
+	return success;
 }
 
 
+
 /*
  * get_header_extension
  *
@@ -246,6 +269,7 @@ void init_setup(void)
 void init_memory(void)
 {
 	long size;
+	long allocated;
 	zword addr;
 	unsigned n;
 	int i, j;
@@ -494,9 +518,13 @@ void init_memory(void)
 		op1_opcodes[0x0f] = z_call_n;
 	}
 
-	/* Allocate memory for story data */
-	if ((zmp = (zbyte far *) realloc(zmp, story_size)) == NULL)
+	/* Allocate memory for story data.  A story shorter than 64KB is
+	 * followed by zeros, so that reading a word at any address a zword
+	 * can hold, as a broken story may, stays within it. */
+	allocated = story_size > 0x10001 ? story_size : 0x10001;
+	if ((zmp = (zbyte far *) realloc(zmp, allocated)) == NULL)
 		os_fatal("Out of memory");
+	memset(zmp + story_size, 0, allocated - story_size);
 
 	/* Load story file in chunks of 32KB */
 	n = 0x8000;
@@ -511,6 +539,9 @@ void init_memory(void)
 	/* Read header extension table */
 	z_header.x_table_size = get_header_extension(HX_TABLE_SIZE);
 	z_header.x_unicode_table = get_header_extension(HX_UNICODE_TABLE);
+
+	/* Find the code and text, if asked to */
+	init_symbols();
 } /* init_memory */
 
 
@@ -578,6 +609,20 @@ static void free_undo(int count)
 } /* free_undo */
 
 
+/*
+ * clear_undo
+ *
+ * Forget all undo states, as if the story had just been loaded.
+ *
+ */
+void clear_undo(void)
+{
+	free_undo(undo_count);
+	if (f_setup.undo_slots != 0)
+		memmove(prev_zmp, zmp, z_header.dynamic_size);
+} /* clear_undo */
+
+
 /*
  * reset_memory
  *
@@ -586,6 +631,12 @@ static void free_undo(int count)
  */
 void reset_memory(void)
 {
+#ifndef MSDOS_16BIT
+	/* Saves being written may still need the original memory */
+	if (!bg_save_flush())
+		fprintf(stderr, "Error writing save file\n");
+#endif
+
 	if (story_fp != NULL)
 		fclose(story_fp);
 	story_fp = NULL;
@@ -600,6 +651,15 @@ void reset_memory(void)
 	undo_count = 0;
 	prev_zmp = NULL;
 
+	if (story_dynamic)
+		free(story_dynamic);
+	story_dynamic = NULL;
+
+	if (delta_parent)
+		free(delta_parent);
+	delta_parent = NULL;
+	delta_ready = FALSE;
+
 	if (zmp)
 		free(zmp);
 	zmp = NULL;
@@ -607,16 +667,13 @@ void reset_memory(void)
 
 
 /*
- * storeb
+ * storeb_unchecked
  *
- * Write a byte value to the dynamic Z-machine memory.
+ * Write a byte value to an address known to be in dynamic memory.
  *
  */
-void storeb(zword addr, zbyte value)
+void storeb_unchecked(zword addr, zbyte value)
 {
-	if (addr >= z_header.dynamic_size)
-		runtime_error(ERR_STORE_RANGE);
-
 	if (addr == H_FLAGS + 1) {	/* flags register is modified */
 		z_header.flags &= ~(SCRIPTING_FLAG | FIXED_FONT_FLAG);
 		z_header.flags |= value & (SCRIPTING_FLAG | FIXED_FONT_FLAG);
@@ -630,14 +687,34 @@ void storeb(zword addr, zbyte value)
 		}
 		refresh_text_style();
 	}
+	if (PROP_WATCHED(addr))
+		property_store(addr);
 	SET_BYTE(addr, value);
+	if (OBJ_WATCHED(addr))
+		object_tree_store(addr);
+} /* storeb_unchecked */
+
+
+/*
+ * storeb
+ *
+ * Write a byte value to the dynamic Z-machine memory.
+ *
+ */
+void storeb(zword addr, zbyte value)
+{
+	if (addr >= z_header.dynamic_size)
+		runtime_error(ERR_STORE_RANGE);
+
+	storeb_unchecked(addr, value);
 } /* storeb */
 
 
 /*
- * storew
+ * storew, storew_unchecked
  *
- * Write a word value to the dynamic Z-machine memory.
+ * Write a word value to the dynamic Z-machine memory, or to an address
+ * known to be in it.
  *
  */
 void storew(zword addr, zword value)
@@ -646,9 +723,68 @@ void storew(zword addr, zword value)
 	storeb((zword) (addr + 1), lo (value));
 } /* storew */
 
+void storew_unchecked(zword addr, zword value)
+{
+	storeb_unchecked((zword) (addr + 0), hi (value));
+	storeb_unchecked((zword) (addr + 1), lo (value));
+} /* storew_unchecked */
+
+
+/*
+ * range_writable
+ *
+ * Return true if a block of dynamic memory can be written to directly
+ * instead of one byte at a time through storeb.  The block must lie
+ * within dynamic memory and must not include the flags register.
+ *
+ */
+bool range_writable(zword addr, zword size)
+{
+	if ((long) addr + size > z_header.dynamic_size)
+		return FALSE;
+	if (addr <= H_FLAGS + 1 && (long) addr + size > H_FLAGS + 1)
+		return FALSE;
+	return TRUE;
+} /* range_writable */
+
+
+/*
+ * range_written
+ *
+ * A block of dynamic memory has been written to directly.  Do what
+ * storeb would have done for the property indexes and the object tree.
+ *
+ */
+void range_written(zword addr, zword size)
+{
+	long i;
+	long end = (long) addr + size;
+
+	if (prop_watch != NULL) {
+		for (i = addr; i < end; i++) {
+			if (!(i & 7) && end - i >= 8 && !prop_watch[i >> 3]) {
+				i += 7;
+				continue;
+			}
+			if (PROP_WATCHED(i))
+				property_store((zword) i);
+		}
+	}
+
+	if (end > obj_table_start && addr < obj_table_end) {
+		i = (addr > obj_table_start) ? addr : obj_table_start;
+		if (end > obj_table_end)
+			end = obj_table_end;
+		for (; i < end; i++)
+			object_tree_store((zword) i);
+	}
+} /* range_written */
+
 
 /*
  * z_restart, re-load dynamic area, clear the stack and set the PC.
+ * The dynamic area is read from the story file once and kept, so that
+ * restarting again costs no more than a copy.
  *
  * 	no zargs used
  *
@@ -664,10 +800,18 @@ void z_restart(void)
 	seed_random(0);
 
 	if (!first_restart) {
-		os_storyfile_seek(story_fp, 0, SEEK_SET);
-		if (fread(zmp, 1, z_header.dynamic_size, story_fp) != z_header.dynamic_size)
-			os_fatal ("Story file read error");
+		if (original_memory() != NULL)
+			memmove(zmp, story_dynamic, z_header.dynamic_size);
+		else {
+			os_storyfile_seek(story_fp, 0, SEEK_SET);
+			if (fread(zmp, 1, z_header.dynamic_size, story_fp) != z_header.dynamic_size)
+				os_fatal ("Story file read error");
+		}
 	} else first_restart = FALSE;
+	delta_ready = FALSE;
+
+	reset_property_index();
+	reset_object_tree();
 
 	restart_header();
 	restart_screen();
@@ -723,6 +867,189 @@ static void get_default_name(char *default_name, size_t length, zword addr)
 } /* get_default_name */
 
 
+/*
+ * restored
+ *
+ * Tidy up after a game has been restored from a Quetzal image.
+ *
+ */
+static void restored(void)
+{
+	zbyte old_screen_rows;
+	zbyte old_screen_cols;
+
+	/* In V3, reset the upper window. */
+	if (z_header.version == V3)
+		split_window(0);
+
+	LOW_BYTE (H_SCREEN_ROWS, old_screen_rows);
+	LOW_BYTE (H_SCREEN_COLS, old_screen_cols);
+
+	/* Reload cached header fields. */
+	restart_header ();
+
+	/*
+	 * Since QUETZAL files may be saved on
+	 * many different machines, the screen sizes
+	 * may vary a lot. Erasing the status window
+	 * seems to cover up most of the
+	 * resulting badness.
+	 */
+	if (z_header.version > V3 && z_header.version != V6
+	    && (z_header.screen_rows != old_screen_rows
+	    || z_header.screen_cols != old_screen_cols))
+		erase_window (1);
+} /* restored */
+
+
+/*
+ * original_memory
+ *
+ * Return the original contents of dynamic memory, reading them from
+ * the story file the first time, or NULL if that fails.
+ *
+ */
+static zbyte far *original_memory(void)
+{
+	if (story_dynamic != NULL)
+		return story_dynamic;
+
+	if ((story_dynamic = malloc(z_header.dynamic_size)) == NULL)
+		return NULL;
+
+	os_storyfile_seek(story_fp, 0, SEEK_SET);
+	if (fread(story_dynamic, 1, z_header.dynamic_size, story_fp) !=
+	    z_header.dynamic_size) {
+		free(story_dynamic);
+		story_dynamic = NULL;
+	}
+	return story_dynamic;
+} /* original_memory */
+
+
+/*
+ * in_interrupt
+ *
+ * Return TRUE if an interrupt routine is running, as a save made from
+ * one could not be restored.
+ *
+ */
+static bool in_interrupt(void)
+{
+	zword *p = fp;
+	zword n;
+
+	for (n = frame_count; n > 0; n--) {
+		if ((p[0] >> 12) == 2)
+			return TRUE;
+		p = stack + 1 + p[1];
+	}
+	return FALSE;
+} /* in_interrupt */
+
+
+/*
+ * save_frotz_later
+ *
+ * Save the game to the named file on the background writer.  Return 1
+ * if the save was queued, or 0 if the caller must save it now.
+ *
+ */
+zword save_frotz_later(const char *name)
+{
+#ifndef MSDOS_16BIT
+	zbyte far *orig;
+
+	/* Let the foreground save report the error */
+	if (in_interrupt())
+		return 0;
+
+	orig = original_memory();
+	if (orig != NULL && bg_save(name, orig)) {
+		turn_stats.saves++;
+		return 1;
+	}
+#endif
+	return 0;
+} /* save_frotz_later */
+
+
+/*
+ * save_frotz_mem
+ *
+ * Save the game as a Quetzal image in a memory buffer.  Return 1 if OK,
+ * 0 if failed.
+ *
+ */
+zword save_frotz_mem(membuf_t *buf)
+{
+	zbyte far *orig = original_memory();
+
+	if (orig == NULL || !save_quetzal_mem(buf, orig))
+		return 0;
+	turn_stats.saves++;
+	turn_stats.save_bytes += buf->size;
+	return 1;
+} /* save_frotz_mem */
+
+
+/*
+ * restore_frotz_mem
+ *
+ * Restore the game from a Quetzal image in memory.  Return 2 if OK,
+ * 0 if nothing was changed, or -1 if the game state is now undefined.
+ *
+ */
+zword restore_frotz_mem(const zbyte *data, long size)
+{
+	zbyte far *orig = original_memory();
+	zword success;
+
+	if (orig == NULL)
+		return 0;
+
+	success = restore_quetzal_mem(data, size, orig);
+	reset_property_index();
+	reset_object_tree();
+	delta_ready = FALSE;
+	if ((short) success > 0) {
+		restored();
+
+		/* Remember this state as the parent of a delta save */
+		if (delta_parent == NULL)
+			delta_parent = malloc(z_header.dynamic_size);
+		if (delta_parent != NULL) {
+			memmove(delta_parent, zmp, z_header.dynamic_size);
+			delta_ready = TRUE;
+		}
+	}
+	return success;
+} /* restore_frotz_mem */
+
+
+/*
+ * save_frotz_delta
+ *
+ * Save the game in memory as a delta save against the last save that
+ * was restored from memory or made with this function, so that the
+ * two can be restored together as a chain.  Return 1 if OK, or 0 if
+ * failed or if there is no such save since the last restart.
+ *
+ */
+zword save_frotz_delta(membuf_t *buf)
+{
+	if (!delta_ready)
+		return 0;
+	if (!save_quetzal_delta(buf, delta_parent)) {
+		delta_ready = FALSE;
+		return 0;
+	}
+	turn_stats.saves++;
+	turn_stats.save_bytes += buf->size;
+	return 1;
+} /* save_frotz_delta */
+
+
 /*
  * z_restore, restore [a part of] a Z-machine state from disk
  *
@@ -746,6 +1073,10 @@ void z_restore(void)
 		statbuf = malloc(sizeof(struct stat));
 		statret = stat(f_setup.auto_save_name, statbuf);
 		free(statbuf);
+#ifndef MSDOS_16BIT
+		if (f_setup.save_store != NULL)
+			statret = !store_exists(f_setup.auto_save_name);
+#endif
 		if (statret != 0) {
 			f_setup.bot_status = BOT_START;
 			return;
@@ -771,6 +1102,8 @@ void z_restore(void)
 
 		/* Load auxilary file */
 		success = fread (zmp + zargs[0], 1, zargs[1], gfp);
+		reset_property_index();
+		reset_object_tree();
 
 		/* Close auxilary file */
 		fclose (gfp);
@@ -788,45 +1121,39 @@ void z_restore(void)
 		free(f_setup.save_name);
 		f_setup.save_name = strdup(new_name);
 
+#ifndef MSDOS_16BIT
+		/* Restore from the save store instead of a file */
+		if (f_setup.save_store != NULL) {
+			success = store_restore(new_name);
+			if ((short) success < 0)
+				os_fatal ("Error reading save file");
+			goto finished;
+		}
+#endif
+
+#ifndef MSDOS_16BIT
+		/* The file may still be being written */
+		if (!bg_save_flush())
+			print_string("Error writing save file\n");
+#endif
+
 		/* Open game file */
 		if ((gfp = fopen(new_name, "rb")) == NULL)
 			goto finished;
 		success = restore_quetzal(gfp, story_fp);
+		reset_property_index();
+		reset_object_tree();
 		if ((short) success >= 0) {
 			/* Close game file */
 			fclose (gfp);
-			if ((short) success > 0) {
-				zbyte old_screen_rows;
-				zbyte old_screen_cols;
-
-				/* In V3, reset the upper window. */
-				if (z_header.version == V3)
-					split_window(0);
-
-				LOW_BYTE (H_SCREEN_ROWS, old_screen_rows);
-				LOW_BYTE (H_SCREEN_COLS, old_screen_cols);
-
-				/* Reload cached header fields. */
-				restart_header ();
-
-				/*
-				 * Since QUETZAL files may be saved on
-				 * many different machines, the screen sizes
-				 * may vary a lot. Erasing the status window
-				 * seems to cover up most of the
-				 * resulting badness.
-				 */
-				if (z_header.version > V3 && z_header.version != V6
-				    && (z_header.screen_rows != old_screen_rows
-				    || z_header.screen_cols != old_screen_cols))
-					erase_window (1);
-			}
+			if ((short) success > 0)
+				restored();
 		} else
 			os_fatal ("Error reading save file");
 	}
 
 finished:
-	if (gfp == NULL && f_setup.restore_mode)
+	if (gfp == NULL && !success && f_setup.restore_mode)
 		os_fatal ("Error reading save file for restore mode");
 
 
@@ -847,7 +1174,7 @@ finished:
  * Returns the number of bytes copied to diff.
  *
  */
-static long mem_diff(zbyte *a, zbyte *b, zword mem_size, zbyte *diff)
+long mem_diff(zbyte *a, zbyte *b, zword mem_size, zbyte *diff)
 {
 	unsigned size = mem_size;
 	zbyte *p = diff;
@@ -885,11 +1212,14 @@ static long mem_diff(zbyte *a, zbyte *b, zword mem_size, zbyte *diff)
 /*
  * mem_undiff
  *
- * Applies a quetzal-like diff to dest
+ * Applies a quetzal-like diff to dest, which holds mem_size bytes.
+ * Returns FALSE if the diff reaches past the end of dest; the part
+ * that fits has been applied by then.
  *
  */
-static void mem_undiff(zbyte *diff, long diff_length, zbyte *dest)
+bool mem_undiff(zbyte *diff, long diff_length, zbyte *dest, zword mem_size)
 {
+	zbyte *end = dest + mem_size;
 	zbyte c;
 
 	while (diff_length) {
@@ -899,20 +1229,26 @@ static void mem_undiff(zbyte *diff, long diff_length, zbyte *dest)
 			unsigned runlen;
 
 			if (!diff_length)
-				return;  /* Incomplete run */
+				return TRUE;  /* Incomplete run */
 			runlen = *diff++;
 			diff_length--;
 			if (runlen & 0x80) {
 				if (!diff_length)
-					return; /* Incomplete extended run */
+					return TRUE; /* Incomplete extended run */
 				c = *diff++;
 				diff_length--;
 				runlen = (runlen & 0x7f) | (((unsigned) c) << 7);
 			}
+			if (runlen + 1 > (unsigned) (end - dest))
+				return FALSE;
 			dest += runlen + 1;
-		} else
+		} else {
+			if (dest >= end)
+				return FALSE;
 			*dest++ ^= c;
+		}
  	}
+	return TRUE;
 } /* mem_undiff */
 
 
@@ -938,12 +1274,15 @@ int restore_undo(void)
 
 	/* undo possible */
 	memmove(zmp, prev_zmp, z_header.dynamic_size);
+	reset_property_index();
+	reset_object_tree();
 	SET_PC(pc);
 	curr_undo->pc = pc;
 	sp = stack + STACK_SIZE - curr_undo->stack_size;
 	fp = stack + curr_undo->frame_offset;
 	frame_count = curr_undo->frame_count;
-	mem_undiff((zbyte *) (curr_undo + 1), curr_undo->diff_size, prev_zmp);
+	mem_undiff((zbyte *) (curr_undo + 1), curr_undo->diff_size, prev_zmp,
+	    z_header.dynamic_size);
 	memmove (sp, (zbyte *)(curr_undo + 1) + curr_undo->diff_size,
 		curr_undo->stack_size * sizeof (*sp));
 
@@ -1018,6 +1357,27 @@ void z_save(void)
 		free(f_setup.save_name);
 		f_setup.save_name = strdup(new_name);
 
+		/* Fail now rather than after telling the game all went well */
+		if (in_interrupt()) {
+			runtime_error(ERR_SAVE_IN_INTER);
+			goto finished;
+		}
+
+#ifndef MSDOS_16BIT
+		/* Save into the save store instead of a file */
+		if (f_setup.save_store != NULL) {
+			if ((success = store_save(new_name)) == 0)
+				print_string("Error writing save file\n");
+			goto finished;
+		}
+#endif
+
+		/* Leave the writing to the background writer if possible */
+		if (save_frotz_later(new_name)) {
+			success = 1;
+			goto finished;
+		}
+
 		/* Open game file */
 		if ((gfp = fopen(new_name, "wb")) == NULL)
 			goto finished;
@@ -1055,6 +1415,7 @@ int save_undo(void)
 	zword stack_size;
 	undo_t *p;
 	long pc;
+	zlong start = 0;
 
 	/* undo feature unavailable */
 	if (f_setup.undo_slots == 0)
@@ -1075,6 +1436,8 @@ int save_undo(void)
 	if (undo_count == f_setup.undo_slots)
 		free_undo(1);
 
+	if (telemetry)
+		start = telemetry_usec();
 	diff_size = mem_diff(zmp, prev_zmp, z_header.dynamic_size, undo_diff);
 	stack_size = stack + STACK_SIZE - sp;
 	do {
@@ -1104,6 +1467,11 @@ int save_undo(void)
 	p->next = NULL;
 	curr_undo = last_undo = p;
 	undo_count++;
+
+	turn_stats.undo_bytes += sizeof (undo_t) + diff_size +
+		stack_size * sizeof (*sp);
+	if (telemetry)
+		turn_stats.undo_usec += telemetry_usec() - start;
 	return 1;
 } /* save_undo */
 
@@ -1128,13 +1496,18 @@ void z_save_undo(void)
  */
 void z_verify (void)
 {
-	zword checksum = 0;
+	static zword checksum = 0;
+	static bool summed = FALSE;
 	long i;
 
-	/* Sum all bytes in story file except header bytes */
-	os_storyfile_seek(story_fp, 64, SEEK_SET);
-	for (i = 64; i < story_size; i++)
-		checksum += fgetc(story_fp);
+	/* Sum all bytes in story file except header bytes.  The file does
+	 * not change, so that is only done the first time. */
+	if (!summed) {
+		os_storyfile_seek(story_fp, 64, SEEK_SET);
+		for (i = 64; i < story_size; i++)
+			checksum += fgetc(story_fp);
+		summed = TRUE;
+	}
 
 	/* Branch if the checksums are equal */
 	branch(checksum == z_header.checksum);
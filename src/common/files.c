@@ -23,6 +23,20 @@
 #include <string.h>
 #include <stdlib.h>
 
+/* Without POSIX, command files are read rather than mapped, and their
+ * timestamps only count whole seconds */
+#if !defined(MSDOS_16BIT) && !defined(_WIN32)
+#define HAVE_POSIX
+#endif
+
+#ifdef HAVE_POSIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#else
+#include <time.h>
+#endif
+
 #ifndef SEEK_SET
 #define SEEK_SET 0
 #define SEEK_CUR 1
@@ -35,6 +49,41 @@ extern bool is_terminator (zchar);
 
 extern bool read_yes_or_no (const char *);
 
+extern void get_random_state (long *, int *, int *);
+extern void set_random_state (long, int, int);
+
+/*
+ * Command files come in two formats.  The text format has a line for
+ * each input, with anything but printable ASCII written as [nnn].  The
+ * binary format, which is recorded when f_setup.record_binary is set,
+ * starts with "ZREC" and a version byte, followed by events.  An event
+ * is a type byte, the time since recording began in milliseconds as
+ * four bytes, and then
+ *
+ *	'K'  a keystroke: its code
+ *	'L'  a line of input: its length n as two bytes, n codes, then
+ *	     the code of the key that ended it
+ *	'T'  timed input ran out: the length and codes of whatever had
+ *	     been typed, as for 'L', with no key after them
+ *	'R'  the random number generator was seeded: its state as four
+ *	     bytes, and the interval and counter of its special mode as
+ *	     two bytes each
+ *
+ * Codes are two bytes holding what the text format would: ZSCII, or
+ * 1000 and up for hot keys.  A mouse click is followed by the mouse
+ * position, two bytes for each coordinate.  Numbers are big-endian.
+ * A recording begins with an 'R' event, so that random numbers come
+ * out the same on playback.  Binary files are told apart from text by
+ * their first bytes, and are mapped into memory to be played back.
+ */
+#define REC_VERSION	1
+#define REC_HEADER	5
+
+#define REC_KEY		'K'
+#define REC_LINE	'L'
+#define REC_TIMEOUT	'T'
+#define REC_SEED	'R'
+
 /* char script_name[MAX_FILE_NAME + 1] = DEFAULT_SCRIPT_NAME; */
 /* char command_name[MAX_FILE_NAME + 1] = DEFAULT_COMMAND_NAME; */
 
@@ -48,6 +97,17 @@ static FILE *sfp = NULL;
 static FILE *rfp = NULL;
 static FILE *pfp = NULL;
 
+static bool record_binary = FALSE;
+static zlong record_start = 0;
+
+static const zbyte *replay_data = NULL;
+static long replay_size = 0;
+static long replay_pos = 0;
+static bool replay_mapped = FALSE;
+
+static long fast_inputs = 0;
+static zlong fast_hash = 0;
+
 /*
  * script_open
  *
@@ -291,26 +351,87 @@ void script_mssg_off(void)
 
 
 /*
- * record_open
+ * record_clock
  *
- * Open a file to record the player's input.
+ * Return the time in milliseconds, for timestamps in binary command
+ * files.
  *
  */
-void record_open(void)
+static zlong record_clock(void)
 {
-	char *new_name;
+#ifdef HAVE_POSIX
+	struct timeval tv;
 
-	new_name = os_read_file_name(f_setup.command_name, FILE_RECORD);
-	if (new_name != NULL) {
-		free(f_setup.command_name);
-		f_setup.command_name = strdup(new_name);
+	gettimeofday(&tv, NULL);
+	return (zlong) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#else
+	return (zlong) time(NULL) * 1000;
+#endif
+} /* record_clock */
 
-		if ((rfp = fopen(new_name, "wt")) != NULL)
-			ostream_record = TRUE;
-		else
-			print_string("Cannot open file\n");
-	}
-} /* record_open */
+
+/*
+ * record_number
+ *
+ * Write a big-endian number of the given size to a binary command file.
+ *
+ */
+static void record_number(zlong value, int size)
+{
+	while (size-- > 0)
+		fputc((int) (value >> (8 * size)) & 0xff, rfp);
+} /* record_number */
+
+
+/*
+ * record_event
+ *
+ * Start an event in a binary command file.
+ *
+ */
+static void record_event(int type)
+{
+	fputc(type, rfp);
+	record_number((record_clock() - record_start) & 0xffffffffUL, 4);
+} /* record_event */
+
+
+/*
+ * record_value
+ *
+ * Write a character to a binary command file as its code, followed by
+ * the mouse position if it is a click.
+ *
+ */
+static void record_value(zchar c)
+{
+	if (c < ZC_HKEY_MIN || c > ZC_HKEY_MAX) {
+		record_number(translate_to_zscii(c), 2);
+		if (c == ZC_SINGLE_CLICK || c == ZC_DOUBLE_CLICK) {
+			record_number(mouse_x, 2);
+			record_number(mouse_y, 2);
+		}
+	} else
+		record_number(1000 + c - ZC_HKEY_MIN, 2);
+} /* record_value */
+
+
+/*
+ * record_line
+ *
+ * Write the length and codes of a line to a binary command file.
+ *
+ */
+static void record_line(const zchar *buf)
+{
+	int n;
+
+	for (n = 0; buf[n] != 0; n++)
+		;
+	record_number(n, 2);
+	while (*buf != 0)
+		record_value(*buf++);
+} /* record_line */
 
 
 /*
@@ -326,6 +447,60 @@ void record_close (void)
 }/* record_close */
 
 
+/*
+ * record_write_seed
+ *
+ * Copy the state of the random number generator to the command file,
+ * if it is in the binary format.
+ *
+ */
+void record_write_seed(void)
+{
+	long seed;
+	int ival, count;
+
+	if (!record_binary)
+		return;
+
+	get_random_state(&seed, &ival, &count);
+	record_event(REC_SEED);
+	record_number((zlong) seed & 0xffffffffUL, 4);
+	record_number(ival, 2);
+	record_number(count, 2);
+	if (ferror(rfp))
+		record_close();
+} /* record_write_seed */
+
+/*
+ * record_open
+ *
+ * Open a file to record the player's input.
+ *
+ */
+void record_open(void)
+{
+	char *new_name;
+
+	new_name = os_read_file_name(f_setup.command_name, FILE_RECORD);
+	if (new_name != NULL) {
+		free(f_setup.command_name);
+		f_setup.command_name = strdup(new_name);
+
+		record_binary = f_setup.record_binary;
+		if ((rfp = fopen(new_name, record_binary ? "wb" : "wt")) != NULL) {
+			ostream_record = TRUE;
+			if (record_binary) {
+				record_start = record_clock();
+				fputs("ZREC", rfp);
+				fputc(REC_VERSION, rfp);
+				record_write_seed();
+			}
+		} else
+			print_string("Cannot open file\n");
+	}
+} /* record_open */
+
+
 /*
  * record_code
  *
@@ -379,6 +554,19 @@ static void record_char(zchar c)
  */
 void record_write_key(zchar key)
 {
+	if (record_binary) {
+		if (key == ZC_TIME_OUT) {
+			record_event(REC_TIMEOUT);
+			record_number(0, 2);
+		} else {
+			record_event(REC_KEY);
+			record_value(key);
+		}
+		if (ferror(rfp))
+			record_close();
+		return;
+	}
+
 	record_char(key);
 	if (fputc('\n', rfp) == EOF)
 		record_close();
@@ -395,6 +583,16 @@ void record_write_input(const zchar *buf, zchar key)
 {
 	zchar c;
 
+	if (record_binary) {
+		record_event(key == ZC_TIME_OUT ? REC_TIMEOUT : REC_LINE);
+		record_line(buf);
+		if (key != ZC_TIME_OUT)
+			record_value(key);
+		if (ferror(rfp))
+			record_close();
+		return;
+	}
+
 	while ((c = *buf++) != 0)
 		record_char(c);
 	record_char(key);
@@ -403,6 +601,198 @@ void record_write_input(const zchar *buf, zchar key)
 } /* record_write_input */
 
 
+
+/*
+ * replay_number
+ *
+ * Read a big-endian number of the given size from a binary command
+ * file.  Return -1 if the file ends first.
+ *
+ */
+static long replay_number(int size)
+{
+	long value = 0;
+
+	if (replay_size - replay_pos < size)
+		return -1;
+	while (size-- > 0)
+		value = (value << 8) | replay_data[replay_pos++];
+	return value;
+} /* replay_number */
+
+
+/*
+ * replay_value
+ *
+ * Turn a code from a binary command file back into a character, and
+ * read the mouse position that goes with a click.
+ *
+ */
+static zchar replay_value(long c)
+{
+	if (c < 0)
+		return ZC_BAD;
+	if (c >= 1000)
+		return ZC_HKEY_MIN + c - 1000;
+
+	c = translate_from_zscii(c);
+	if (c == ZC_SINGLE_CLICK || c == ZC_DOUBLE_CLICK) {
+		mouse_x = replay_number(2);
+		mouse_y = replay_number(2);
+	}
+	return c;
+} /* replay_value */
+
+
+/*
+ * replay_read_seed
+ *
+ * If the next event in a binary command file seeds the random number
+ * generator, do so and return TRUE.
+ *
+ */
+bool replay_read_seed(void)
+{
+	long seed;
+	int ival, count;
+
+	if (replay_data == NULL || replay_pos + REC_HEADER + 8 > replay_size
+	    || replay_data[replay_pos] != REC_SEED)
+		return FALSE;
+
+	replay_pos += REC_HEADER;
+	seed = replay_number(4);
+	ival = (int) replay_number(2);
+	count = (int) replay_number(2);
+	set_random_state(seed, ival, count);
+	return TRUE;
+} /* replay_read_seed */
+
+
+/*
+ * replay_event
+ *
+ * Read the next input from a binary command file.  The characters of
+ * a line go in buf and the key that ended it in key.  Return the type
+ * of the event, or 0 at the end of the file or if the event is damaged.
+ *
+ */
+static int replay_event(zchar *buf, zchar *key)
+{
+	long n, i;
+	int type;
+
+	while (replay_read_seed())
+		;
+
+	if (replay_size - replay_pos < REC_HEADER)
+		return 0;
+	type = replay_data[replay_pos];
+	replay_pos += REC_HEADER;	/* Playback ignores the time. */
+
+	buf[0] = 0;
+	switch (type) {
+	case REC_KEY:
+		*key = replay_value(replay_number(2));
+		break;
+	case REC_LINE:
+	case REC_TIMEOUT:
+		if ((n = replay_number(2)) < 0 || n >= INPUT_BUFFER_SIZE)
+			return 0;
+		for (i = 0; i < n; i++)
+			if ((buf[i] = replay_value(replay_number(2))) == ZC_BAD)
+				return 0;
+		buf[n] = 0;
+		if (type == REC_TIMEOUT)
+			*key = ZC_TIME_OUT;
+		else
+			*key = replay_value(replay_number(2));
+		break;
+	default:
+		return 0;
+	}
+	return (*key == ZC_BAD) ? 0 : type;
+} /* replay_event */
+
+
+/*
+ * replay_map
+ *
+ * If the command file just opened is in the binary format, map it
+ * into memory and return TRUE.
+ *
+ */
+static bool replay_map(void)
+{
+	char header[REC_HEADER];
+	zbyte *data;
+	long size;
+#ifdef HAVE_POSIX
+	struct stat st;
+#endif
+
+	if (fread(header, 1, REC_HEADER, pfp) != REC_HEADER ||
+	    memcmp(header, "ZREC", 4) != 0 || header[4] != REC_VERSION)
+		return FALSE;
+
+#ifdef HAVE_POSIX
+	if (fstat(fileno(pfp), &st) == 0) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+			    fileno(pfp), 0);
+		if (data != MAP_FAILED) {
+			replay_data = data;
+			replay_size = st.st_size;
+			replay_pos = REC_HEADER;
+			replay_mapped = TRUE;
+			return TRUE;
+		}
+	}
+#endif
+
+	/* Without mmap, read the whole file instead */
+	if (fseek(pfp, 0, SEEK_END) != 0 || (size = ftell(pfp)) < 0 ||
+	    fseek(pfp, 0, SEEK_SET) != 0 || (data = malloc(size + 1)) == NULL)
+		return FALSE;
+	if (fread(data, 1, size, pfp) != (size_t) size) {
+		free(data);
+		return FALSE;
+	}
+	replay_data = data;
+	replay_size = size;
+	replay_pos = REC_HEADER;
+	replay_mapped = FALSE;
+	return TRUE;
+} /* replay_map */
+
+
+/*
+ * replay_start
+ *
+ * Open the named command file, in either format, and start playback,
+ * asking about MORE prompts unless fast-forwarding.  Return FALSE if
+ * the file can't be opened.
+ *
+ */
+static bool replay_start(const char *name, bool fast)
+{
+	if ((pfp = fopen(name, "rb")) != NULL && !replay_map()) {
+		fclose(pfp);
+		pfp = fopen(name, "rt");
+	}
+	if (pfp == NULL)
+		return FALSE;
+
+	if (fast)
+		set_more_prompts(FALSE);
+	else
+		set_more_prompts(read_yes_or_no("Do you want MORE prompts"));
+	istream_replay = TRUE;
+	while (replay_read_seed())
+		;
+	return TRUE;
+} /* replay_start */
+
+
 /*
  * replay_open
  *
@@ -418,15 +808,69 @@ void replay_open(void)
 		free(f_setup.command_name);
 		f_setup.command_name = strdup(new_name);
 
-		if ((pfp = fopen(new_name, "rt")) != NULL) {
-			set_more_prompts(read_yes_or_no("Do you want MORE prompts"));
-			istream_replay = TRUE;
-		} else
+		if (!replay_start(new_name, FALSE))
 			print_string("Cannot open file\n");
 	}
 } /* replay_open */
 
 
+/*
+ * fast_forward_open
+ *
+ * Play back the command file named by f_setup.replay_file without
+ * showing anything, as quickly as possible.  Output to the screen is
+ * dropped, or only hashed if f_setup.replay_hash is set; memory
+ * streams and transcripts are written as usual.  Timed input is
+ * replayed from the file like everything else.  When the file ends,
+ * or playback is turned off by a recorded hot key, the game carries
+ * on with the player at the keyboard.
+ *
+ */
+void fast_forward_open(void)
+{
+	if (!replay_start(f_setup.replay_file, TRUE)) {
+		print_string("Cannot open file\n");
+		return;
+	}
+	fast_forward = TRUE;
+	fast_inputs = 0;
+	fast_hash = HASH_START;
+} /* fast_forward_open */
+
+
+/*
+ * fast_forward_char
+ *
+ * Take a character that would have gone to the screen during
+ * fast-forward, adding it to the 32-bit FNV-1a hash of the output.
+ *
+ */
+void fast_forward_char(zchar c)
+{
+	if (f_setup.replay_hash)
+		fast_hash = hash_word(fast_hash, c);
+} /* fast_forward_char */
+
+
+/*
+ * fast_forward_word
+ *
+ * Take a string that would have gone to the screen during fast-forward.
+ *
+ */
+void fast_forward_word(const zchar *s)
+{
+	if (!f_setup.replay_hash)
+		return;
+	for (; *s != 0; s++) {
+		if (*s == ZC_NEW_STYLE || *s == ZC_NEW_FONT)
+			s++;	/* Skip the style or font too. */
+		else
+			fast_forward_char(*s);
+	}
+} /* fast_forward_word */
+
+
 /*
  * replay_close
  *
@@ -436,8 +880,31 @@ void replay_open(void)
 void replay_close(void)
 {
 	set_more_prompts(TRUE);
+	if (replay_data != NULL) {
+#ifdef HAVE_POSIX
+		if (replay_mapped)
+			munmap((void *) replay_data, replay_size);
+		else
+#endif
+			free((void *) replay_data);
+		replay_data = NULL;
+	}
 	fclose (pfp);
 	istream_replay = FALSE;
+
+	if (fast_forward) {
+		char text[64];
+
+		fast_forward = FALSE;
+		sprintf(text, "[Fast-forward done after %ld inputs]\n",
+			fast_inputs);
+		print_string(text);
+		if (f_setup.replay_hash) {
+			sprintf(text, "[Output hash %08lx]\n",
+				(unsigned long) fast_hash);
+			print_string(text);
+		}
+	}
 } /* replay_close */
 
 
@@ -502,15 +969,27 @@ static zchar replay_char (void)
  */
 zchar replay_read_key (void)
 {
+	zchar buf[INPUT_BUFFER_SIZE];
 	zchar key;
 
+	if (replay_data != NULL) {
+		/* A line will do if it is empty. */
+		if (replay_event(buf, &key) == 0 || buf[0] != 0) {
+			replay_close();
+			return ZC_BAD;
+		}
+		fast_inputs++;
+		return key;
+	}
+
 	key = replay_char();
 
 	if (fgetc(pfp) != '\n') {
 		replay_close();
 		return ZC_BAD;
-	} else
-		return key;
+	}
+	fast_inputs++;
+	return key;
 } /* replay_read_key */
 
 
@@ -523,6 +1002,22 @@ zchar replay_read_key (void)
 zchar replay_read_input(zchar *buf)
 {
 	zchar c;
+	int type;
+
+	if (replay_data != NULL) {
+		if ((type = replay_event(buf, &c)) == 0) {
+			replay_close();
+			return ZC_BAD;
+		}
+		/* A key will do, as a line of one character. */
+		if (type == REC_KEY && !is_terminator(c)) {
+			buf[0] = c;
+			buf[1] = 0;
+			c = ZC_RETURN;
+		}
+		fast_inputs++;
+		return c;
+	}
 
 	for (;;) {
 		c = replay_char();
@@ -535,7 +1030,8 @@ zchar replay_read_input(zchar *buf)
 	if (fgetc(pfp) != '\n') {
 		replay_close();
 		return ZC_BAD;
-	} else
-		return c;
+	}
+	fast_inputs++;
+	return c;
 
 } /* replay_read_input */
@@ -0,0 +1,347 @@
+/* flight.c - Crash flight recorder
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The interpreter always keeps a record of what it did last.  For every
+ * instruction, interpret() stores the address and the opcode byte in
+ * flight_ring[], at the slot given by the instruction count, so that
+ * the ring holds the last FLIGHT_SIZE instructions at the cost of one
+ * store each.  call() and ret() also note every call and return in
+ * flight_events[], which reaches further back.
+ *
+ * If asked to (f_setup.crash_report), the rings are written out when
+ * the interpreter dies of a fatal error: flight_dump() writes both
+ * rings, the call stack and the reason to <story>.crash, and a Quetzal
+ * save of the machine as it was to <story>.crash.qzl.  The save holds
+ * memory, stack and frames at the moment of the crash, with the PC in
+ * the middle of the failing instruction, so it is meant to be looked
+ * at rather than restored.  If the story was analysed at load
+ * (symbols.c), the routine holding each address is given as well.
+ *
+ * A signal such as SIGSEGV may arrive with the heap or stdio in any
+ * state, so the handler cannot do the same.  It only write()s a report
+ * made up in advance, with the signal, the instruction count and the
+ * PC filled in, to a file opened in advance as <story>.crash.tmp, and
+ * renames that to <story>.crash.  A run that does not crash removes
+ * the file at exit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include "frotz.h"
+
+#ifndef MSDOS_16BIT
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+zlong flight_ring[FLIGHT_SIZE];
+flight_event_t flight_events[FLIGHT_EVENTS];
+zlong flight_event_count = 0;
+
+static bool dumping = FALSE;
+
+#ifndef MSDOS_16BIT
+static int report_fd = -1;
+static char *report_name = NULL;
+static char *temp_name = NULL;
+static char report_head[256];
+static size_t report_head_len = 0;
+
+/* The signals that mean the interpreter itself has crashed */
+const int crash_signals[] = {
+	SIGSEGV,
+	SIGFPE,
+	SIGILL,
+#ifdef SIGBUS
+	SIGBUS,
+#endif
+	SIGABRT
+};
+
+const int crash_signal_count =
+	(int) (sizeof(crash_signals) / sizeof(crash_signals[0]));
+#endif
+
+
+
+/*
+ * dump_name
+ *
+ * Return the name of a crash report file, with ext added.
+ *
+ */
+static char *dump_name(const char *ext)
+{
+	const char *base = f_setup.story_name ? f_setup.story_name : "story";
+	char *name;
+
+	name = malloc(strlen(base) + strlen(EXT_CRASH) + strlen(ext) + 1);
+	if (name != NULL)
+		sprintf(name, "%s%s%s", base, EXT_CRASH, ext);
+	return name;
+} /* dump_name */
+
+
+/*
+ * write_instructions
+ *
+ * Write the instructions in the ring, oldest first.  An extended
+ * opcode is shown with the byte after the 0xbe prefix.
+ *
+ */
+static void write_instructions(FILE *out)
+{
+	zlong first = 1;
+	zlong i;
+
+	if (instruction_count > FLIGHT_SIZE)
+		first = instruction_count - FLIGHT_SIZE + 1;
+
+	fprintf(out, "\n# last %lu instructions: number, address, opcode\n",
+		instruction_count - first + 1);
+	for (i = first; i <= instruction_count; i++) {
+		zlong entry = flight_ring[i & (FLIGHT_SIZE - 1)];
+		long pc = entry >> 8;
+		int opcode = entry & 0xff;
+
+		if (opcode == 0xbe && pc + 1 < story_size)
+			fprintf(out, "%12lu %06lx be %02x\n", i, pc, zmp[pc + 1]);
+		else
+			fprintf(out, "%12lu %06lx %02x\n", i, pc, opcode);
+	}
+} /* write_instructions */
+
+
+/*
+ * write_events
+ *
+ * Write the calls and returns in the ring, oldest first.
+ *
+ */
+static void write_events(FILE *out)
+{
+	zlong first = 1;
+	zlong i;
+
+	if (flight_event_count > FLIGHT_EVENTS)
+		first = flight_event_count - FLIGHT_EVENTS + 1;
+
+	fprintf(out, "\n# last %lu calls and returns: instruction, "
+		"call or ret, address, depth\n",
+		flight_event_count - first + 1);
+	for (i = first; i <= flight_event_count; i++) {
+		flight_event_t *e = &flight_events[i & (FLIGHT_EVENTS - 1)];
+
+		fprintf(out, "%12lu %-4s %06lx %u\n", e->when,
+			e->kind == FLIGHT_CALL ? "call" : "ret", e->addr,
+			(unsigned) e->depth);
+	}
+} /* write_events */
+
+
+/*
+ * write_frames
+ *
+ * Write the return addresses of the frames on the stack, innermost
+ * first, stopping at the first that makes no sense.
+ *
+ */
+static void write_frames(FILE *out)
+{
+	long frame;
+	long addr;
+
+	fprintf(out, "\n# call stack: return address, locals, arguments, "
+		"routine returned to\n");
+	if (fp == NULL)
+		return;
+	frame = fp - stack;
+	while (frame >= 0 && frame <= STACK_SIZE - 4) {
+		addr = ((long) stack[frame + 3] << 9) | stack[frame + 2];
+		fprintf(out, "%06lx %u %u", addr, (stack[frame] >> 8) & 0x0f,
+			stack[frame] & 0xff);
+		if (symbol_routine(addr) >= 0)
+			fprintf(out, " %06lx", symbol_routine(addr));
+		putc('\n', out);
+		frame = stack[frame + 1] + 1;
+	}
+} /* write_frames */
+
+
+/*
+ * flight_dump
+ *
+ * Write out the crash report and a save of the machine, if asked to.
+ * Nothing is written if no instruction has run yet.
+ *
+ */
+void flight_dump(const char *reason)
+{
+	char *name;
+	FILE *out;
+	long pc;
+
+	if (!f_setup.crash_report || dumping || zmp == NULL ||
+	    instruction_count == 0)
+		return;
+	dumping = TRUE;
+
+	if ((name = dump_name("")) == NULL) {
+		dumping = FALSE;
+		return;
+	}
+	out = fopen(name, "w");
+	if (out != NULL) {
+		GET_PC(pc)
+		fprintf(out, "# Frotz %s crash report\n", VERSION);
+		fprintf(out, "reason: %s\n", reason);
+		fprintf(out, "story: %s release %u serial %.6s\n",
+			f_setup.story_name ? f_setup.story_name : "",
+			z_header.release, (const char *) z_header.serial);
+		fprintf(out, "instructions: %lu\n", instruction_count);
+		fprintf(out, "pc: %06lx\n", pc);
+		if (symbol_routine(pc) >= 0)
+			fprintf(out, "routine: %06lx\n", symbol_routine(pc));
+		fprintf(out, "frames: %u\n", (unsigned) frame_count);
+		fprintf(out, "stack: %ld\n", (long) (stack + STACK_SIZE - sp));
+		write_instructions(out);
+		write_events(out);
+		write_frames(out);
+		fclose(out);
+		fprintf(stderr, "Crash report written to %s\n", name);
+	}
+	free(name);
+
+	if ((name = dump_name(EXT_SAVE)) != NULL &&
+	    (out = fopen(name, "wb")) != NULL) {
+		save_frotz(out);
+		fclose(out);
+	}
+	free(name);
+
+	/* A resident server goes on to its next request */
+	dumping = FALSE;
+} /* flight_dump */
+
+#ifndef MSDOS_16BIT
+
+/*
+ * write_number
+ *
+ * Write a labelled number to the crash report in the given base, using
+ * nothing a signal handler may not.  Return FALSE if it failed.
+ *
+ */
+static bool write_number(const char *label, zlong n, int base)
+{
+	char buf[16];
+	char *p = buf + sizeof(buf);
+
+	*--p = '\n';
+	do {
+		*--p = "0123456789abcdef"[n % base];
+		n /= base;
+	} while (n != 0);
+	return write(report_fd, label, strlen(label)) >= 0 &&
+		write(report_fd, p, buf + sizeof(buf) - p) >= 0;
+} /* write_number */
+
+
+/*
+ * crash_handler
+ *
+ * Report a crash, then let the signal do what it would have done.
+ *
+ */
+static void crash_handler(int sig)
+{
+	long pc;
+
+	signal(sig, SIG_DFL);
+	if (report_fd >= 0 && !dumping && zmp != NULL &&
+	    instruction_count != 0) {
+		dumping = TRUE;
+		GET_PC(pc)
+		if (write(report_fd, report_head, report_head_len) >= 0 &&
+		    write_number("signal: ", sig, 10) &&
+		    write_number("instructions: ", instruction_count, 10) &&
+		    write_number("pc: ", pc, 16) &&
+		    write_number("frames: ", frame_count, 10))
+			rename(temp_name, report_name);
+	}
+	raise(sig);
+} /* crash_handler */
+
+
+/*
+ * flight_close
+ *
+ * Remove the crash report made ready for a signal that never came.
+ *
+ */
+static void flight_close(void)
+{
+	if (report_fd < 0)
+		return;
+	close(report_fd);
+	report_fd = -1;
+	unlink(temp_name);
+} /* flight_close */
+
+#endif /* MSDOS_16BIT */
+
+
+/*
+ * flight_open
+ *
+ * If crash reports were asked for, catch the signals that mean the
+ * interpreter itself has crashed, with the file for the report open
+ * and as much of it written out as can be.
+ *
+ */
+void flight_open(void)
+{
+#ifndef MSDOS_16BIT
+	int i;
+
+	if (!f_setup.crash_report || report_fd >= 0)
+		return;
+
+	report_name = dump_name("");
+	temp_name = dump_name(".tmp");
+	if (report_name == NULL || temp_name == NULL)
+		return;
+	report_fd = open(temp_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (report_fd < 0)
+		return;
+	atexit(flight_close);
+
+	sprintf(report_head, "# Frotz %s crash report\n"
+		"story: %.128s release %u serial %.6s\n",
+		VERSION, f_setup.story_name ? f_setup.story_name : "",
+		z_header.release, (const char *) z_header.serial);
+	report_head_len = strlen(report_head);
+
+	for (i = 0; i < crash_signal_count; i++)
+		signal(crash_signals[i], crash_handler);
+#endif
+} /* flight_open */
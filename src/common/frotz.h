@@ -26,6 +26,13 @@
 #include "git_hash.h"
 #endif
 
+/* The sampling profiler needs setitimer and SIGPROF */
+#if defined(MSDOS_16BIT) || defined(_WIN32)
+#ifndef NO_SAMPLING
+#define NO_SAMPLING
+#endif
+#endif
+
 #ifndef __UNIX_PORT_FILE
 #include <signal.h>
 typedef int bool;
@@ -124,6 +131,23 @@ typedef struct {
 	zword true_back;
 } Zwindow;
 
+/*** growable block of memory holding a saved game ***/
+typedef struct {
+	zbyte *data;
+	long size;
+	long alloc;
+} membuf_t;
+
+/*** the state a saved game is made from, live or copied ***/
+typedef struct {
+	zbyte *mem;		/* Dynamic memory */
+	zword *stack;		/* Stack of STACK_SIZE words */
+	long sp;		/* Stack pointer, as an index into stack */
+	long fp;		/* Frame pointer, likewise */
+	zlong pc;		/* Program counter */
+	bool copy;		/* Not the live state; don't report errors */
+} zsnapshot_t;
+
 #include "setup.h"
 #include "missing.h"
 #include "unused.h"
@@ -144,6 +168,15 @@ typedef struct {
 #ifndef STACK_SIZE
 #define STACK_SIZE 1024
 #endif
+#ifndef FLIGHT_SIZE
+#define FLIGHT_SIZE 256		/* Must be a power of two */
+#endif
+#ifndef FLIGHT_EVENTS
+#define FLIGHT_EVENTS 64	/* Must be a power of two */
+#endif
+#ifndef LOCKSTEP_EVERY
+#define LOCKSTEP_EVERY 1000	/* Instructions between trace lines */
+#endif
 
 extern const char build_timestamp[];
 
@@ -156,6 +189,7 @@ extern const char build_timestamp[];
 #define EXT_BLORB4	".zblorb"
 #define EXT_COMMAND	".rec"
 #define EXT_AUX		".aux"
+#define EXT_CRASH	".crash"
 
 #ifndef DEFAULT_SAVE_NAME
 #define DEFAULT_SAVE_NAME "story.sav"
@@ -318,7 +352,8 @@ extern const char build_timestamp[];
 #define ZC_HKEY_QUIT 0x13
 #define ZC_HKEY_DEBUG 0x14
 #define ZC_HKEY_HELP 0x15
-#define ZC_HKEY_MAX 0x15
+#define ZC_HKEY_OPCODES 0x16
+#define ZC_HKEY_MAX 0x16
 #define ZC_ESCAPE 0x1b
 #define ZC_DEL_WORD 0x1c
 #define ZC_WORD_RIGHT 0x1d
@@ -511,7 +546,13 @@ extern long story_size;
 extern zword stack[STACK_SIZE];
 extern zword *sp;
 extern zword *fp;
+
+/* Before popping n words off the stack, or looking at the top one, check
+ * they are there above the frame; before pushing, check there is room */
+#define CHECK_POP(n)	{ if (fp - sp < (long) (n)) runtime_error(ERR_STK_UNDF); }
+#define CHECK_PUSH	{ if (sp <= stack) runtime_error(ERR_STK_OVF); }
 extern zword frame_count;
+extern zlong instruction_count;
 
 extern zword zargs[8];
 extern int zargc;
@@ -521,6 +562,7 @@ extern bool ostream_script;
 extern bool ostream_memory;
 extern bool ostream_record;
 extern bool istream_replay;
+extern bool fast_forward;
 extern bool message;
 
 extern int cwin;
@@ -659,6 +701,18 @@ void 	z_verify(void);
 void 	z_window_size(void);
 void 	z_window_style(void);
 
+/*** Handlers for instructions proven safe, without the checks ***/
+extern bool trusted;
+void	trust_opcodes(void);
+void 	z_call_n_unchecked(void);
+void 	z_call_s_unchecked(void);
+void 	z_clear_attr_unchecked(void);
+void 	z_jump_unchecked(void);
+void 	z_set_attr_unchecked(void);
+void 	z_storeb_unchecked(void);
+void 	z_storew_unchecked(void);
+void 	z_test_attr_unchecked(void);
+
 
 /* Definitions for error handling functions and error codes. */
 /* extern int err_report_mode; */
@@ -749,9 +803,34 @@ void 	branch(bool);
 
 void	storeb(zword, zbyte);
 void	storew(zword, zword);
+void	storeb_unchecked(zword, zbyte);
+void	storew_unchecked(zword, zword);
+bool	range_writable(zword, zword);
+void	range_written(zword, zword);
 
 void	end_of_sound(void);
 
+/* Bytes of dynamic memory that property indexes depend on (object.c) */
+extern zbyte *prop_watch;
+#define PROP_WATCHED(addr) (prop_watch != NULL && \
+	(zword) (addr) < z_header.dynamic_size && \
+	(prop_watch[(zword) (addr) >> 3] & (1 << ((addr) & 7))))
+
+void	reset_property_index(void);
+void	property_store(zword);
+
+/* Highest object number from V4 on; up to V3 it is 255 */
+#define MAX_OBJECT 2000
+
+/* Object table entries whose tree links are shadowed (object.c) */
+extern zword obj_table_start;
+extern zword obj_table_end;
+#define OBJ_WATCHED(addr) ((zword) (addr) >= obj_table_start && \
+	(zword) (addr) < obj_table_end)
+
+void	reset_object_tree(void);
+void	object_tree_store(zword);
+
 int	completion(const zchar *buffer, zchar *result);
 
 bool is_terminator(zchar);
@@ -772,6 +851,144 @@ int cdecl zgetopt(int, char **, const char *);
 /*** Unconditionally perform a save ***/
 zword save_frotz(FILE *);
 
+/*** Save to a file on the background writer, if there is one ***/
+zword save_frotz_later(const char *);
+bool bg_save_flush(void);
+
+/*** Save to and restore from a Quetzal image in memory ***/
+zword save_frotz_mem(membuf_t *);
+zword restore_frotz_mem(const zbyte *, long);
+
+/*** Save a delta against the last save, and measure a chain of them ***/
+zword save_frotz_delta(membuf_t *);
+int quetzal_chain_length(const zbyte *, long);
+
+/*** Keep saves in a content-addressed store (store.c) ***/
+zword store_save(const char *);
+zword store_restore(const char *);
+bool store_exists(const char *);
+long store_collect(void);
+
+/*** Forget all undo states ***/
+void clear_undo(void);
+
+/*** Per-turn telemetry (telemetry.c) ***/
+typedef struct {
+	zlong printed;		/* Characters sent to the screen or transcript */
+	zlong storeb;
+	zlong storew;
+	zlong undo_bytes;	/* Size of undo states saved */
+	zlong undo_usec;	/* Time taken to save them */
+	zlong saves;
+	zlong save_bytes;	/* Size of saves written in the foreground */
+} turn_stats_t;
+extern bool telemetry;
+extern turn_stats_t turn_stats;
+void telemetry_open(void);
+void telemetry_input(void);
+void telemetry_resume(void);
+zlong telemetry_usec(void);
+
+/*** Static analysis of the story (symbols.c) ***/
+#define SYM_INSN	0x01	/* An instruction starts here */
+#define SYM_ROUTINE	0x02	/* A routine header starts here */
+#define SYM_STRING	0x04	/* A string starts here */
+#define SYM_CODE	0x08	/* Part of an instruction or routine header */
+#define SYM_TEXT	0x10	/* Part of a string */
+#define SYM_SAFE	0x20	/* An instruction that cannot fail its checks */
+extern zbyte *symbols;
+void init_symbols(void);
+long symbol_routine(long);
+
+/*** Execution coverage map (cover.c) ***/
+extern bool coverage;
+extern zbyte *cover_code;
+extern zbyte *cover_text;
+#define COVER_MARK(map, a) { map[(a) >> 3] |= 1 << ((a) & 7); }
+void cover_start(void);
+void cover_open(void);
+void cover_write(bool);
+
+/*** Hashes and a repeatable random number generator (hash.c) ***/
+#define HASH_START 2166136261UL
+zlong hash_bytes(zlong, const zbyte *, long);
+zlong hash_word(zlong, zword);
+zlong xorshift(zlong *);
+
+/*** Crash flight recorder (flight.c) ***/
+#define FLIGHT_CALL 0
+#define FLIGHT_RET 1
+typedef struct {
+	zlong when;		/* Instruction count at the time */
+	long addr;		/* Routine called, or address returned to */
+	zword depth;		/* Frames on the stack afterwards */
+	zword kind;
+} flight_event_t;
+extern zlong flight_ring[FLIGHT_SIZE];
+extern flight_event_t flight_events[FLIGHT_EVENTS];
+extern zlong flight_event_count;
+#define FLIGHT_EVENT(k, a) { \
+	flight_event_t *e = &flight_events[++flight_event_count & \
+					   (FLIGHT_EVENTS - 1)]; \
+	e->when = instruction_count; \
+	e->addr = (a); \
+	e->depth = frame_count; \
+	e->kind = (k); }
+void flight_open(void);
+void flight_dump(const char *);
+#ifndef MSDOS_16BIT
+#define MAX_CRASH_SIGNALS 8
+extern const int crash_signals[];
+extern const int crash_signal_count;
+#endif
+
+/*** Machine state traces for comparing two runs (lockstep.c) ***/
+extern bool lockstep;
+extern zlong lockstep_next;
+void lockstep_open(void);
+void lockstep_record(void);
+void lockstep_close(void);
+void lockstep_char(zchar);
+
+#ifndef NO_SAMPLING
+/*** Sampling profiler (sampler.c) ***/
+extern bool sampling;
+extern zbyte *routine_map;
+void sampler_open(void);
+void sampler_drain(void);
+#endif
+
+#ifdef PROFILING
+/*** Routine profiler (profile.c) ***/
+extern bool profiling;
+void profile_open(void);
+void profile_call(long);
+void profile_ret(void);
+
+/*** Opcode histograms (opstats.c) ***/
+#define OPSTAT_EXT 0x100	/* Extended opcodes from here on */
+#define OPSTAT_NONE 0x200	/* Not in an instruction */
+#define OPSTAT_SIZE 0x201
+typedef struct {
+	zlong count;
+	zlong branch_taken;
+	zlong branch_not_taken;
+	zlong store_stack;
+	zlong store_local;
+	zlong store_global;
+	zlong samples;
+	zlong cycles;
+} opstat_t;
+extern opstat_t opstats[OPSTAT_SIZE];
+extern opstat_t *opstat_current;
+extern zlong opstat_interval;
+extern zlong opstat_countdown;
+zlong opstat_cycles(void);
+void opstat_sample(zlong);
+void opstats_write(const char *);
+void opstats_show(void);
+#endif
+
 
 /*** returns the current window ***/
 Zwindow * curwinrec(void);
@@ -0,0 +1,4 @@
+#define VERSION "2.51"
+#define GIT_HASH "154480d1ab37ee5563136705ad820f761f665112"
+#define GIT_HASH_SHORT "154480d"
+#define GIT_DATE "2026-10-18 21:41:28 +0000"
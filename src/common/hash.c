@@ -0,0 +1,83 @@
+/* hash.c - Small hashes and a repeatable random number generator
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Several parts of the interpreter need a quick way to tell whether
+ * two lots of data are the same without keeping both: delta saves
+ * name the memory they apply to, fast-forward hashes what it would
+ * have printed, lockstep traces hash the stack, memory and output,
+ * and the fuzzer names its test cases.  They all use the 32-bit FNV-1a
+ * hash here, starting from HASH_START.  A word is hashed as two bytes,
+ * low byte first.
+ *
+ * The fuzzer and the benchmark also need random numbers that come out
+ * the same every time for a given seed, which the Z-machine generator
+ * in random.c does not promise; xorshift() gives them.
+ */
+
+#include "frotz.h"
+
+#define FNV_PRIME 16777619UL
+
+
+/*
+ * hash_bytes
+ *
+ * Add bytes to a hash and return the result.
+ *
+ */
+zlong hash_bytes(zlong hash, const zbyte *p, long length)
+{
+	while (length-- > 0) {
+		hash ^= *p++;
+		hash = (hash * FNV_PRIME) & 0xffffffffUL;
+	}
+	return hash;
+} /* hash_bytes */
+
+
+/*
+ * hash_word
+ *
+ * Add a word to a hash, low byte first, and return the result.
+ *
+ */
+zlong hash_word(zlong hash, zword w)
+{
+	hash ^= w & 0xff;
+	hash = (hash * FNV_PRIME) & 0xffffffffUL;
+	hash ^= w >> 8;
+	return (hash * FNV_PRIME) & 0xffffffffUL;
+} /* hash_word */
+
+
+/*
+ * xorshift
+ *
+ * Step a 32-bit xorshift generator on from a state, which must not be
+ * zero, and return the new state.
+ *
+ */
+zlong xorshift(zlong *state)
+{
+	*state ^= (*state << 13) & 0xffffffffUL;
+	*state ^= *state >> 17;
+	*state ^= (*state << 5) & 0xffffffffUL;
+	return *state;
+} /* xorshift */
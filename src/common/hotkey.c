@@ -18,6 +18,9 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "frotz.h"
 
 extern int restore_undo (void);
@@ -64,6 +67,7 @@ static bool hot_key_help(void)
 		"Alt-D  debugging options\n"
 		"Alt-H  help\n"
 		"Alt-N  new game\n"
+		"Alt-O  opcode statistics\n"
 		"Alt-P  playback on\n"
 		"Alt-R  recording on/off\n"
 		"Alt-S  seed random numbers\n"
@@ -73,6 +77,36 @@ static bool hot_key_help(void)
 } /* hot_key_help */
 
 
+/*
+ * hot_key_opcodes
+ *
+ * ...shows the opcodes run most often.
+ *
+ */
+static bool hot_key_opcodes(void)
+{
+	print_string("Opcode statistics\n");
+#ifdef PROFILING
+	opstats_show();
+	if (f_setup.profile_file != NULL) {
+		char *name = malloc(strlen(f_setup.profile_file) + 9);
+
+		if (name != NULL) {
+			sprintf(name, "%s.opcodes", f_setup.profile_file);
+			opstats_write(name);
+			print_string("Full table written to ");
+			print_string(name);
+			new_line();
+			free(name);
+		}
+	}
+#else
+	print_string("Frotz was built without PROFILING.\n");
+#endif
+	return FALSE;
+} /* hot_key_opcodes */
+
+
 /*
  * hot_key_playback
  *
@@ -209,6 +243,7 @@ bool handle_hot_key(zchar key)
 		case ZC_HKEY_QUIT: aborting = hot_key_quit(); break;
 		case ZC_HKEY_DEBUG: aborting = hot_key_debugging(); break;
 		case ZC_HKEY_HELP: aborting = hot_key_help(); break;
+		case ZC_HKEY_OPCODES: aborting = hot_key_opcodes(); break;
 		}
 
 		if (aborting)
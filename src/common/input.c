@@ -178,6 +178,9 @@ void z_read(void)
 	if (z_header.version >= V5) {
 		addr++;
 		LOW_BYTE(addr, size);
+		/* A broken story may claim more than the buffer holds */
+		if (size > max)
+			size = max;
 	} else size = 0;
 
 	/* Copy initial input to local buffer */
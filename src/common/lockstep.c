@@ -0,0 +1,232 @@
+/* lockstep.c - Machine state traces for comparing two runs
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * To make sure a change to the interpreter leaves what stories do as
+ * it was, a story is run twice, under the old and the new interpreter
+ * or with and without some option, and the state of the machine is
+ * compared as the two go along.  Given a trace file, interpret() calls
+ * lockstep_record() every f_setup.lockstep_every instructions, which
+ * writes a line like this:
+ *
+ *	12000 00a3f2 e0 118 6 5c1e07a2 9d40e311 0a6e4f13
+ *
+ * that is, the number of instructions run, the address and opcode byte
+ * of the last of them, the number of words on the stack and of frames,
+ * and a hash of the words on the stack, of dynamic memory and of all
+ * the text printed so far, which stream.c passes to lockstep_char().
+ * The last catches stories that part and then come together again
+ * between one line and the next, having printed something different
+ * on the way.  Another line is written when the story ends.  Lines are
+ * only written from instruction f_setup.lockstep_from on and, if
+ * f_setup.lockstep_to is set, the story is stopped after that
+ * instruction.  src/test/lockstep.sh compares the traces of two runs,
+ * and runs both again with a line for every instruction after the last
+ * that matched to find the first one that does not.
+ *
+ * Hashing all of dynamic memory for every line would be slow, so a copy
+ * is kept and only the blocks of LOCKSTEP_BLOCK bytes that differ from
+ * it are hashed again.  The hash of memory is the exclusive or of the
+ * hashes of the blocks, each of which starts from its number, and so is
+ * brought up to date by taking out the old hash of a block and putting
+ * in the new.  Comparing with a copy sees every change, whether made by
+ * a store, a restore, an undo or a copy of a whole table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frotz.h"
+
+#define LOCKSTEP_BLOCK 256
+
+bool lockstep = FALSE;
+zlong lockstep_next = 0;
+
+static FILE *trace = NULL;
+static zbyte *shadow = NULL;
+static zlong *block_hash = NULL;
+static long blocks;
+static zlong memory_hash;
+static zlong output_hash = HASH_START;
+static zlong last_record;
+
+
+/*
+ * hash_block
+ *
+ * Hash a block of dynamic memory as it is now.
+ *
+ */
+static zlong hash_block(long i)
+{
+	long start = i * LOCKSTEP_BLOCK;
+	long length = z_header.dynamic_size - start;
+
+	if (length > LOCKSTEP_BLOCK)
+		length = LOCKSTEP_BLOCK;
+	return hash_bytes((HASH_START ^ (zlong) i) & 0xffffffffUL,
+			  zmp + start, length);
+} /* hash_block */
+
+
+/*
+ * update_memory_hash
+ *
+ * Hash again the blocks of dynamic memory that have changed since the
+ * last time.
+ *
+ */
+static void update_memory_hash(void)
+{
+	long i;
+	long start;
+	long length;
+
+	for (i = 0; i < blocks; i++) {
+		start = i * LOCKSTEP_BLOCK;
+		length = z_header.dynamic_size - start;
+		if (length > LOCKSTEP_BLOCK)
+			length = LOCKSTEP_BLOCK;
+		if (memcmp(shadow + start, zmp + start, length) == 0)
+			continue;
+		memcpy(shadow + start, zmp + start, length);
+		memory_hash ^= block_hash[i];
+		block_hash[i] = hash_block(i);
+		memory_hash ^= block_hash[i];
+	}
+} /* update_memory_hash */
+
+
+/*
+ * lockstep_char
+ *
+ * Add a character sent to the output streams to the hash of them.
+ *
+ */
+void lockstep_char(zchar c)
+{
+	output_hash = hash_word(output_hash, c);
+} /* lockstep_char */
+
+
+/*
+ * write_record
+ *
+ * Write a line of the trace for the state of the machine now.
+ *
+ */
+static void write_record(void)
+{
+	zlong last = flight_ring[instruction_count & (FLIGHT_SIZE - 1)];
+	zlong stack_hash = HASH_START;
+	zword *p;
+
+	for (p = sp; p < stack + STACK_SIZE; p++)
+		stack_hash = hash_word(stack_hash, *p);
+	update_memory_hash();
+
+	fprintf(trace, "%lu %06lx %02x %ld %u %08lx %08lx %08lx\n",
+		instruction_count, last >> 8, (unsigned) (last & 0xff),
+		(long) (stack + STACK_SIZE - sp), (unsigned) frame_count,
+		stack_hash, memory_hash, output_hash);
+	last_record = instruction_count;
+} /* write_record */
+
+
+/*
+ * lockstep_record
+ *
+ * Called by interpret() when lockstep_next instructions have been run.
+ * Write a line, and stop the story if that was the last one wanted.
+ *
+ */
+void lockstep_record(void)
+{
+	write_record();
+	lockstep_next = instruction_count + f_setup.lockstep_every;
+
+	if (f_setup.lockstep_to != 0 &&
+	    instruction_count >= f_setup.lockstep_to) {
+		fclose(trace);
+		trace = NULL;
+		lockstep = FALSE;
+		z_quit();
+	}
+} /* lockstep_record */
+
+
+/*
+ * lockstep_close
+ *
+ * Write the state the story ended in and close the trace.  This is
+ * called when the story ends, and at exit in case of a fatal error.
+ *
+ */
+void lockstep_close(void)
+{
+	if (trace == NULL)
+		return;
+	if (zmp != NULL && instruction_count != last_record &&
+	    instruction_count >= f_setup.lockstep_from)
+		write_record();
+	fclose(trace);
+	trace = NULL;
+	lockstep = FALSE;
+} /* lockstep_close */
+
+
+/*
+ * lockstep_open
+ *
+ * Open the trace file, if one was asked for, and hash dynamic memory
+ * as it is at the start.
+ *
+ */
+void lockstep_open(void)
+{
+	long i;
+
+	if (f_setup.lockstep_file == NULL || lockstep)
+		return;
+
+	if ((trace = fopen(f_setup.lockstep_file, "w")) == NULL)
+		os_fatal("Can't open the lockstep trace file (-W).");
+
+	blocks = (z_header.dynamic_size + LOCKSTEP_BLOCK - 1) / LOCKSTEP_BLOCK;
+	shadow = malloc(z_header.dynamic_size);
+	block_hash = malloc(blocks * sizeof(zlong));
+	if (shadow == NULL || block_hash == NULL)
+		os_fatal("Out of memory");
+
+	memcpy(shadow, zmp, z_header.dynamic_size);
+	memory_hash = 0;
+	for (i = 0; i < blocks; i++) {
+		block_hash[i] = hash_block(i);
+		memory_hash ^= block_hash[i];
+	}
+
+	if (f_setup.lockstep_every == 0)
+		f_setup.lockstep_every = LOCKSTEP_EVERY;
+	lockstep_next = f_setup.lockstep_from > 0 ? f_setup.lockstep_from :
+		f_setup.lockstep_every;
+	last_record = instruction_count;
+	lockstep = TRUE;
+	atexit(lockstep_close);
+} /* lockstep_open */
@@ -36,6 +36,7 @@ extern void init_memory (void);
 extern void init_undo (void);
 extern void reset_screen (void);
 extern void reset_memory (void);
+extern void fast_forward_open (void);
 
 bool need_newline_at_exit = FALSE;
 
@@ -56,12 +57,16 @@ zword *sp = 0;
 zword *fp = 0;
 zword frame_count = 0;
 
+/* Instructions executed so far */
+zlong instruction_count = 0;
+
 /* IO streams */
 bool ostream_screen = TRUE;
 bool ostream_script = FALSE;
 bool ostream_memory = FALSE;
 bool ostream_record = FALSE;
 bool istream_replay = FALSE;
+bool fast_forward = FALSE;
 bool message = FALSE;
 
 /* Current window and mouse data */
@@ -115,8 +120,21 @@ int cdecl main(int argc, char *argv[])
 	init_sound();
 	os_init_screen();
 	init_undo();
+	flight_open();
+	cover_open();
+	lockstep_open();
+	telemetry_open();
+#ifndef NO_SAMPLING
+	sampler_open();
+#endif
+#ifdef PROFILING
+	profile_open();
+#endif
 	z_restart();
+	if (f_setup.replay_file != NULL)
+		fast_forward_open();
 	interpret();
+	lockstep_close();
 	reset_screen();
 	reset_memory();
 	os_reset_screen();
@@ -18,13 +18,13 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdlib.h>
+#include <string.h>
 #include "frotz.h"
 
 f_setup_t f_setup;
 z_header_t z_header;
 
-#define MAX_OBJECT 2000
-
 #define O1_PARENT 4
 #define O1_SIBLING 5
 #define O1_CHILD 6
@@ -37,13 +37,76 @@ z_header_t z_header;
 #define O4_PROPERTY_OFFSET 12
 #define O4_SIZE 14
 
+/*
+ * Property index.  Looking up a property means walking the object's
+ * property list from the start every time, and Inform games look up
+ * several properties of every object in scope every turn.  Instead,
+ * the first lookup on an object records where each property number
+ * ends up in the list, and later lookups are a single array access.
+ *
+ * The index is a small direct mapped cache of objects.  The bytes
+ * that determine the layout of an indexed property list (the property
+ * table pointer in the object, the name length and every size byte)
+ * are marked in prop_watch, a bitmap over dynamic memory.  storeb()
+ * calls property_store() for a marked byte, which drops the indexes
+ * that depend on it.  Bits are only cleared by reset_property_index(),
+ * so a stale bit just costs an unnecessary check.
+ */
+#ifndef PROP_INDEX_SLOTS
+#ifdef MSDOS_16BIT
+#define PROP_INDEX_SLOTS 16
+#else
+#define PROP_INDEX_SLOTS 256
+#endif
+#endif
+
+typedef struct {
+	zword obj;		/* 0 if the slot is unused */
+	zword ptr_addr;		/* address of the property table pointer */
+	zword start;		/* address of the name length byte */
+	zword end;		/* address after the end of the list */
+	zword first;		/* address of the first property */
+	zword prop[64];		/* address of each property, 0 if absent */
+} prop_index_t;
+
+static prop_index_t prop_index[PROP_INDEX_SLOTS];
+
+zbyte *prop_watch = NULL;
+
+/*
+ * Object tree.  The parent, sibling and child links of every object
+ * are also kept decoded in obj_links, so following them doesn't need
+ * an address calculation and a version check each time.  The links
+ * in Z-machine memory are always updated too, so saving and restoring
+ * see the usual object table.  storeb() calls object_tree_store() for
+ * writes between obj_table_start and obj_table_end to pick up changes
+ * made by the story itself.
+ */
+#define LINK_PARENT 0
+#define LINK_SIBLING 1
+#define LINK_CHILD 2
+
+static zword (*obj_links)[3] = NULL;
+static zword obj_count = 0;
+
+zword obj_table_start = 0;
+zword obj_table_end = 0;
+
 
 /*
- * object_address
+ * object_address, object_address_unchecked
  *
- * Calculate the address of an object.
+ * Calculate the address of an object, or of one known to be legal.
  *
  */
+static zword object_address_unchecked(zword obj)
+{
+	if (z_header.version <= V3)
+		return z_header.objects + ((obj - 1) * O1_SIZE + 62);
+	else
+		return z_header.objects + ((obj - 1) * O4_SIZE + 126);
+} /* object_address_unchecked */
+
 static zword object_address(zword obj)
 {
 	/* Check object number */
@@ -56,10 +119,7 @@ static zword object_address(zword obj)
 	}
 
 	/* Return object address */
-	if (z_header.version <= V3)
-		return z_header.objects + ((obj - 1) * O1_SIZE + 62);
-	else
-		return z_header.objects + ((obj - 1) * O4_SIZE + 126);
+	return object_address_unchecked(obj);
 } /* object_address */
 
 
@@ -141,6 +201,298 @@ static zword next_property(zword prop_addr)
 } /* next_property */
 
 
+/*
+ * watch_byte
+ *
+ * Mark a byte of dynamic memory as one a property index depends on.
+ *
+ */
+static void watch_byte(zword addr)
+{
+	if (addr < z_header.dynamic_size)
+		prop_watch[addr >> 3] |= 1 << (addr & 7);
+} /* watch_byte */
+
+
+/*
+ * reset_property_index
+ *
+ * Forget all property indexes.  This must be called whenever dynamic
+ * memory is replaced wholesale (restart, restore and undo).
+ *
+ */
+void reset_property_index(void)
+{
+	int i;
+
+	for (i = 0; i < PROP_INDEX_SLOTS; i++)
+		prop_index[i].obj = 0;
+	if (prop_watch != NULL)
+		memset(prop_watch, 0, (z_header.dynamic_size + 7) / 8);
+} /* reset_property_index */
+
+
+/*
+ * property_store
+ *
+ * A byte some property index depends on is about to be modified.
+ * Drop every index built from it.
+ *
+ */
+void property_store(zword addr)
+{
+	prop_index_t *p;
+	int i;
+
+	for (i = 0, p = prop_index; i < PROP_INDEX_SLOTS; i++, p++) {
+		if (p->obj == 0)
+			continue;
+		if (addr == p->ptr_addr || addr == (zword) (p->ptr_addr + 1)
+		    || (addr >= p->start && addr < p->end))
+			p->obj = 0;
+	}
+} /* property_store */
+
+
+/*
+ * build_property_index
+ *
+ * Walk the property list of an object once and record where a scan
+ * for each property number would stop.  A scan for property n stops
+ * at the first entry whose number is n or less, and finds the property
+ * only if the number is exactly n.  Entries after a lower numbered
+ * one are unreachable, and so are left out of the index.
+ *
+ */
+static prop_index_t *build_property_index(zword obj)
+{
+	prop_index_t *p = &prop_index[obj % PROP_INDEX_SLOTS];
+	zword prop_addr;
+	zbyte value;
+	zbyte mask;
+	zbyte lowest;
+
+	if (prop_watch == NULL) {
+		prop_watch = calloc((z_header.dynamic_size + 7) / 8, 1);
+		if (prop_watch == NULL)
+			return NULL;
+	}
+
+	mask = (z_header.version <= V3) ? 0x1f : 0x3f;
+
+	p->ptr_addr = object_address(obj) +
+		((z_header.version <= V3) ? O1_PROPERTY_OFFSET : O4_PROPERTY_OFFSET);
+	watch_byte(p->ptr_addr);
+	watch_byte(p->ptr_addr + 1);
+
+	p->start = object_name(obj);
+	watch_byte(p->start);
+	p->first = first_property(obj);
+	memset(p->prop, 0, sizeof (p->prop));
+
+	prop_addr = p->first;
+	lowest = mask + 1;
+	for (;;) {
+		LOW_BYTE(prop_addr, value)
+		watch_byte(prop_addr);
+		if (z_header.version >= V4 && (value & 0x80))
+			watch_byte(prop_addr + 1);
+		value &= mask;
+		if (value < lowest) {
+			p->prop[value] = prop_addr;
+			lowest = value;
+		}
+		if (value == 0)
+			break;
+		prop_addr = next_property(prop_addr);
+	}
+	p->end = prop_addr + 1;
+	p->obj = obj;
+
+	return p;
+} /* build_property_index */
+
+
+/*
+ * find_property
+ *
+ * Return the address of the given property of an object, pointing at
+ * its size byte, or 0 if the object doesn't have the property.
+ *
+ */
+static zword find_property(zword obj, zword prop)
+{
+	prop_index_t *p;
+	zbyte mask;
+
+	mask = (z_header.version <= V3) ? 0x1f : 0x3f;
+	if (prop > mask)
+		return 0;
+
+	p = &prop_index[obj % PROP_INDEX_SLOTS];
+	if (p->obj != obj) {
+		/* Illegal objects are left to the unindexed path */
+		if (obj > ((z_header.version <= V3) ? 255 : MAX_OBJECT)
+		    || (p = build_property_index(obj)) == NULL) {
+			zword prop_addr = first_property(obj);
+			zbyte value;
+
+			for (;;) {
+				LOW_BYTE(prop_addr, value)
+				if ((value & mask) <= prop)
+					break;
+				prop_addr = next_property(prop_addr);
+			}
+			return ((value & mask) == prop) ? prop_addr : 0;
+		}
+	}
+	return p->prop[prop];
+} /* find_property */
+
+
+/*
+ * load_links
+ *
+ * Decode the tree links of an object from Z-machine memory.
+ *
+ */
+static void load_links(zword obj)
+{
+	zword addr = object_address(obj);
+
+	if (z_header.version <= V3) {
+		obj_links[obj][LINK_PARENT] = zmp[addr + O1_PARENT];
+		obj_links[obj][LINK_SIBLING] = zmp[addr + O1_SIBLING];
+		obj_links[obj][LINK_CHILD] = zmp[addr + O1_CHILD];
+	} else {
+		addr += O4_PARENT;
+		LOW_WORD(addr, obj_links[obj][LINK_PARENT])
+		addr += O4_SIBLING - O4_PARENT;
+		LOW_WORD(addr, obj_links[obj][LINK_SIBLING])
+		addr += O4_CHILD - O4_SIBLING;
+		LOW_WORD(addr, obj_links[obj][LINK_CHILD])
+	}
+} /* load_links */
+
+
+/*
+ * reset_object_tree
+ *
+ * Decode the links of all objects.  This must be called whenever
+ * dynamic memory is replaced wholesale (restart, restore and undo).
+ * The first call also works out how many objects there are: the
+ * object table runs up to the first property table.
+ *
+ */
+void reset_object_tree(void)
+{
+	zword obj;
+
+	if (obj_links == NULL) {
+		zword size = (z_header.version <= V3) ? O1_SIZE : O4_SIZE;
+		zword limit = (z_header.version <= V3) ? 255 : MAX_OBJECT;
+		zword lowest = 0xffff;
+		zword addr;
+		zword prop;
+
+		obj_table_start = object_address(1);
+		for (addr = obj_table_start; obj_count < limit; addr += size) {
+			if (addr >= lowest ||
+			    (long) addr + size > z_header.dynamic_size)
+				break;
+			prop = addr + size - 2;
+			LOW_WORD(prop, prop)
+			if (prop > addr && prop < lowest)
+				lowest = prop;
+			obj_count++;
+		}
+		obj_table_end = obj_table_start + obj_count * size;
+
+		obj_links = malloc((obj_count + 1) * sizeof (*obj_links));
+		if (obj_links == NULL) {
+			obj_count = 0;
+			obj_table_end = obj_table_start;
+			return;
+		}
+	}
+
+	for (obj = 1; obj <= obj_count; obj++)
+		load_links(obj);
+} /* reset_object_tree */
+
+
+/*
+ * object_tree_store
+ *
+ * The story has written to the object table.  Reload the links of
+ * the object that was written to.
+ *
+ */
+void object_tree_store(zword addr)
+{
+	zword size = (z_header.version <= V3) ? O1_SIZE : O4_SIZE;
+
+	load_links((addr - obj_table_start) / size + 1);
+} /* object_tree_store */
+
+
+/*
+ * get_link
+ *
+ * Return the parent, sibling or child of an object.
+ *
+ */
+static zword get_link(zword obj, int link)
+{
+	zword addr;
+
+	if (obj != 0 && obj <= obj_count)
+		return obj_links[obj][link];
+
+	addr = object_address(obj);
+
+	if (z_header.version <= V3) {
+		zbyte value;
+
+		addr += O1_PARENT + link;
+		LOW_BYTE(addr, value)
+		return value;
+	} else {
+		zword value;
+
+		addr += O4_PARENT + 2 * link;
+		LOW_WORD(addr, value)
+		return value;
+	}
+} /* get_link */
+
+
+/*
+ * set_link
+ *
+ * Set the parent, sibling or child of an object.
+ *
+ */
+static void set_link(zword obj, int link, zword value)
+{
+	zword addr = object_address(obj);
+
+	if (z_header.version <= V3) {
+		zbyte v = value;
+
+		addr += O1_PARENT + link;
+		SET_BYTE(addr, v)
+		value = v;
+	} else {
+		addr += O4_PARENT + 2 * link;
+		SET_WORD(addr, value)
+	}
+
+	if (obj != 0 && obj <= obj_count)
+		obj_links[obj][link] = value;
+} /* set_link */
+
+
 /*
  * unlink_object
  *
@@ -149,87 +501,45 @@ static zword next_property(zword prop_addr)
  */
 static void unlink_object(zword object)
 {
-	zword obj_addr;
-	zword parent_addr;
-	zword sibling_addr;
+	zword parent;
+	zword younger_sibling;
+	zword older_sibling;
+	zword sibling = 0;
+	long steps;
 
 	if (object == 0) {
 		runtime_error(ERR_REMOVE_OBJECT_0);
 		return;
 	}
 
-	obj_addr = object_address (object);
+	/* Get parent of object, and return if no parent */
+	if (!(parent = get_link(object, LINK_PARENT)))
+		return;
 
-	if (z_header.version <= V3) {
-		zbyte parent;
-		zbyte younger_sibling;
-		zbyte older_sibling;
-		zbyte zero = 0;
-
-		/* Get parent of object, and return if no parent */
-		obj_addr += O1_PARENT;
-		LOW_BYTE(obj_addr, parent)
-		if (!parent)
-			return;
+	/* Get (older) sibling of object and set both parent and sibling
+	 * pointers to 0 */
+	older_sibling = get_link(object, LINK_SIBLING);
+	set_link(object, LINK_PARENT, 0);
+	set_link(object, LINK_SIBLING, 0);
 
-		/* Get (older) sibling of object and set both
-		 * parent and sibling pointers to 0 */
-		SET_BYTE(obj_addr, zero)
-		obj_addr += O1_SIBLING - O1_PARENT;
-		LOW_BYTE(obj_addr, older_sibling)
-		SET_BYTE(obj_addr, zero)
-
-		/* Get first child of parent (the youngest sibling
-		 * of the object) */
-		parent_addr = object_address(parent) + O1_CHILD;
-		LOW_BYTE(parent_addr, younger_sibling)
-
-		/* Remove object from the list of siblings */
-		if (younger_sibling == object)
-			SET_BYTE(parent_addr, older_sibling)
-		else {
-			do {
-				sibling_addr = object_address(younger_sibling)
-					+ O1_SIBLING;
-				LOW_BYTE(sibling_addr, younger_sibling)
-			} while (younger_sibling != object);
-			SET_BYTE(sibling_addr, older_sibling)
-		}
-	} else {
-		zword parent;
-		zword younger_sibling;
-		zword older_sibling;
-		zword zero = 0;
-
-		/* Get parent of object, and return if no parent */
-		obj_addr += O4_PARENT;
-		LOW_WORD(obj_addr, parent)
-		if (!parent)
-			return;
+	/* Get first child of parent (the youngest sibling of the object) */
+	younger_sibling = get_link(parent, LINK_CHILD);
 
-		/* Get (older) sibling of object and set both parent
-		 * and sibling pointers to 0 */
-		SET_WORD(obj_addr, zero)
-		obj_addr += O4_SIBLING - O4_PARENT;
-		LOW_WORD(obj_addr, older_sibling)
-		SET_WORD(obj_addr, zero)
-
-		/* Get first child of parent (the youngest sibling
-		 * of the object) */
-		parent_addr = object_address(parent) + O4_CHILD;
-		LOW_WORD(parent_addr, younger_sibling)
-
-		/* Remove object from the list of siblings */
-		if (younger_sibling == object)
-			SET_WORD(parent_addr, older_sibling)
-		else {
-			do {
-				sibling_addr = object_address(younger_sibling)
-					+ O4_SIBLING;
-				LOW_WORD(sibling_addr, younger_sibling)
-			} while (younger_sibling != object);
-			SET_WORD(sibling_addr, older_sibling)
+	/* Remove object from the list of siblings */
+	if (younger_sibling == object)
+		set_link(parent, LINK_CHILD, older_sibling);
+	else {
+		/* In a broken tree the object may not be among the children,
+		 * or the siblings may go round in a circle */
+		for (steps = 0; younger_sibling != object; steps++) {
+			if (younger_sibling == 0 || steps > 0xffff) {
+				runtime_error(ERR_ILL_OBJ);
+				return;
+			}
+			sibling = younger_sibling;
+			younger_sibling = get_link(sibling, LINK_SIBLING);
 		}
+		set_link(sibling, LINK_SIBLING, older_sibling);
 	}
 } /* unlink_object */
 
@@ -240,8 +550,11 @@ static void unlink_object(zword object)
  *	zargs[0] = object
  *	zargs[1] = number of attribute to be cleared
  *
+ * z_clear_attr_unchecked is for a legal object and attribute given as
+ * constants.
+ *
  */
-void z_clear_attr(void)
+static void clear_attr(bool checked)
 {
 	zword obj_addr;
 	zbyte value;
@@ -250,7 +563,7 @@ void z_clear_attr(void)
 		if (zargs[1] == 48)
 			return;
 
-	if (zargs[1] > ((z_header.version <= V3) ? 31 : 47))
+	if (checked && zargs[1] > ((z_header.version <= V3) ? 31 : 47))
 		runtime_error(ERR_ILL_ATTR);
 
 	/* If we are monitoring attribute assignment display a short note */
@@ -264,20 +577,31 @@ void z_clear_attr(void)
 		stream_mssg_off();
 	}
 
-	if (zargs[0] == 0) {
+	if (checked && zargs[0] == 0) {
 		runtime_error(ERR_CLEAR_ATTR_0);
 		return;
 	}
 
 	/* Get attribute address */
-	obj_addr = object_address(zargs[0]) + zargs[1] / 8;
+	obj_addr = (checked ? object_address(zargs[0]) :
+		    object_address_unchecked(zargs[0])) + zargs[1] / 8;
 
 	/* Clear attribute bit */
 	LOW_BYTE(obj_addr, value)
 	value &= ~(0x80 >> (zargs[1] & 7));
 	SET_BYTE(obj_addr, value)
+} /* clear_attr */
+
+void z_clear_attr(void)
+{
+	clear_attr(TRUE);
 } /* z_clear_attr */
 
+void z_clear_attr_unchecked(void)
+{
+	clear_attr(FALSE);
+} /* z_clear_attr_unchecked */
+
 
 /*
  * z_jin, branch if the first object is inside the second.
@@ -288,8 +612,6 @@ void z_clear_attr(void)
  */
 void z_jin(void)
 {
-	zword obj_addr;
-
 	/* If we are monitoring object locating display a short note */
 	if (f_setup.object_locating) {
 		stream_mssg_on();
@@ -306,26 +628,8 @@ void z_jin(void)
 		return;
 	}
 
-	obj_addr = object_address(zargs[0]);
-
-	if (z_header.version <= V3) {
-		zbyte parent;
-
-		/* Get parent id from object */
-		obj_addr += O1_PARENT;
-		LOW_BYTE(obj_addr, parent)
-
-		/* Branch if the parent is obj2 */
-		branch (parent == zargs[1]);
-	} else {
-		zword parent;
-		/* Get parent id from object */
-		obj_addr += O4_PARENT;
-		LOW_WORD(obj_addr, parent)
-
-		/* Branch if the parent is obj2 */
-		branch (parent == zargs[1]);
-	}
+	/* Branch if the parent is obj2 */
+	branch(get_link(zargs[0], LINK_PARENT) == zargs[1]);
 } /* z_jin */
 
 
@@ -337,7 +641,7 @@ void z_jin(void)
  */
 void z_get_child(void)
 {
-	zword obj_addr;
+	zword child;
 
 	/* If we are monitoring object locating display a short note */
 
@@ -355,29 +659,10 @@ void z_get_child(void)
 		return;
 	}
 
-	obj_addr = object_address (zargs[0]);
-
-	if (z_header.version <= V3) {
-		zbyte child;
-
-		/* Get child id from object */
-		obj_addr += O1_CHILD;
-		LOW_BYTE(obj_addr, child)
-
-		/* Store child id and branch */
-		store(child);
-		branch(child);
-	} else {
-		zword child;
-
-		/* Get child id from object */
-		obj_addr += O4_CHILD;
-		LOW_WORD(obj_addr, child)
-
-		/* Store child id and branch */
-		store(child);
-		branch(child);
-	}
+	/* Store child id and branch */
+	child = get_link(zargs[0], LINK_CHILD);
+	store(child);
+	branch(child);
 } /* z_get_child */
 
 
@@ -403,11 +688,15 @@ void z_get_next_prop(void)
 	/* Property id is in bottom five (six) bits */
 	mask = (z_header.version <= V3) ? 0x1f : 0x3f;
 
-	/* Load address of first property */
-	prop_addr = first_property(zargs[0]);
-
-	if (zargs[1] != 0) {
+	if (zargs[1] == 0) {
+		/* Load address of first property */
+		prop_addr = first_property(zargs[0]);
+	} else if ((prop_addr = find_property(zargs[0], zargs[1])) != 0) {
+		/* Skip to the property after it */
+		prop_addr = next_property(prop_addr);
+	} else {
 		/* Scan down the property list */
+		prop_addr = first_property(zargs[0]);
 		do {
 			LOW_BYTE(prop_addr, value)
 			prop_addr = next_property(prop_addr);
@@ -432,8 +721,6 @@ void z_get_next_prop(void)
  */
 void z_get_parent(void)
 {
-	zword obj_addr;
-
 	/* If we are monitoring object locating display a short note */
 
 	if (f_setup.object_locating) {
@@ -449,27 +736,8 @@ void z_get_parent(void)
 		return;
 	}
 
-	obj_addr = object_address (zargs[0]);
-
-	if (z_header.version <= V3) {
-		zbyte parent;
-
-		/* Get parent id from object */
-		obj_addr += O1_PARENT;
-		LOW_BYTE(obj_addr, parent)
-
-		/* Store parent */
-		store(parent);
-	} else {
-		zword parent;
-
-		/* Get parent id from object */
-		obj_addr += O4_PARENT;
-		LOW_WORD (obj_addr, parent)
-
-		/* Store parent */
-		store (parent);
-	}
+	/* Store parent */
+	store(get_link(zargs[0], LINK_PARENT));
 } /* z_get_parent */
 
 
@@ -486,7 +754,6 @@ void z_get_prop(void)
 	zword wprop_val;
 	zbyte bprop_val;
 	zbyte value;
-	zbyte mask;
 
 	if (zargs[0] == 0) {
 		runtime_error(ERR_GET_PROP_0);
@@ -494,22 +761,12 @@ void z_get_prop(void)
 		return;
 	}
 
-	/* Property id is in bottom five (six) bits */
-	mask = (z_header.version <= V3) ? 0x1f : 0x3f;
-
-	/* Load address of first property */
-	prop_addr = first_property(zargs[0]);
-
-	/* Scan down the property list */
-	for (;;) {
-		LOW_BYTE(prop_addr, value)
-		if ((value & mask) <= zargs[1])
-			break;
-		prop_addr = next_property(prop_addr);
-	}
+	/* Look up the property */
+	prop_addr = find_property(zargs[0], zargs[1]);
 
-	if ((value & mask) == zargs[1]) { 	/* property found */
+	if (prop_addr != 0) { 	/* property found */
 		/* Load property (byte or word sized) */
+		LOW_BYTE(prop_addr, value)
 		prop_addr++;
 		if ((z_header.version <= V3 && !(value & 0xe0)) ||
 		    (z_header.version >= V4 && !(value & 0xc0))) {
@@ -538,7 +795,6 @@ void z_get_prop_addr(void)
 {
 	zword prop_addr;
 	zbyte value;
-	zbyte mask;
 
 	if (zargs[0] == 0) {
 		runtime_error(ERR_GET_PROP_ADDR_0);
@@ -553,22 +809,12 @@ void z_get_prop_addr(void)
 		}
 	}
 
-	/* Property id is in bottom five (six) bits */
-	mask = (z_header.version <= V3) ? 0x1f : 0x3f;
-
-	/* Load address of first property */
-	prop_addr = first_property(zargs[0]);
-
-	/* Scan down the property list */
-	for (;;) {
-		LOW_BYTE(prop_addr, value)
-		if ((value & mask) <= zargs[1])
-			break;
-		prop_addr = next_property(prop_addr);
-	}
+	/* Look up the property */
+	prop_addr = find_property(zargs[0], zargs[1]);
 
 	/* Calculate the property address or return zero */
-	if ((value & mask) == zargs[1]) {
+	if (prop_addr != 0) {
+		LOW_BYTE(prop_addr, value)
 		if (z_header.version >= V4 && (value & 0x80))
 			prop_addr++;
 		store ((zword) (prop_addr + 1));
@@ -620,7 +866,7 @@ void z_get_prop_len(void)
  */
 void z_get_sibling(void)
 {
-	zword obj_addr;
+	zword sibling;
 
 	if (zargs[0] == 0) {
 		runtime_error(ERR_GET_SIBLING_0);
@@ -629,30 +875,10 @@ void z_get_sibling(void)
 		return;
 	}
 
-	obj_addr = object_address(zargs[0]);
-
-	if (z_header.version <= V3) {
-		zbyte sibling;
-
-		/* Get sibling id from object */
-		obj_addr += O1_SIBLING;
-		LOW_BYTE(obj_addr, sibling)
-
-		/* Store sibling and branch */
-		store(sibling);
-		branch(sibling);
-	} else {
-		zword sibling;
-
-		/* Get sibling id from object */
-		obj_addr += O4_SIBLING;
-		LOW_WORD(obj_addr, sibling)
-
-		/* Store sibling and branch */
-		store(sibling);
-		branch(sibling);
-	}
-
+	/* Store sibling and branch */
+	sibling = get_link(zargs[0], LINK_SIBLING);
+	store(sibling);
+	branch(sibling);
 } /* z_get_sibling */
 
 
@@ -667,8 +893,6 @@ void z_insert_obj(void)
 {
 	zword obj1 = zargs[0];
 	zword obj2 = zargs[1];
-	zword obj1_addr;
-	zword obj2_addr;
 
 	/* If we are monitoring object movements display a short note */
 	if (f_setup.object_movement) {
@@ -690,35 +914,13 @@ void z_insert_obj(void)
 		return;
 	}
 
-	/* Get addresses of both objects */
-	obj1_addr = object_address(obj1);
-	obj2_addr = object_address(obj2);
-
 	/* Remove object 1 from current parent */
 	unlink_object(obj1);
 
 	/* Make object 1 first child of object 2 */
-	if (z_header.version <= V3) {
-		zbyte child;
-
-		obj1_addr += O1_PARENT;
-		SET_BYTE(obj1_addr, obj2)
-		obj2_addr += O1_CHILD;
-		LOW_BYTE(obj2_addr, child)
-		SET_BYTE(obj2_addr, obj1)
-		obj1_addr += O1_SIBLING - O1_PARENT;
-		SET_BYTE(obj1_addr, child)
-	} else {
-		zword child;
-
-		obj1_addr += O4_PARENT;
-		SET_WORD(obj1_addr, obj2)
-		obj2_addr += O4_CHILD;
-		LOW_WORD(obj2_addr, child)
-		SET_WORD(obj2_addr, obj1)
-		obj1_addr += O4_SIBLING - O4_PARENT;
-		SET_WORD(obj1_addr, child)
-	}
+	set_link(obj1, LINK_PARENT, obj2);
+	set_link(obj1, LINK_SIBLING, get_link(obj2, LINK_CHILD));
+	set_link(obj2, LINK_CHILD, obj1);
 } /* z_insert_obj */
 
 
@@ -744,20 +946,23 @@ void z_put_prop(void)
 	/* Property id is in bottom five or six bits */
 	mask = (z_header.version <= V3) ? 0x1f : 0x3f;
 
-	/* Load address of first property */
-	prop_addr = first_property(zargs[0]);
-
-	/* Scan down the property list */
-	for (;;) {
+	/* Look up the property */
+	if ((prop_addr = find_property(zargs[0], zargs[1])) != 0) {
 		LOW_BYTE(prop_addr, value)
-		if ((value & mask) <= zargs[1])
-			break;
-		prop_addr = next_property (prop_addr);
-	}
+	} else {
+		/* Scan down the property list */
+		prop_addr = first_property(zargs[0]);
+		for (;;) {
+			LOW_BYTE(prop_addr, value)
+			if ((value & mask) <= zargs[1])
+				break;
+			prop_addr = next_property (prop_addr);
+		}
 
-	/* Exit if the property does not exist */
-	if ((value & mask) != zargs[1])
-		runtime_error(ERR_NO_PROP);
+		/* Exit if the property does not exist */
+		if ((value & mask) != zargs[1])
+			runtime_error(ERR_NO_PROP);
+	}
 
 	/* Store the new property value (byte or word sized) */
 	prop_addr++;
@@ -765,9 +970,15 @@ void z_put_prop(void)
 	if ((z_header.version <= V3 && !(value & 0xe0)) ||
 	    (z_header.version >= V4 && !(value & 0xc0))) {
 		zbyte v = zargs[2];
+		if (PROP_WATCHED(prop_addr))
+			property_store(prop_addr);
 		SET_BYTE(prop_addr, v)
 	} else {
 		zword v = zargs[2];
+		if (PROP_WATCHED(prop_addr))
+			property_store(prop_addr);
+		if (PROP_WATCHED(prop_addr + 1))
+			property_store(prop_addr + 1);
 		SET_WORD(prop_addr, v)
 	}
 } /* z_put_prop */
@@ -800,8 +1011,11 @@ void z_remove_obj (void)
  *	zargs[0] = object
  *	zargs[1] = number of attribute to set
  *
+ * z_set_attr_unchecked is for a legal object and attribute given as
+ * constants.
+ *
  */
-void z_set_attr(void)
+static void set_attr(bool checked)
 {
     zword obj_addr;
     zbyte value;
@@ -810,7 +1024,7 @@ void z_set_attr(void)
 		if (zargs[1] == 48)
 			return;
 
-	if (zargs[1] > ((z_header.version <= V3) ? 31 : 47))
+	if (checked && zargs[1] > ((z_header.version <= V3) ? 31 : 47))
 		runtime_error(ERR_ILL_ATTR);
 
 	/* If we are monitoring attribute assignment display a short note */
@@ -823,13 +1037,14 @@ void z_set_attr(void)
 		stream_mssg_off();
 	}
 
-	if (zargs[0] == 0) {
+	if (checked && zargs[0] == 0) {
 		runtime_error(ERR_SET_ATTR_0);
 		return;
 	}
 
 	/* Get attribute address */
-	obj_addr = object_address(zargs[0]) + zargs[1] / 8;
+	obj_addr = (checked ? object_address(zargs[0]) :
+		    object_address_unchecked(zargs[0])) + zargs[1] / 8;
 
 	/* Load attribute byte */
 	LOW_BYTE(obj_addr, value)
@@ -839,8 +1054,18 @@ void z_set_attr(void)
 
 	/* Store attribute byte */
 	SET_BYTE(obj_addr, value)
+} /* set_attr */
+
+void z_set_attr(void)
+{
+	set_attr(TRUE);
 } /* z_set_attr */
 
+void z_set_attr_unchecked(void)
+{
+	set_attr(FALSE);
+} /* z_set_attr_unchecked */
+
 
 /*
  * z_test_attr, branch if an object attribute is set.
@@ -848,13 +1073,16 @@ void z_set_attr(void)
  *	zargs[0] = object
  *	zargs[1] = number of attribute to test
  *
+ * z_test_attr_unchecked is for a legal object and attribute given as
+ * constants.
+ *
  */
-void z_test_attr(void)
+static void test_attr(bool checked)
 {
 	zword obj_addr;
 	zbyte value;
 
-	if (zargs[1] > ((z_header.version <= V3) ? 31 : 47))
+	if (checked && zargs[1] > ((z_header.version <= V3) ? 31 : 47))
 		runtime_error(ERR_ILL_ATTR);
 
 	/* If we are monitoring attribute testing display a short note */
@@ -866,14 +1094,15 @@ void z_test_attr(void)
 		print_num(zargs[1]);
 		stream_mssg_off();
 	}
-	if (zargs[0] == 0) {
+	if (checked && zargs[0] == 0) {
 		runtime_error(ERR_TEST_ATTR_0);
 		branch(FALSE);
 		return;
 	}
 
 	/* Get attribute address */
-	obj_addr = object_address(zargs[0]) + zargs[1] / 8;
+	obj_addr = (checked ? object_address(zargs[0]) :
+		    object_address_unchecked(zargs[0])) + zargs[1] / 8;
 
 	/* Load attribute byte */
 	LOW_BYTE(obj_addr, value)
@@ -881,4 +1110,14 @@ void z_test_attr(void)
 	/* Test attribute */
 	branch (value & (0x80 >> (zargs[1] & 7)));
 
+} /* test_attr */
+
+void z_test_attr(void)
+{
+	test_attr(TRUE);
 } /* z_test_attr */
+
+void z_test_attr_unchecked(void)
+{
+	test_attr(FALSE);
+} /* z_test_attr_unchecked */
@@ -0,0 +1,295 @@
+/* opstats.c - Opcode execution histograms
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * In a PROFILING build, interpret() counts every instruction in
+ * opstats[], indexed by its first opcode byte.  That byte also gives
+ * the operand form: long 2OP with small or variable operands, 1OP with
+ * a large, small or variable operand, 0OP, 2OP in variable form and
+ * VAR.  Extended opcodes are counted from opstats[OPSTAT_EXT] on.
+ * branch() and store() charge their outcome to the instruction being
+ * run.
+ *
+ * If a sampling interval is set, one instruction in that many is timed
+ * with the processor's cycle counter (nanoseconds where there is none),
+ * which gives the typical cost of each opcode without slowing the
+ * others down.
+ *
+ * The table is shown on screen by a hot key, and written to the
+ * profile file with ".opcodes" added.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frotz.h"
+
+#ifdef PROFILING
+
+#include <time.h>
+
+#define SHOW_OPCODES 12
+
+opstat_t opstats[OPSTAT_SIZE];
+opstat_t *opstat_current = &opstats[OPSTAT_NONE];
+zlong opstat_interval = 0;
+zlong opstat_countdown = 0;
+
+static const char *const op2_names[0x20] = {
+	NULL, "je", "jl", "jg", "dec_chk", "inc_chk", "jin", "test",
+	"or", "and", "test_attr", "set_attr", "clear_attr", "store",
+	"insert_obj", "loadw", "loadb", "get_prop", "get_prop_addr",
+	"get_next_prop", "add", "sub", "mul", "div", "mod", "call_2s",
+	"call_2n", "set_colour", "throw", NULL, NULL, NULL
+};
+
+static const char *const op1_names[0x10] = {
+	"jz", "get_sibling", "get_child", "get_parent", "get_prop_len",
+	"inc", "dec", "print_addr", "call_1s", "remove_obj", "print_obj",
+	"ret", "jump", "print_paddr", "load", "call_1n"
+};
+
+static const char *const op0_names[0x10] = {
+	"rtrue", "rfalse", "print", "print_ret", "nop", "save", "restore",
+	"restart", "ret_popped", "catch", "quit", "new_line",
+	"show_status", "verify", "extended", "piracy"
+};
+
+static const char *const var_names[0x20] = {
+	"call_vs", "storew", "storeb", "put_prop", "read", "print_char",
+	"print_num", "random", "push", "pull", "split_window",
+	"set_window", "call_vs2", "erase_window", "erase_line",
+	"set_cursor", "get_cursor", "set_text_style", "buffer_mode",
+	"output_stream", "input_stream", "sound_effect", "read_char",
+	"scan_table", "not", "call_vn", "call_vn2", "tokenise",
+	"encode_text", "copy_table", "print_table", "check_arg_count"
+};
+
+static const char *const ext_names[0x1d] = {
+	"save", "restore", "log_shift", "art_shift", "set_font",
+	"draw_picture", "picture_data", "erase_picture", "set_margins",
+	"save_undo", "restore_undo", "print_unicode", "check_unicode",
+	"set_true_colour", NULL, NULL, "move_window", "window_size",
+	"window_style", "get_wind_prop", "scroll_window", "pop_stack",
+	"read_mouse", "mouse_window", "push_stack", "put_wind_prop",
+	"print_form", "make_menu", "picture_table"
+};
+
+static const char *const op2_forms[4] = {
+	"2op-ss", "2op-sv", "2op-vs", "2op-vv"
+};
+
+static const char *const op1_forms[3] = {
+	"1op-l", "1op-s", "1op-v"
+};
+
+
+/*
+ * opstat_cycles
+ *
+ * Read the cycle counter.
+ *
+ */
+zlong opstat_cycles(void)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (zlong) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+} /* opstat_cycles */
+
+
+/*
+ * opstat_sample
+ *
+ * Charge the cycles since start to the instruction just run, and count
+ * down to the next one to time.
+ *
+ */
+void opstat_sample(zlong start)
+{
+	opstat_current->cycles += opstat_cycles() - start;
+	opstat_current->samples++;
+	opstat_countdown = opstat_interval;
+} /* opstat_sample */
+
+
+/*
+ * describe
+ *
+ * Give the name and operand form of an entry in opstats[].
+ *
+ */
+static void describe(int i, const char **name, const char **form)
+{
+	const char *const *names;
+	int number;
+
+	if (i >= OPSTAT_EXT) {
+		number = i - OPSTAT_EXT;
+		*name = number < 0x1d ? ext_names[number] : NULL;
+		*form = "ext";
+		return;
+	}
+
+	if (i < 0x80) {
+		names = op2_names;
+		number = i & 0x1f;
+		*form = op2_forms[(i >> 5) & 3];
+	} else if (i < 0xb0) {
+		names = op1_names;
+		number = i & 0x0f;
+		*form = op1_forms[(i >> 4) & 3];
+	} else if (i < 0xc0) {
+		names = op0_names;
+		number = i - 0xb0;
+		*form = "0op";
+	} else if (i < 0xe0) {
+		names = op2_names;
+		number = i - 0xc0;
+		*form = "2op-var";
+	} else {
+		names = var_names;
+		number = i - 0xe0;
+		*form = "var";
+	}
+	*name = names[number];
+} /* describe */
+
+
+/*
+ * compare_counts
+ *
+ * Order entries of opstats[] by count, most first.
+ *
+ */
+static int compare_counts(const void *a, const void *b)
+{
+	zlong x = opstats[*(const int *) a].count;
+	zlong y = opstats[*(const int *) b].count;
+
+	return (x < y) - (x > y);
+} /* compare_counts */
+
+
+/*
+ * sorted_opcodes
+ *
+ * Fill order with the opcodes that have run, most often first, and
+ * return how many there are.  The 0OP extended prefix is left out, as
+ * the extended opcodes are counted on their own.
+ *
+ */
+static int sorted_opcodes(int *order)
+{
+	int count = 0;
+	int i;
+
+	for (i = 0; i < OPSTAT_NONE; i++) {
+		if (opstats[i].count > 0 && i != 0xbe)
+			order[count++] = i;
+	}
+	qsort(order, count, sizeof(int), compare_counts);
+	return count;
+} /* sorted_opcodes */
+
+
+/*
+ * opstats_write
+ *
+ * Write the whole table to a file, most frequent opcode first.
+ *
+ */
+void opstats_write(const char *name)
+{
+	int order[OPSTAT_NONE];
+	int count = sorted_opcodes(order);
+	const char *opname;
+	const char *form;
+	char number[16];
+	char code[8];
+	FILE *out;
+	int i;
+
+	if ((out = fopen(name, "w")) == NULL)
+		return;
+
+	if (opstat_interval > 0)
+		fprintf(out, "# %lu instructions, one in %lu timed\n",
+			instruction_count, opstat_interval);
+	else
+		fprintf(out, "# %lu instructions, none timed\n",
+			instruction_count);
+	fprintf(out, "# %-6s %-7s %-16s %12s %12s %12s %12s %12s %12s "
+		"%10s %10s\n", "opcode", "form", "name", "count",
+		"taken", "not taken", "to stack", "to local", "to global",
+		"samples", "cycles");
+	for (i = 0; i < count; i++) {
+		opstat_t *op = &opstats[order[i]];
+
+		describe(order[i], &opname, &form);
+		if (opname == NULL) {
+			sprintf(number, "illegal_%02x", order[i] & 0xff);
+			opname = number;
+		}
+		sprintf(code, order[i] >= OPSTAT_EXT ? "ext:%02x" : "0x%02x",
+			order[i] & 0xff);
+		fprintf(out, "%-8s %-7s %-16s %12lu %12lu %12lu %12lu %12lu "
+			"%12lu %10lu %10.1f\n", code, form, opname, op->count,
+			op->branch_taken, op->branch_not_taken,
+			op->store_stack, op->store_local, op->store_global,
+			op->samples, op->samples ?
+			(double) op->cycles / op->samples : 0.0);
+	}
+	fclose(out);
+} /* opstats_write */
+
+
+/*
+ * opstats_show
+ *
+ * Print the most frequent opcodes on screen.
+ *
+ */
+void opstats_show(void)
+{
+	int order[OPSTAT_NONE];
+	int count = sorted_opcodes(order);
+	const char *opname;
+	const char *form;
+	char line[100];
+	int i;
+
+	sprintf(line, "%lu instructions\n", instruction_count);
+	print_string(line);
+	for (i = 0; i < count && i < SHOW_OPCODES; i++) {
+		describe(order[i], &opname, &form);
+		sprintf(line, "%12lu %5.1f%% %-16s %s\n",
+			opstats[order[i]].count,
+			100.0 * opstats[order[i]].count / instruction_count,
+			opname ? opname : "illegal", form);
+		print_string(line);
+	}
+} /* opstats_show */
+
+#endif /* PROFILING */
@@ -18,6 +18,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <string.h>
 #include "frotz.h"
 
 #ifdef DJGPP
@@ -169,6 +170,12 @@ void (*ext_opcodes[0x1d])(void) = {
 	z_picture_table
 };
 
+/* The tables for instructions proven safe in trusted mode */
+bool trusted = FALSE;
+
+static void (*op1_unchecked[0x10])(void);
+static void (*var_unchecked[0x40])(void);
+
 
 /*
  * init_process
@@ -179,9 +186,46 @@ void (*ext_opcodes[0x1d])(void) = {
 void init_process(void)
 {
 	finished = 0;
+	zargc = 0;
+	memset(zargs, 0, sizeof(zargs));
 }
 
 
+/*
+ * trust_opcodes
+ *
+ * Fill in the tables of handlers for instructions that have been
+ * proven safe (symbols.c) and start using them.  Only calls, jumps,
+ * table stores and attributes have handlers of their own; other
+ * instructions are never marked safe and keep the usual ones.
+ *
+ */
+void trust_opcodes(void)
+{
+	memcpy(op1_unchecked, op1_opcodes, sizeof(op1_unchecked));
+	memcpy(var_unchecked, var_opcodes, sizeof(var_unchecked));
+
+	op1_unchecked[0x08] = z_call_s_unchecked;
+	op1_unchecked[0x0c] = z_jump_unchecked;
+	if (op1_opcodes[0x0f] == z_call_n)
+		op1_unchecked[0x0f] = z_call_n_unchecked;
+
+	var_unchecked[0x0a] = z_test_attr_unchecked;
+	var_unchecked[0x0b] = z_set_attr_unchecked;
+	var_unchecked[0x0c] = z_clear_attr_unchecked;
+	var_unchecked[0x19] = z_call_s_unchecked;
+	var_unchecked[0x1a] = z_call_n_unchecked;
+	var_unchecked[0x20] = z_call_s_unchecked;
+	var_unchecked[0x21] = z_storew_unchecked;
+	var_unchecked[0x22] = z_storeb_unchecked;
+	var_unchecked[0x2c] = z_call_s_unchecked;
+	var_unchecked[0x39] = z_call_n_unchecked;
+	var_unchecked[0x3a] = z_call_n_unchecked;
+
+	trusted = TRUE;
+} /* trust_opcodes */
+
+
 /*
  * load_operand
  *
@@ -196,9 +240,10 @@ static void load_operand(zbyte type)
 		zbyte variable;
 
 		CODE_BYTE(variable)
-		if (variable == 0)
+		if (variable == 0) {
+			CHECK_POP(1)
 			value = *sp++;
-		else if (variable < 16)
+		} else if (variable < 16)
 			value = *(fp - variable);
 		else {
 			zword addr = z_header.globals + 2 * (variable - 16);
@@ -252,17 +297,42 @@ void interpret(void)
 
 	do {
 		zbyte opcode;
+		long pc;
+		void (**op1)(void) = op1_opcodes;
+		void (**var)(void) = var_opcodes;
+#ifdef PROFILING
+		zlong start = 0;
+		bool timed;
+#endif
 
+		GET_PC(pc)
 		CODE_BYTE(opcode)
 		zargc = 0;
+		instruction_count++;
+		flight_ring[instruction_count & (FLIGHT_SIZE - 1)] =
+			(zlong) pc << 8 | opcode;
+		if (coverage && pc < story_size)
+			COVER_MARK(cover_code, pc)
+		if (trusted && pc < story_size && (symbols[pc] & SYM_SAFE)) {
+			op1 = op1_unchecked;
+			var = var_unchecked;
+		}
+
+#ifdef PROFILING
+		opstat_current = &opstats[opcode];
+		opstat_current->count++;
+		timed = opstat_interval > 0 && --opstat_countdown == 0;
+		if (timed)
+			start = opstat_cycles();
+#endif
 
 		if (opcode < 0x80) {	/* 2OP opcodes */
 			load_operand((zbyte) (opcode & 0x40) ? 2 : 1);
 			load_operand((zbyte) (opcode & 0x20) ? 2 : 1);
-			var_opcodes[opcode & 0x1f] ();
+			var[opcode & 0x1f] ();
 		} else if (opcode < 0xb0) {	/* 1OP opcodes */
 			load_operand((zbyte) (opcode >> 4));
-			op1_opcodes[opcode & 0x0f] ();
+			op1[opcode & 0x0f] ();
 		} else if (opcode < 0xc0) {	/* 0OP opcodes */
 			op0_opcodes[opcode - 0xb0] ();
 		} else {	/* VAR opcodes */
@@ -277,9 +347,17 @@ void interpret(void)
 				CODE_BYTE(specifier1)
 				    load_all_operands(specifier1);
 			}
-			var_opcodes[opcode - 0xc0] ();
+			var[opcode - 0xc0] ();
 		}
 
+#ifdef PROFILING
+		if (timed)
+			opstat_sample(start);
+#endif
+
+		if (lockstep && instruction_count >= lockstep_next)
+			lockstep_record();
+
 #if defined(DJGPP) && defined(SOUND_SUPPORT)
 		if (end_of_sound_flag)
 			end_of_sound();
@@ -293,22 +371,26 @@ void interpret(void)
 
 
 /*
- * call
+ * call_routine
  *
  * Call a subroutine. Save PC and FP then load new PC and initialise
  * new stack frame. Note that the caller may legally provide less or
  * more arguments than the function actually has. The call type "ct"
- * can be 0 (z_call_s), 1 (z_call_n) or 2 (direct call).
+ * can be 0 (z_call_s), 1 (z_call_n) or 2 (direct call).  Unless
+ * checked, the routine is known to be a routine in the story.
  *
  */
-void call(zword routine, int argc, zword * args, int ct)
+static void call_routine(zword routine, int argc, zword * args, int ct,
+			 bool checked)
 {
 	long pc;
 	zword value;
 	zbyte count;
 	int i;
 
-	if (sp - stack < 4)
+	/* Leave room for the frame and all 15 locals below it, as a broken
+	 * story may use locals its routine does not have */
+	if (sp - stack < 4 + 15)
 		runtime_error(ERR_STK_OVF);
 
 	GET_PC(pc)
@@ -331,14 +413,24 @@ void call(zword routine, int argc, zword * args, int ct)
 	else			/* z_header.version == V8 */
 		pc = (long)routine << 3;
 
-	if (pc >= story_size)
+	FLIGHT_EVENT(FLIGHT_CALL, pc)
+	if (checked && pc >= story_size)
 		runtime_error(ERR_ILL_CALL_ADDR);
 
+#ifndef NO_SAMPLING
+	if (sampling && pc < story_size)
+		routine_map[pc >> 3] |= 1 << (pc & 7);
+#endif
+#ifdef PROFILING
+	if (profiling)
+		profile_call(pc);
+#endif
+
 	SET_PC(pc)
 	/* Initialise local variables */
 	CODE_BYTE(count)
 
-	if (count > 15)
+	if (checked && count > 15)
 		runtime_error(ERR_CALL_NON_RTN);
 	if (sp - stack < count)
 		runtime_error(ERR_STK_OVF);
@@ -354,6 +446,18 @@ void call(zword routine, int argc, zword * args, int ct)
 	/* Start main loop for direct calls */
 	if (ct == 2)
 		interpret();
+} /* call_routine */
+
+
+/*
+ * call
+ *
+ * Call a subroutine, checking that it is one.
+ *
+ */
+void call(zword routine, int argc, zword * args, int ct)
+{
+	call_routine(routine, argc, args, ct, TRUE);
 } /* call */
 
 
@@ -371,9 +475,14 @@ void ret(zword value)
 	long pc;
 	int ct;
 
-	if (sp > fp)
+	if (sp > fp || frame_count == 0)
 		runtime_error(ERR_STK_UNDF);
 
+#ifdef PROFILING
+	if (profiling)
+		profile_ret();
+#endif
+
 	sp = fp;
 
 	ct = *sp++ >> 12;
@@ -382,6 +491,7 @@ void ret(zword value)
 	pc = *sp++;
 	pc = ((long)*sp++ << 9) | pc;
 
+	FLIGHT_EVENT(FLIGHT_RET, pc)
 	SET_PC(pc)
 	/* Handle resulting value */
 	if (ct == 0)
@@ -422,6 +532,13 @@ void branch(bool flag)
 	if (!flag)
 		specifier ^= 0x80;
 
+#ifdef PROFILING
+	if (specifier & 0x80)
+		opstat_current->branch_taken++;
+	else
+		opstat_current->branch_not_taken++;
+#endif
+
 	if (!(specifier & 0x40)) {	/* it's a long branch */
 		if (off1 & 0x20)	/* propagate sign bit */
 			off1 |= 0xc0;
@@ -435,6 +552,8 @@ void branch(bool flag)
 		if (offset > 1) {	/* normal branch */
 			GET_PC(pc)
 			pc += (short)offset - 2;
+			if (pc < 0 || pc >= story_size)
+				runtime_error(ERR_ILL_JUMP_ADDR);
 			SET_PC(pc)
 		} else
 			ret(offset);	/* special case, return 0 or 1 */
@@ -453,9 +572,18 @@ void store(zword value)
 	zbyte variable;
 
 	CODE_BYTE(variable)
+#ifdef PROFILING
 	if (variable == 0)
-		*--sp = value;
+		opstat_current->store_stack++;
 	else if (variable < 16)
+		opstat_current->store_local++;
+	else
+		opstat_current->store_global++;
+#endif
+	if (variable == 0) {
+		CHECK_PUSH
+		*--sp = value;
+	} else if (variable < 16)
 		*(fp - variable) = value;
 	else {
 		zword addr = z_header.globals + 2 * (variable - 16);
@@ -480,6 +608,9 @@ int direct_call(zword addr)
 {
 	zword saved_zargs[8];
 	int saved_zargc;
+#ifdef PROFILING
+	opstat_t *saved_opstat;
+#endif
 	int i;
 
 	/* Calls to address 0 return false */
@@ -490,6 +621,11 @@ int direct_call(zword addr)
 	for (i = 0; i < 8; i++)
 		saved_zargs[i] = zargs[i];
 	saved_zargc = zargc;
+#ifdef PROFILING
+	/* The routine's instructions are counted as they run, but the time
+	 * and results still belong to the instruction that called it */
+	saved_opstat = opstat_current;
+#endif
 
 	/* Call routine directly */
 	call(addr, 0, 0, 2);
@@ -498,6 +634,9 @@ int direct_call(zword addr)
 	for (i = 0; i < 8; i++)
 		zargs[i] = saved_zargs[i];
 	zargc = saved_zargc;
+#ifdef PROFILING
+	opstat_current = saved_opstat;
+#endif
 
 	/* Resulting value lies on top of the stack */
 	return (short)*sp++;
@@ -519,6 +658,11 @@ static void __extended__(void)
 	CODE_BYTE(specifier)
 	load_all_operands(specifier);
 
+#ifdef PROFILING
+	opstat_current = &opstats[OPSTAT_EXT + opcode];
+	opstat_current->count++;
+#endif
+
 	/* extended opcodes from 0x1d on */
 	if (opcode < 0x1d)
 		ext_opcodes[opcode] ();	/* are reserved for future spec' */
@@ -577,6 +721,8 @@ void z_throw(void)
  *	...
  *	zargs[7] = seventh argument (optional)
  *
+ * z_call_n_unchecked is for calls proven to go to a routine.
+ *
  */
 void z_call_n(void)
 {
@@ -584,6 +730,11 @@ void z_call_n(void)
 		call(zargs[0], zargc - 1, zargs + 1, 1);
 } /* z_call_n */
 
+void z_call_n_unchecked(void)
+{
+	call_routine(zargs[0], zargc - 1, zargs + 1, 1, FALSE);
+} /* z_call_n_unchecked */
+
 
 /*
  * z_call_s, call a subroutine and store its result.
@@ -593,6 +744,8 @@ void z_call_n(void)
  *	...
  *	zargs[7] = seventh argument (optional)
  *
+ * z_call_s_unchecked is for calls proven to go to a routine.
+ *
  */
 void z_call_s(void)
 {
@@ -602,6 +755,11 @@ void z_call_s(void)
 		store(0);
 } /* z_call_s */
 
+void z_call_s_unchecked(void)
+{
+	call_routine(zargs[0], zargc - 1, zargs + 1, 0, FALSE);
+} /* z_call_s_unchecked */
+
 
 /*
  * z_check_arg_count, branch if subroutine was called with >= n arg's.
@@ -624,6 +782,8 @@ void z_check_arg_count(void)
  *
  *	zargs[0] = PC relative address
  *
+ * z_jump_unchecked is for jumps proven to stay in the story.
+ *
  */
 void z_jump(void)
 {
@@ -632,12 +792,21 @@ void z_jump(void)
 	GET_PC(pc)
 	pc += (short)zargs[0] - 2;
 
-	if (pc >= story_size)
+	if (pc < 0 || pc >= story_size)
 		runtime_error(ERR_ILL_JUMP_ADDR);
 
 	SET_PC(pc)
 } /* z_jump */
 
+void z_jump_unchecked(void)
+{
+	long pc;
+
+	GET_PC(pc)
+	pc += (short)zargs[0] - 2;
+	SET_PC(pc)
+} /* z_jump_unchecked */
+
 
 /*
  * z_nop, no operation.
@@ -683,6 +852,7 @@ void z_ret(void)
  */
 void z_ret_popped(void)
 {
+	CHECK_POP(1)
 	ret(*sp++);
 } /* z_ret_popped */
 
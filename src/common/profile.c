@@ -0,0 +1,504 @@
+/* profile.c - Z-code routine profiler
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * When Frotz is built with PROFILING defined and a profile file is
+ * given, call() and ret() report every routine entered and left.  The
+ * profiler keeps a shadow of the Z-machine call stack and charges the
+ * instructions run (counted by interpret()) and the wall time taken to
+ * the routine on top of it, both along each distinct call path and per
+ * routine.
+ *
+ * At exit, or at the first call or return after the interpreter gets
+ * SIGUSR1, two files are written.  The profile file itself holds one
+ * line per call path:
+ *
+ *	(top);0x0a3f4;0x0b120 1234
+ *
+ * the routines' byte addresses from the outermost in, then the number
+ * of instructions run in the innermost one along that path.  This is
+ * the "collapsed stack" format that flamegraph.pl and similar tools
+ * read.  "(top)" stands for code outside any routine, such as the main
+ * routine of stories before V6.  The same name with ".routines" added
+ * gets a table of each routine's calls, inclusive and exclusive
+ * instructions and inclusive and exclusive wall time.  Wall time
+ * includes time spent waiting for the player to type.  The opcode
+ * histograms of opstats.c go to the name with ".opcodes" added.
+ *
+ * Frames can vanish without a return: @throw unwinds several at once,
+ * and restart, restore and undo replace the whole stack.  The shadow
+ * stack is matched against frame_count and the frame pointer on every
+ * call and return, and any frames that no longer exist are closed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frotz.h"
+
+#ifdef PROFILING
+
+#include <signal.h>
+#include <time.h>
+
+#define ROUTINE_KEY	-1L
+#define MAX_PATH	1024
+
+typedef struct {
+	long parent;		/* Call path node of the caller */
+	long addr;		/* Byte address of the routine */
+	long routine;		/* Per-routine entry for the routine */
+	zlong calls;
+	zlong inclusive;	/* Instructions, including callees */
+	zlong exclusive;	/* Instructions in the routine itself */
+	double inclusive_time;
+	double exclusive_time;
+	int active;		/* Frames of a routine now on the stack */
+} prof_node_t;
+
+typedef struct {
+	long node;
+	int depth;		/* frame_count of the frame */
+	int fp;			/* fp - stack of the frame */
+	zlong start;
+	double start_time;
+	zlong child;
+	double child_time;
+} prof_frame_t;
+
+bool profiling = FALSE;
+
+static prof_node_t *nodes = NULL;
+static long node_count = 0;
+static long node_space = 0;
+
+static long *hash = NULL;
+static long hash_size = 0;
+
+static prof_frame_t *frames = NULL;
+static int frame_top = 0;
+static int frame_space = 0;
+
+static zlong top_child = 0;
+static double top_child_time = 0;
+static double start_time;
+
+static volatile sig_atomic_t dump_pending = 0;
+
+
+/*
+ * now
+ *
+ * Return the time in seconds from some fixed point.
+ *
+ */
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+} /* now */
+
+
+/*
+ * hash_slot
+ *
+ * Return the slot of the hash table that holds, or should hold, the
+ * node with the given parent and address.
+ *
+ */
+static long hash_slot(long parent, long addr)
+{
+	unsigned long h = (unsigned long) addr * 2654435761UL +
+		(unsigned long) parent * 40503UL;
+	long slot = h & (hash_size - 1);
+
+	while (hash[slot] >= 0 && (nodes[hash[slot]].parent != parent ||
+				   nodes[hash[slot]].addr != addr))
+		slot = (slot + 1) & (hash_size - 1);
+	return slot;
+} /* hash_slot */
+
+
+/*
+ * grow_hash
+ *
+ * Double the hash table and put every node back in.
+ *
+ */
+static void grow_hash(void)
+{
+	long i;
+
+	free(hash);
+	hash_size = hash_size ? 2 * hash_size : 1024;
+	if ((hash = malloc(hash_size * sizeof(long))) == NULL)
+		os_fatal("Out of memory");
+	for (i = 0; i < hash_size; i++)
+		hash[i] = -1;
+	for (i = 0; i < node_count; i++)
+		hash[hash_slot(nodes[i].parent, nodes[i].addr)] = i;
+} /* grow_hash */
+
+
+/*
+ * find_node
+ *
+ * Return the node with the given parent and address, making it if
+ * need be.  Per-routine entries are nodes whose parent is ROUTINE_KEY.
+ *
+ */
+static long find_node(long parent, long addr)
+{
+	prof_node_t *node;
+	long routine = -1;
+	long slot;
+
+	if (hash_size > 0 && hash[slot = hash_slot(parent, addr)] >= 0)
+		return hash[slot];
+	if (parent != ROUTINE_KEY)
+		routine = find_node(ROUTINE_KEY, addr);
+
+	if (2 * (node_count + 1) > hash_size)
+		grow_hash();
+	if (node_count == node_space) {
+		node_space = node_space ? 2 * node_space : 1024;
+		nodes = realloc(nodes, node_space * sizeof(prof_node_t));
+		if (nodes == NULL)
+			os_fatal("Out of memory");
+	}
+	node = &nodes[node_count];
+	memset(node, 0, sizeof(prof_node_t));
+	node->parent = parent;
+	node->addr = addr;
+	node->routine = (routine >= 0) ? routine : node_count;
+	hash[hash_slot(parent, addr)] = node_count;
+	return node_count++;
+} /* find_node */
+
+
+/*
+ * close_frame
+ *
+ * Charge the top frame of the shadow stack for its run and pop it.
+ *
+ */
+static void close_frame(double t)
+{
+	prof_frame_t *frame = &frames[--frame_top];
+	prof_node_t *node = &nodes[frame->node];
+	prof_node_t *routine = &nodes[node->routine];
+	zlong inclusive = instruction_count - frame->start;
+	double inclusive_time = t - frame->start_time;
+
+	node->inclusive += inclusive;
+	node->exclusive += inclusive - frame->child;
+	node->inclusive_time += inclusive_time;
+	node->exclusive_time += inclusive_time - frame->child_time;
+
+	routine->exclusive += inclusive - frame->child;
+	routine->exclusive_time += inclusive_time - frame->child_time;
+	if (--routine->active == 0) {
+		routine->inclusive += inclusive;
+		routine->inclusive_time += inclusive_time;
+	}
+
+	if (frame_top > 0) {
+		frames[frame_top - 1].child += inclusive;
+		frames[frame_top - 1].child_time += inclusive_time;
+	} else {
+		top_child += inclusive;
+		top_child_time += inclusive_time;
+	}
+} /* close_frame */
+
+
+/*
+ * open_frame
+ *
+ * Push a frame for the given call path node.
+ *
+ */
+static void open_frame(long node, int depth, int frame_fp, double t)
+{
+	prof_frame_t *frame;
+
+	if (frame_top == frame_space) {
+		frame_space = frame_space ? 2 * frame_space : 256;
+		frames = realloc(frames, frame_space * sizeof(prof_frame_t));
+		if (frames == NULL)
+			os_fatal("Out of memory");
+	}
+	frame = &frames[frame_top++];
+	frame->node = node;
+	frame->depth = depth;
+	frame->fp = frame_fp;
+	frame->start = instruction_count;
+	frame->start_time = t;
+	frame->child = 0;
+	frame->child_time = 0;
+	nodes[nodes[node].routine].active++;
+} /* open_frame */
+
+
+/*
+ * print_path
+ *
+ * Print the call path leading to a node, outermost routine first.
+ *
+ */
+static void print_path(FILE *out, long node)
+{
+	long path[MAX_PATH];
+	int n = 0;
+
+	for (; node >= 0 && n < MAX_PATH; node = nodes[node].parent)
+		path[n++] = node;
+	fprintf(out, "(top)");
+	while (n-- > 0)
+		fprintf(out, ";0x%05lx", nodes[path[n]].addr);
+} /* print_path */
+
+
+/*
+ * compare_routines
+ *
+ * Order routines by exclusive instructions, most first.
+ *
+ */
+static int compare_routines(const void *a, const void *b)
+{
+	zlong x = nodes[*(const long *) a].exclusive;
+	zlong y = nodes[*(const long *) b].exclusive;
+
+	return (x < y) - (x > y);
+} /* compare_routines */
+
+
+/*
+ * profile_dump
+ *
+ * Write the collapsed stacks and the routine table.  Frames still on
+ * the stack are closed and opened again, so that what they have run
+ * so far is counted.
+ *
+ */
+static void profile_dump(void)
+{
+	prof_frame_t *saved;
+	char *name;
+	long *routines;
+	long count = 0;
+	long i;
+	double t = now();
+	int top = frame_top;
+	FILE *out;
+
+	dump_pending = 0;
+
+	saved = malloc((top + 1) * sizeof(prof_frame_t));
+	routines = malloc((node_count + 1) * sizeof(long));
+	name = malloc(strlen(f_setup.profile_file) + 10);
+	if (saved == NULL || routines == NULL || name == NULL)
+		os_fatal("Out of memory");
+	memcpy(saved, frames, top * sizeof(prof_frame_t));
+	while (frame_top > 0)
+		close_frame(t);
+	for (i = 0; i < top; i++)
+		open_frame(saved[i].node, saved[i].depth, saved[i].fp, t);
+
+	if ((out = fopen(f_setup.profile_file, "w")) != NULL) {
+		if (instruction_count > top_child)
+			fprintf(out, "(top) %lu\n", instruction_count - top_child);
+		for (i = 0; i < node_count; i++) {
+			if (nodes[i].parent != ROUTINE_KEY &&
+			    nodes[i].exclusive > 0) {
+				print_path(out, i);
+				fprintf(out, " %lu\n", nodes[i].exclusive);
+			}
+		}
+		fclose(out);
+	}
+
+	for (i = 0; i < node_count; i++) {
+		if (nodes[i].parent == ROUTINE_KEY)
+			routines[count++] = i;
+	}
+
+	qsort(routines, count, sizeof(long), compare_routines);
+	sprintf(name, "%s.routines", f_setup.profile_file);
+	if ((out = fopen(name, "w")) != NULL) {
+		fprintf(out, "# %.3f seconds, %lu instructions, %.3f seconds "
+			"and %lu instructions outside routines\n",
+			t - start_time, instruction_count,
+			t - start_time - top_child_time,
+			instruction_count - top_child);
+		fprintf(out, "# %-9s %10s %14s %14s %12s %12s\n", "routine",
+			"calls", "incl instrs", "excl instrs", "incl ms",
+			"excl ms");
+		for (i = 0; i < count; i++) {
+			prof_node_t *r = &nodes[routines[i]];
+
+			fprintf(out, "0x%05lx %12lu %14lu %14lu %12.3f %12.3f\n",
+				r->addr, r->calls, r->inclusive, r->exclusive,
+				r->inclusive_time * 1000,
+				r->exclusive_time * 1000);
+		}
+		fclose(out);
+	}
+
+	sprintf(name, "%s.opcodes", f_setup.profile_file);
+	opstats_write(name);
+
+	free(saved);
+	free(routines);
+	free(name);
+} /* profile_dump */
+
+
+/*
+ * sync_frames
+ *
+ * Close shadow frames at or below the given depth, and all of them if
+ * the one left on top is not the Z-machine frame it should be.
+ *
+ */
+static void sync_frames(int depth, int frame_fp, double t)
+{
+	while (frame_top > 0 && frames[frame_top - 1].depth > depth)
+		close_frame(t);
+	if (frame_top > 0 && (frames[frame_top - 1].depth != depth ||
+			      frames[frame_top - 1].fp != frame_fp)) {
+		while (frame_top > 0)
+			close_frame(t);
+	}
+} /* sync_frames */
+
+
+/*
+ * profile_call
+ *
+ * A routine at the given byte address has just been called, and its
+ * frame is now on top of the stack.
+ *
+ */
+void profile_call(long addr)
+{
+	double t = now();
+	long parent;
+
+	if (dump_pending)
+		profile_dump();
+
+	/* The caller's frame should be on top of the shadow stack */
+	if (frame_count > 1)
+		sync_frames(frame_count - 1, fp[1] + 1, t);
+	else
+		sync_frames(0, 0, t);
+
+	parent = frame_top > 0 ? frames[frame_top - 1].node : ROUTINE_KEY - 1;
+	parent = find_node(parent, addr);
+	nodes[parent].calls++;
+	nodes[nodes[parent].routine].calls++;
+	open_frame(parent, frame_count, fp - stack, t);
+} /* profile_call */
+
+
+/*
+ * profile_ret
+ *
+ * The routine on top of the stack is about to return.
+ *
+ */
+void profile_ret(void)
+{
+	double t = now();
+
+	if (dump_pending)
+		profile_dump();
+
+	sync_frames(frame_count, fp - stack, t);
+	if (frame_top > 0)
+		close_frame(t);
+} /* profile_ret */
+
+
+/*
+ * request_dump
+ *
+ * The SIGUSR1 handler.  The dump itself waits for the next call or
+ * return, when the profiler's tables are not half updated.
+ *
+ */
+static void request_dump(int UNUSED (sig))
+{
+	dump_pending = 1;
+} /* request_dump */
+
+
+/*
+ * profile_close
+ *
+ * Called at exit to write the final profile.
+ *
+ */
+static void profile_close(void)
+{
+	double t = now();
+
+	while (frame_top > 0)
+		close_frame(t);
+	profile_dump();
+} /* profile_close */
+
+
+/*
+ * profile_open
+ *
+ * Start timing opcodes if asked to, and profiling if a profile file
+ * was asked for.
+ *
+ */
+void profile_open(void)
+{
+#ifdef SIGUSR1
+	struct sigaction sa;
+#endif
+
+	opstat_interval = f_setup.opcode_sample;
+	opstat_countdown = opstat_interval;
+
+	if (f_setup.profile_file == NULL || profiling)
+		return;
+
+	start_time = now();
+	profiling = TRUE;
+	atexit(profile_close);
+#ifdef SIGUSR1
+	/* Restart, so that reading the keyboard is not cut short */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = request_dump;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, NULL);
+#endif
+} /* profile_open */
+
+#endif /* PROFILING */
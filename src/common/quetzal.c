@@ -45,14 +45,23 @@
 
 #endif
 
-#define get_c fgetc
-#define put_c fputc
+extern long mem_diff (zbyte *, zbyte *, zword, zbyte *);
+extern bool mem_undiff (zbyte *, long, zbyte *, zword);
 
 /*
- * This is used only by save_quetzal. It probably should be allocated
- * dynamically rather than statically.
+ * Quetzal data is read and written through a qfile_t, which holds
+ * either a stdio file or a block of memory.  This lets the same code
+ * serve both files and the in-memory save and restore functions.
  */
-static zword frames[STACK_SIZE / 4 + 1];
+typedef struct {
+	FILE *fp;		/* File, or NULL for memory */
+	membuf_t *buf;		/* Memory being written to */
+	const zbyte *data;	/* Memory being read from */
+	long size;		/* Number of bytes in data */
+	long pos;		/* Current position in memory */
+} qfile_t;
+
+#define MEMBUF_CHUNK 0x1000
 
 /*
  * ID types.
@@ -66,6 +75,18 @@ static zword frames[STACK_SIZE / 4 + 1];
 #define ID_CMem makeid ('C','M','e','m')
 #define ID_Stks makeid ('S','t','k','s')
 #define ID_ANNO makeid ('A','N','N','O')
+#define ID_DMem makeid ('D','M','e','m')
+
+/*
+ * A delta save is a Quetzal file whose memory is given by a `DMem'
+ * chunk instead of `CMem' or `UMem'.  The chunk holds the id of the
+ * memory of the save it was made against (its parent), then the
+ * difference from that memory in the encoding mem_diff uses for undo.
+ * A chain is a full save followed by delta saves, each against the
+ * one before, stored one after another; restoring the chain restores
+ * the last save.  Other interpreters see no memory chunk in a delta
+ * save and refuse it, which is better than restoring it wrongly.
+ */
 
 /*
  * Various parsing states within restoration.
@@ -93,8 +114,150 @@ static zword frames[STACK_SIZE / 4 + 1];
 	(write_byte (fp, 0)         && write_byte (fp, (run)))
 
 
+/* Read one byte; return EOF at the end of the data. */
+static int get_c(qfile_t * q)
+{
+	if (q->fp != NULL)
+		return fgetc(q->fp);
+	if (q->pos >= q->size)
+		return EOF;
+	return q->data[q->pos++];
+}
+
+
+/* Make room in memory for length more bytes at the current position. */
+static bool q_reserve(qfile_t * q, long length)
+{
+	membuf_t *buf = q->buf;
+	zbyte *data;
+	long alloc;
+
+	if (q->pos + length <= buf->alloc)
+		return TRUE;
+	alloc = (buf->alloc != 0) ? buf->alloc : MEMBUF_CHUNK;
+	while (alloc < q->pos + length)
+		alloc *= 2;
+	if ((data = realloc(buf->data, alloc)) == NULL)
+		return FALSE;
+	buf->data = data;
+	buf->alloc = alloc;
+	return TRUE;
+}
+
+
+/* Write one byte; return EOF if it can't be written. */
+static int put_c(int c, qfile_t * q)
+{
+	if (q->fp != NULL)
+		return fputc(c, q->fp);
+
+	if (!q_reserve(q, 1))
+		return EOF;
+	q->buf->data[q->pos++] = (zbyte) c;
+	if (q->pos > q->buf->size)
+		q->buf->size = q->pos;
+	return (zbyte) c;
+}
+
+
+/* Write a block of bytes; return TRUE if OK. */
+static bool q_write(qfile_t * q, const zbyte far * src, long length)
+{
+	if (length == 0)
+		return TRUE;
+	if (q->fp != NULL)
+		return fwrite(src, length, 1, q->fp) == 1;
+
+	if (!q_reserve(q, length))
+		return FALSE;
+	memcpy(q->buf->data + q->pos, src, length);
+	q->pos += length;
+	if (q->pos > q->buf->size)
+		q->buf->size = q->pos;
+	return TRUE;
+}
+
+
+/* Return the current position. */
+static long q_tell(qfile_t * q)
+{
+	if (q->fp != NULL)
+		return ftell(q->fp);
+	return q->pos;
+}
+
+
+/* Move to a position given relative to the start or the current one. */
+static void q_seek(qfile_t * q, long offset, int whence)
+{
+	if (q->fp != NULL) {
+		(void)fseek(q->fp, offset, whence);
+		return;
+	}
+	if (whence == SEEK_CUR)
+		offset += q->pos;
+	q->pos = offset;
+}
+
+
+/* Read a block of bytes; return TRUE if OK. */
+static bool q_read(qfile_t * q, zbyte far * dest, long length)
+{
+	if (q->fp != NULL)
+		return fread(dest, length, 1, q->fp) == 1;
+	if (length > q->size - q->pos)
+		return FALSE;
+	memcpy(dest, q->data + q->pos, length);
+	q->pos += length;
+	return TRUE;
+}
+
+
+/*
+ * Return a block of bytes read from q.  Data in memory is used where it
+ * lies; from a file it is read into a buffer.  Either way, the block
+ * must be given back to q_unmap.  Return NULL if it can't be read.
+ */
+static const zbyte far *q_map(qfile_t * q, long length)
+{
+	zbyte far *block;
+
+	if (q->fp == NULL) {
+		if (length > q->size - q->pos)
+			return NULL;
+		q->pos += length;
+		return q->data + q->pos - length;
+	}
+	if ((block = malloc(length + 1)) == NULL)
+		return NULL;
+	if (length > 0 && fread(block, length, 1, q->fp) != 1) {
+		free(block);
+		return NULL;
+	}
+	return block;
+}
+
+
+/* Give back a block from q_map. */
+static void q_unmap(qfile_t * q, const zbyte far * block)
+{
+	if (q->fp != NULL)
+		free((zbyte far *) block);
+}
+
+
+/* Go back to the start of the story file (or of its memory). */
+static void q_rewind_story(qfile_t * q)
+{
+	if (q->fp != NULL)
+		(void)os_storyfile_seek(q->fp, 0, SEEK_SET);
+	else
+		q->pos = 0;
+}
+
+
 /* Read one word from file; return TRUE if OK. */
-static bool read_word(FILE * f, zword * result)
+static bool read_word(qfile_t * f, zword * result)
 {
 	int a, b;
 
@@ -109,7 +272,7 @@ static bool read_word(FILE * f, zword * result)
 
 
 /* Read one long from file; return TRUE if OK. */
-static bool read_long(FILE * f, zlong * result)
+static bool read_long(qfile_t * f, zlong * result)
 {
 	int a, b, c, d;
 
@@ -135,17 +298,114 @@ static bool read_long(FILE * f, zlong * result)
 }
 
 
+/*
+ * Identify a state of dynamic memory, so that a delta save can tell
+ * whether it is being applied to its parent.  This is the 32-bit
+ * FNV-1a hash of the memory.
+ */
+static zlong memory_id(const zbyte far * mem)
+{
+	return hash_bytes(HASH_START, mem, z_header.dynamic_size);
+}
+
+
+/*
+ * Compress dynamic memory for a `CMem' chunk: each byte is XORed with
+ * the original, a run of zero bytes is written as a zero and the run
+ * length less one, and a run at the end is left out.  Unchanged memory
+ * is skipped a word at a time.  out must have room for 3/2 of the
+ * memory size, plus 2.  Return the number of bytes written to out.
+ */
+static long cmem_encode(const zbyte far * mem, const zbyte far * orig,
+			zword size, zbyte far * out)
+{
+	unsigned long a, b;
+	long i, j, start;
+	long n = 0;
+
+	for (i = 0; i < size; ++i) {
+		/* Find the next byte that differs. */
+		start = i;
+		while (i + (long) sizeof(a) <= size) {
+			memcpy(&a, mem + i, sizeof(a));
+			memcpy(&b, orig + i, sizeof(b));
+			if (a != b)
+				break;
+			i += sizeof(a);
+		}
+		while (i < size && mem[i] == orig[i])
+			++i;
+		if (i == size)
+			break;	/* Ignore a run at the end. */
+
+		/* Write out any run there may be, then this byte. */
+		if ((j = i - start) > 0) {
+			for (; j > 0x100; j -= 0x100) {
+				out[n++] = 0;
+				out[n++] = 0xFF;
+			}
+			out[n++] = 0;
+			out[n++] = (zbyte) (j - 1);
+		}
+		out[n++] = mem[i] ^ orig[i];
+	}
+	return n;
+}
+
+
+/*
+ * Uncompress a `CMem' chunk of the given length into dest, which is
+ * size bytes long.  Memory the chunk does not reach is taken to be
+ * unchanged.  Return FALSE if the chunk is bogus.
+ */
+static bool cmem_decode(const zbyte far * body, long length,
+			const zbyte far * orig, zbyte far * dest, zword size)
+{
+	long i = 0, k = 0;
+	long run;
+	zbyte x;
+
+	while (k < length) {
+		if ((x = body[k++]) != 0) {	/* Not a run. */
+			/* Make sure we don't load too much. */
+			if (i >= size) {
+				print_string
+				    ("warning: `CMem' chunk too long!\n");
+				return FALSE;
+			}
+			dest[i] = x ^ orig[i];
+			++i;
+		} else if (k < length) {
+			/* Copy the original memory during the run. */
+			run = (long) body[k++] + 1;
+			if (run > size - i)
+				run = size - i;
+			memcpy(dest + i, orig + i, run);
+			i += run;
+		} else {
+			print_string("File contains bogus `CMem' chunk.\n");
+			return FALSE;
+		}
+	}
+	/* If chunk is short, assume a run. */
+	memcpy(dest + i, orig + i, size - i);
+	return TRUE;
+}
+
+
 /*
  * Restore a saved game using Quetzal format. Return 2 if OK, 0 if an error
  * occurred before any damage was done, -1 on a fatal error.
  */
-zword restore_quetzal(FILE * svf, FILE * stf)
+static zword restore_chunks(qfile_t * svf, qfile_t * stf)
 {
 	zlong ifzslen, currlen, tmpl;
 	zlong pc;
 	zword i, tmpw;
 	zword fatal = 0;	/* Set to -1 when errors must be fatal. */
 	zbyte skip, progress = GOT_NONE;
+	zbyte far *diff;
+	const zbyte far *body, far *orig;
 	int x, y;
 
 	/* Check it's really an `IFZS' file. */
@@ -349,75 +609,68 @@ zword restore_quetzal(FILE * svf, FILE * stf)
 			}
 			/* End of `Stks' processing... */
 			break;
+			/* `DMem' delta memory chunk; apply it to the parent. */
+		case ID_DMem:
+			if (!(progress & GOT_MEMORY)) {	/* Don't complain if two. */
+				if (currlen < 4 || !read_long(svf, &tmpl))
+					return fatal;
+				currlen -= 4;
+				if (tmpl != memory_id(zmp)) {
+					print_string
+					    ("Save file is a delta against another save!\n");
+					q_seek(svf, currlen, SEEK_CUR);	/* Skip rest. */
+					break;
+				}
+				if (currlen == 0) {	/* Nothing changed. */
+					progress |= GOT_MEMORY;
+					break;
+				}
+				if ((diff = malloc(currlen)) == NULL)
+					return fatal;
+				if (!q_read(svf, diff, currlen)) {
+					free(diff);
+					return fatal;
+				}
+				if (mem_undiff(diff, currlen, zmp,
+				    z_header.dynamic_size))
+					progress |= GOT_MEMORY;	/* Only on success. */
+				else
+					print_string
+					    ("File contains bogus `DMem' chunk.\n");
+				free(diff);
+				break;
+			}
+			/* Already GOT_MEMORY */
+			q_seek(svf, currlen, SEEK_CUR);	/* Skip chunk. */
+			break;
 			/* Any more special chunk types must go in HERE or ABOVE. */
 			/* `CMem' compressed memory chunk; uncompress it. */
 		case ID_CMem:
 			if (!(progress & GOT_MEMORY)) {	/* Don't complain if two. */
-				(void)os_storyfile_seek(stf, 0, SEEK_SET);
-				i = 0;	/* Bytes written to data area. */
-				for (; currlen > 0; --currlen) {
-					if ((x = get_c(svf)) == EOF)
-						return fatal;
-					if (x == 0) {	/* Start run. */
-						/* Check for bogus run. */
-						if (currlen < 2) {
-							print_string
-							    ("File contains bogus `CMem' chunk.\n");
-							for (; currlen > 0;
-							     --currlen)
-								(void)get_c(svf);	/* Skip rest. */
-							currlen = 1;
-							i = 0xFFFF;
-							break;	/* Keep going; may be a `UMem' too. */
-						}
-						/* Copy story file to memory during the run. */
-						--currlen;
-						if ((x = get_c(svf)) == EOF)
-							return fatal;
-						for (;
-						     x >= 0
-						     && i < z_header.dynamic_size;
-						     --x, ++i)
-							if ((y =
-							     get_c(stf)) == EOF)
-								return fatal;
-							else
-								zmp[i] =
-								    (zbyte) y;
-					} else {	/* Not a run. */
-					if ((y = get_c(stf)) == EOF)
-						return fatal;
-					zmp[i] = (zbyte) (x ^ y);
-					++i;
-					}
-					/* Make sure we don't load too much. */
-					if (i > z_header.dynamic_size) {
-						print_string
-						    ("warning: `CMem' chunk too long!\n");
-						for (; currlen > 1; --currlen)
-							(void)get_c(svf);	/* Skip rest. */
-						break;	/* Keep going; there may be a `UMem' too. */
-					}
+				if ((body = q_map(svf, currlen)) == NULL)
+					return fatal;
+				q_rewind_story(stf);
+				if ((orig = q_map(stf, z_header.dynamic_size)) == NULL) {
+					q_unmap(svf, body);
+					return fatal;
 				}
-				/* If chunk is short, assume a run. */
-				for (; i < z_header.dynamic_size; ++i)
-					if ((y = get_c(stf)) == EOF)
-						return fatal;
-					else
-						zmp[i] = (zbyte) y;
-				if (currlen == 0)
+				/* Keep going if bogus; there may be a `UMem' too. */
+				if (cmem_decode(body, currlen, orig, zmp,
+				    z_header.dynamic_size))
 					progress |= GOT_MEMORY;	/* Only if succeeded. */
+				q_unmap(stf, orig);
+				q_unmap(svf, body);
 				break;
 			}
 			/* Already GOT_MEMORY */
-			(void)fseek(svf, currlen, SEEK_CUR);	/* Skip chunk. */
+			q_seek(svf, currlen, SEEK_CUR);	/* Skip chunk. */
 			break;
 			/* `UMem' uncompressed memory chunk; load it. */
 		case ID_UMem:
 			if (!(progress & GOT_MEMORY)) {	/* Don't complain if two. */
 				/* Must be exactly the right size. */
 				if (currlen == z_header.dynamic_size) {
-					if (fread(zmp, currlen, 1, svf) == 1) {
+					if (q_read(svf, zmp, currlen)) {
 						progress |= GOT_MEMORY;	/* Only on success. */
 						break;
 					}
@@ -427,11 +680,11 @@ zword restore_quetzal(FILE * svf, FILE * stf)
 					    ("`UMem' chunk wrong size!\n");
 			}
 			/* Already GOT_MEMORY */
-			(void)fseek(svf, currlen, SEEK_CUR);	/* Skip chunk. */
+			q_seek(svf, currlen, SEEK_CUR);	/* Skip chunk. */
 			break;
 			/* Unrecognised chunk type; skip it. */
 		default:
-			(void)fseek(svf, currlen, SEEK_CUR);	/* Skip chunk. */
+			q_seek(svf, currlen, SEEK_CUR);	/* Skip chunk. */
 			break;
 		}
 		if (skip)
@@ -456,17 +709,48 @@ zword restore_quetzal(FILE * svf, FILE * stf)
 
 
 /*
- * Save a game using Quetzal format. Return 1 if OK, 0 if failed.
+ * Restore a chain of saves, or a single save, which is a chain of one.
+ * A full save in the middle of a chain replaces all before it, so the
+ * chain may be added to without ever being cut.  Data after the last
+ * save that does not start another one is ignored.  The return value
+ * is the same as for restore_chunks.
  */
-zword save_quetzal(FILE * svf, FILE * stf)
+static zword restore_chain(qfile_t * svf, qfile_t * stf)
+{
+	zword success;
+	zlong tmpl;
+
+	success = restore_chunks(svf, stf);
+	while ((short) success > 0 && read_long(svf, &tmpl)) {
+		q_seek(svf, -4, SEEK_CUR);
+		if (tmpl != ID_FORM)
+			break;
+		/* The saves before this one have changed the state. */
+		if ((success = restore_chunks(svf, stf)) == 0)
+			success = -1;
+	}
+	return success;
+}
+
+
+/*
+ * Save the state in snap using Quetzal format. Return 1 if OK, 0 if
+ * failed.  If parent is not NULL, write a delta save against the memory
+ * it holds, and update it to the current memory.
+ */
+static zword save_chunks(qfile_t * svf, qfile_t * stf, zbyte far * parent,
+			 const zsnapshot_t * snap)
 {
 	zlong ifzslen = 0, cmemlen = 0, stkslen = 0;
 	zlong pc;
+	zword frames[STACK_SIZE / 4 + 1];
 	zword i, j, n;
 	zword nvars, nargs, nstk, *p;
 	zbyte var;
+	zbyte far *diff;
+	const zbyte far *orig;
 	long cmempos, stkspos;
-	int c;
+	bool ok;
 
 	/* Write `IFZS' header. */
 	if (!write_chnk(svf, ID_FORM, 0))
@@ -475,62 +759,62 @@ zword save_quetzal(FILE * svf, FILE * stf)
 		return 0;
 
 	/* Write `IFhd' chunk. */
-	GET_PC(pc);
+	pc = snap->pc;
 	if (!write_chnk(svf, ID_IFhd, 13))
 		return 0;
 	if (!write_word(svf, z_header.release))
 		return 0;
 	for (i = H_SERIAL; i < H_SERIAL + 6; ++i)
-		if (!write_byte(svf, zmp[i]))
+		if (!write_byte(svf, snap->mem[i]))
 			return 0;
 	if (!write_word(svf, z_header.checksum))
 		return 0;
 	if (!write_long(svf, pc << 8))	/* Includes pad. */
 		return 0;
 
-	/* Write `CMem' chunk. */
-	if ((cmempos = ftell(svf)) < 0)
-		return 0;
-	if (!write_chnk(svf, ID_CMem, 0))
+	/* Write `DMem' chunk for a delta save, else `CMem'. */
+	if ((cmempos = q_tell(svf)) < 0)
 		return 0;
-	(void)os_storyfile_seek(stf, 0, SEEK_SET);
-	/* j holds current run length. */
-	for (i = 0, j = 0, cmemlen = 0; i < z_header.dynamic_size; ++i) {
-		if ((c = get_c(stf)) == EOF)
+	if (parent != NULL) {
+		if (!write_chnk(svf, ID_DMem, 0))
+			return 0;
+		if (!write_long(svf, memory_id(parent)))
+			return 0;
+		diff = malloc(((unsigned long) z_header.dynamic_size * 3) / 2 + 2);
+		if (diff == NULL)
+			return 0;
+		cmemlen = mem_diff(snap->mem, parent, z_header.dynamic_size,
+				   diff);
+		ok = q_write(svf, diff, cmemlen);
+		free(diff);
+		if (!ok)
+			return 0;
+		cmemlen += 4;
+	} else {
+		if (!write_chnk(svf, ID_CMem, 0))
+			return 0;
+		q_rewind_story(stf);
+		if ((orig = q_map(stf, z_header.dynamic_size)) == NULL)
+			return 0;
+		diff = malloc(((unsigned long) z_header.dynamic_size * 3) / 2 + 2);
+		if (diff == NULL) {
+			q_unmap(stf, orig);
 			return 0;
-		c ^= (int)zmp[i];
-		if (c == 0)
-			++j;	/* It's a run of equal bytes. */
-		else {
-			/* Write out any run there may be. */
-			if (j > 0) {
-				for (; j > 0x100; j -= 0x100) {
-					if (!write_run(svf, 0xFF))
-						return 0;
-					cmemlen += 2;
-				}
-				if (!write_run(svf, j - 1))
-					return 0;
-				cmemlen += 2;
-				j = 0;
-			}
-			/* Any runs are now written. Write this (nonzero) byte. */
-			if (!write_byte(svf, (zbyte) c))
-				return 0;
-			++cmemlen;
 		}
+		cmemlen = cmem_encode(snap->mem, orig, z_header.dynamic_size,
+				      diff);
+		q_unmap(stf, orig);
+		ok = q_write(svf, diff, cmemlen);
+		free(diff);
+		if (!ok)
+			return 0;
 	}
-
-	/*
-	 * Reached end of dynamic memory. We ignore any unwritten run there may be
-	 * at this point.
-	 */
 	if (cmemlen & 1)	/* Chunk length must be even. */
 		if (!write_byte(svf, 0))
 			return 0;
 
 	/* Write `Stks' chunk. You are not expected to understand this. ;) */
-	if ((stkspos = ftell(svf)) < 0)
+	if ((stkspos = q_tell(svf)) < 0)
 		return 0;
 	if (!write_chnk(svf, ID_Stks, 0))
 		return 0;
@@ -540,9 +824,9 @@ zword save_quetzal(FILE * svf, FILE * stf)
 	 * These indices are the offsets into the `stack' array of the word before
 	 * the first word pushed in each frame.
 	 */
-	frames[0] = sp - stack;	/* The frame we'd get by doing a call now. */
-	for (i = fp - stack + 4, n = 0; i < STACK_SIZE + 4;
-	     i = stack[i - 3] + 5)
+	frames[0] = snap->sp;	/* The frame we'd get by doing a call now. */
+	for (i = snap->fp + 4, n = 0; i < STACK_SIZE + 4;
+	     i = snap->stack[i - 3] + 5)
 		frames[++n] = i;
 
 	/*
@@ -558,14 +842,14 @@ zword save_quetzal(FILE * svf, FILE * stf)
 		if (!write_word(svf, nstk))
 			return 0;
 		for (j = STACK_SIZE - 1; j >= frames[n]; --j)
-			if (!write_word(svf, stack[j]))
+			if (!write_word(svf, snap->stack[j]))
 				return 0;
 		stkslen = 8 + 2 * nstk;
 	}
 
 	/* Write out the rest of the stack frames. */
 	for (i = n; i > 0; --i) {
-		p = stack + frames[i] - 4;	/* Points to call frame. */
+		p = snap->stack + frames[i] - 4;	/* Points to call frame. */
 		nvars = (p[0] & 0x0F00) >> 8;
 		nargs = p[0] & 0x00FF;
 		nstk = frames[i] - frames[i - 1] - nvars - 4;
@@ -583,7 +867,8 @@ zword save_quetzal(FILE * svf, FILE * stf)
 			    var = zmp[pc];
 			}
 #else
-			var = zmp[pc];
+			/* Code is read live unless it is in dynamic memory */
+			var = (pc < z_header.dynamic_size) ? snap->mem[pc] : zmp[pc];
 #endif
 			pc = ((pc + 1) << 8) | nvars;
 			break;
@@ -593,7 +878,8 @@ zword save_quetzal(FILE * svf, FILE * stf)
 			break;
 			/* case 0x2000: */
 		default:
-			runtime_error(ERR_SAVE_IN_INTER);
+			if (!snap->copy)
+				runtime_error(ERR_SAVE_IN_INTER);
 			return 0;
 		}
 		if (nargs != 0)
@@ -618,16 +904,177 @@ zword save_quetzal(FILE * svf, FILE * stf)
 	ifzslen = 3 * 8 + 4 + 14 + cmemlen + stkslen;
 	if (cmemlen & 1)
 		++ifzslen;
-	(void)fseek(svf, 4, SEEK_SET);
+	q_seek(svf, 4, SEEK_SET);
 	if (!write_long(svf, ifzslen))
 		return 0;
-	(void)fseek(svf, cmempos + 4, SEEK_SET);
+	q_seek(svf, cmempos + 4, SEEK_SET);
 	if (!write_long(svf, cmemlen))
 		return 0;
-	(void)fseek(svf, stkspos + 4, SEEK_SET);
+	q_seek(svf, stkspos + 4, SEEK_SET);
 	if (!write_long(svf, stkslen))
 		return 0;
 
 	/* After all that, still nothing went wrong! */
 	return 1;
 }
+
+
+/*
+ * Describe the live state of the Z-machine as a snapshot.
+ */
+static void live_state(zsnapshot_t * snap)
+{
+	snap->mem = zmp;
+	snap->stack = stack;
+	snap->sp = sp - stack;
+	snap->fp = fp - stack;
+	GET_PC(snap->pc);
+	snap->copy = FALSE;
+}
+
+
+/*
+ * Restore a saved game, or a chain of saves, from a Quetzal file.  stf
+ * is the story file, which holds the original contents of dynamic
+ * memory.
+ */
+zword restore_quetzal(FILE * svf, FILE * stf)
+{
+	qfile_t sq = { NULL, NULL, NULL, 0, 0 };
+	qfile_t tq = { NULL, NULL, NULL, 0, 0 };
+
+	sq.fp = svf;
+	tq.fp = stf;
+	return restore_chain(&sq, &tq);
+}
+
+
+/*
+ * Save a game to a Quetzal file.  stf is the story file, which holds
+ * the original contents of dynamic memory.
+ */
+zword save_quetzal(FILE * svf, FILE * stf)
+{
+	zsnapshot_t snap;
+	qfile_t sq = { NULL, NULL, NULL, 0, 0 };
+	qfile_t tq = { NULL, NULL, NULL, 0, 0 };
+
+	sq.fp = svf;
+	tq.fp = stf;
+	live_state(&snap);
+	return save_chunks(&sq, &tq, NULL, &snap);
+}
+
+
+/*
+ * Save a snapshot of the Z-machine to a Quetzal file.  orig holds the
+ * original contents of dynamic memory.  Nothing but the snapshot and
+ * static memory is read, so this may run while the game goes on.
+ * Return 1 if OK, 0 if failed.
+ */
+zword save_quetzal_snapshot(FILE * svf, const zbyte * orig,
+			    const zsnapshot_t * snap)
+{
+	qfile_t sq = { NULL, NULL, NULL, 0, 0 };
+	qfile_t tq = { NULL, NULL, NULL, 0, 0 };
+
+	sq.fp = svf;
+	tq.data = orig;
+	tq.size = z_header.dynamic_size;
+	return save_chunks(&sq, &tq, NULL, snap);
+}
+
+
+/*
+ * Restore a saved game, or a chain of saves, from Quetzal data of the
+ * given size held in memory.  orig holds the original contents of
+ * dynamic memory.  The return value is the same as for restore_quetzal.
+ */
+zword restore_quetzal_mem(const zbyte * data, long size, const zbyte * orig)
+{
+	qfile_t sq = { NULL, NULL, NULL, 0, 0 };
+	qfile_t tq = { NULL, NULL, NULL, 0, 0 };
+
+	sq.data = data;
+	sq.size = size;
+	tq.data = orig;
+	tq.size = z_header.dynamic_size;
+	return restore_chain(&sq, &tq);
+}
+
+
+/*
+ * Save a game as Quetzal data in a memory buffer, replacing whatever
+ * the buffer held before.  The buffer grows as needed; the caller
+ * frees buf->data when done with it.  orig holds the original contents
+ * of dynamic memory.  The data written is the same as save_quetzal
+ * would write to a file.  Return 1 if OK, 0 if failed.
+ */
+zword save_quetzal_mem(membuf_t * buf, const zbyte * orig)
+{
+	zsnapshot_t snap;
+	qfile_t sq = { NULL, NULL, NULL, 0, 0 };
+	qfile_t tq = { NULL, NULL, NULL, 0, 0 };
+
+	buf->size = 0;
+	sq.buf = buf;
+	tq.data = orig;
+	tq.size = z_header.dynamic_size;
+	live_state(&snap);
+	return save_chunks(&sq, &tq, NULL, &snap);
+}
+
+
+/*
+ * Save a game as a delta save against the memory held in parent, in
+ * the same way as save_quetzal_mem.  parent is updated to the current
+ * memory, ready for the next save in the chain, even if this fails.
+ * Return 1 if OK, 0 if failed.
+ */
+zword save_quetzal_delta(membuf_t * buf, zbyte far * parent)
+{
+	zsnapshot_t snap;
+	qfile_t sq = { NULL, NULL, NULL, 0, 0 };
+
+	buf->size = 0;
+	sq.buf = buf;
+	live_state(&snap);
+	return save_chunks(&sq, NULL, parent, &snap);
+}
+
+
+/*
+ * Return the number of saves in a chain from the last full save on, so
+ * 1 for a single full save.  This lets the caller decide when the chain
+ * is long enough that the next save should be a full one again.
+ */
+int quetzal_chain_length(const zbyte * data, long size)
+{
+	qfile_t sq = { NULL, NULL, NULL, 0, 0 };
+	zlong id, len, type;
+	long end;
+	int length = 0;
+	bool delta;
+
+	sq.data = data;
+	sq.size = size;
+	while (read_long(&sq, &id) && read_long(&sq, &len)
+	    && read_long(&sq, &type)) {
+		if (id != ID_FORM || type != ID_IFZS || len < 4
+		    || len - 4 > (zlong) (size - sq.pos))
+			break;
+		end = sq.pos + (long) len - 4;
+		delta = FALSE;
+		while (sq.pos + 8 <= end && read_long(&sq, &id)
+		    && read_long(&sq, &len)) {
+			if (len > (zlong) (end - sq.pos))
+				break;
+			if (id == ID_DMem)
+				delta = TRUE;
+			sq.pos += (long) len + (long) (len & 1);
+		}
+		length = delta ? length + 1 : 1;
+		sq.pos = end;
+	}
+	return length;
+}
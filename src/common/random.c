@@ -20,6 +20,9 @@
 
 #include "frotz.h"
 
+extern bool replay_read_seed (void);
+extern void record_write_seed (void);
+
 static long A = 1;
 
 static int interval = 0;
@@ -35,8 +38,12 @@ static int counter = 0;
 void seed_random(int value)
 {
 	if (value == 0) {		/* ask interface for seed value */
-		A = os_random_seed();
-		interval = 0;
+		if (!istream_replay || !replay_read_seed()) {
+			A = os_random_seed();
+			interval = 0;
+		}
+		if (ostream_record)
+			record_write_seed();
 	} else if (value < 1000) {	/* special seed value */
 		counter = 0;
 		interval = value;
@@ -47,6 +54,35 @@ void seed_random(int value)
 } /* seed_random */
 
 
+/*
+ * get_random_state
+ *
+ * Return the state of the random number generator, so that a command
+ * file can record it.
+ *
+ */
+void get_random_state(long *seed, int *ival, int *count)
+{
+	*seed = A;
+	*ival = interval;
+	*count = counter;
+} /* get_random_state */
+
+
+/*
+ * set_random_state
+ *
+ * Put the random number generator back in a state from get_random_state.
+ *
+ */
+void set_random_state(long seed, int ival, int count)
+{
+	A = seed;
+	interval = ival;
+	counter = count;
+} /* set_random_state */
+
+
 /*
  * z_random, store a random number or set the random number seed.
  *
@@ -102,6 +102,8 @@ void memory_word(const zchar * s)
 {
 	zword size;
 	zword addr;
+	zword length;
+	zword i;
 	zchar c;
 
 	if (z_header.version == V6) {
@@ -121,8 +123,21 @@ void memory_word(const zchar * s)
 	LOW_WORD(addr, size)
 	addr += 2;
 
-	while ((c = *s++) != 0)
-		storeb((zword) (addr + (size++)), translate_to_zscii(c));
+	for (length = 0; s[length] != 0; length++)
+		;
+
+	/* Write the whole word at once if storeb would have nothing to
+	 * object to, otherwise let storeb report the problem */
+	if ((long) addr + size + length <= 0x10000L &&
+	    range_writable((zword) (addr + size), length)) {
+		for (i = 0; i < length; i++)
+			zmp[addr + size + i] = translate_to_zscii(s[i]);
+		range_written((zword) (addr + size), length);
+		size += length;
+	} else {
+		while ((c = *s++) != 0)
+			storeb((zword) (addr + (size++)), translate_to_zscii(c));
+	}
 
 	storew(redirect[depth].table, size);
 } /* memory_word */
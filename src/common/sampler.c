@@ -0,0 +1,460 @@
+/* sampler.c - Sampling Z-code profiler
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The profiler in profile.c sees every call and return, which is too
+ * slow to leave switched on.  This one is cheap enough for that: the
+ * profiling interval timer sends SIGPROF SAMPLE_HZ times a second of
+ * CPU time, or as near as the kernel's clock tick allows, and the
+ * signal handler copies the program counter and the return addresses
+ * of the frames on the stack, walked the same way as the `Stks' chunk
+ * of quetzal.c walks them, into a ring buffer.  The handler is the only
+ * writer and the interpreter the only reader, so the ring needs no
+ * locks.  It is emptied whenever the story waits for input and at exit;
+ * samples that do not fit meanwhile are counted but dropped.
+ *
+ * To turn addresses into routines, call() marks the start of each
+ * routine it enters in a bitmap while sampling is on, as are the
+ * routines found by symbols.c if the story was analysed, and an
+ * address is taken to belong to the nearest routine starting before
+ * it.  The last return address on the stack is always in code outside
+ * any routine, "(top)".
+ *
+ * The report is written at exit, and when the story waits for input
+ * if REPORT_INTERVAL seconds have passed since it was last written.  As
+ * with profile.c, one file holds collapsed stacks with sample counts
+ * and the same name with ".routines" added holds a table of samples
+ * per routine, in the routine itself and in all it called.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frotz.h"
+
+#ifndef NO_SAMPLING
+
+#include <signal.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define SAMPLE_HZ	1000
+#define SAMPLE_DEPTH	32	/* Addresses kept per sample */
+#define RING_SIZE	4096	/* Samples; a power of two */
+#define REPORT_INTERVAL	60
+
+#define ROUTINE_KEY	-1L
+#define TOP		-1L	/* Address of code outside routines */
+#define UNKNOWN		-2L	/* Address of code before any routine */
+
+typedef struct {
+	int depth;
+	bool truncated;		/* The stack was deeper than SAMPLE_DEPTH */
+	long addr[SAMPLE_DEPTH];	/* PC, then return addresses */
+} sample_t;
+
+typedef struct {
+	long parent;		/* Stack node of the caller */
+	long addr;		/* Start of the routine */
+	zlong self;		/* Samples with this node innermost */
+	zlong total;		/* Samples with this node anywhere */
+} sample_node_t;
+
+bool sampling = FALSE;
+zbyte *routine_map = NULL;
+
+static volatile sample_t *ring = NULL;
+static volatile unsigned ring_head = 0;	/* Written by the handler only */
+static volatile unsigned ring_tail = 0;	/* Written by the reader only */
+static volatile zlong dropped = 0;
+
+static sample_node_t *nodes = NULL;
+static long node_count = 0;
+static long node_space = 0;
+
+static long *hash = NULL;
+static long hash_size = 0;
+
+static zlong samples = 0;
+static time_t last_report;
+
+
+/*
+ * take_sample
+ *
+ * The SIGPROF handler.  Everything it reads may be half updated, so
+ * every frame pointer is checked before it is followed.
+ *
+ */
+static void take_sample(int UNUSED (sig))
+{
+	volatile sample_t *sample;
+	unsigned head = ring_head;
+	long frame;
+	int depth;
+
+	if (head - ring_tail >= RING_SIZE) {
+		dropped++;
+		return;
+	}
+	sample = &ring[head & (RING_SIZE - 1)];
+
+	sample->addr[0] = pcp - zmp;
+	depth = 1;
+	frame = fp - stack;
+	while (frame >= 0 && frame <= STACK_SIZE - 4 &&
+	       depth < SAMPLE_DEPTH) {
+		sample->addr[depth++] =
+			((long) stack[frame + 3] << 9) | stack[frame + 2];
+		frame = stack[frame + 1] + 1;
+	}
+	sample->depth = depth;
+	sample->truncated = frame >= 0 && frame <= STACK_SIZE - 4;
+
+	ring_head = head + 1;
+} /* take_sample */
+
+
+/*
+ * routine_of
+ *
+ * Return the start of the routine holding the given address.
+ *
+ */
+static long routine_of(long addr)
+{
+	long i;
+
+	if (addr < 0 || addr >= story_size)
+		return UNKNOWN;
+
+	for (i = addr; i >= 0; i--) {
+		if ((i & 7) == 7 && routine_map[i >> 3] == 0)
+			i -= 7;
+		else if (routine_map[i >> 3] & (1 << (i & 7)))
+			return i;
+	}
+	return UNKNOWN;
+} /* routine_of */
+
+
+/*
+ * hash_slot
+ *
+ * Return the slot of the hash table that holds, or should hold, the
+ * node with the given parent and address.
+ *
+ */
+static long hash_slot(long parent, long addr)
+{
+	unsigned long h = (unsigned long) addr * 2654435761UL +
+		(unsigned long) parent * 40503UL;
+	long slot = h & (hash_size - 1);
+
+	while (hash[slot] >= 0 && (nodes[hash[slot]].parent != parent ||
+				   nodes[hash[slot]].addr != addr))
+		slot = (slot + 1) & (hash_size - 1);
+	return slot;
+} /* hash_slot */
+
+
+/*
+ * find_node
+ *
+ * Return the node with the given parent and address, making it if
+ * need be.  Per-routine entries are nodes whose parent is ROUTINE_KEY.
+ *
+ */
+static long find_node(long parent, long addr)
+{
+	long slot;
+	long i;
+
+	if (2 * (node_count + 1) > hash_size) {
+		free(hash);
+		hash_size = hash_size ? 2 * hash_size : 1024;
+		if ((hash = malloc(hash_size * sizeof(long))) == NULL)
+			os_fatal("Out of memory");
+		for (i = 0; i < hash_size; i++)
+			hash[i] = -1;
+		for (i = 0; i < node_count; i++)
+			hash[hash_slot(nodes[i].parent, nodes[i].addr)] = i;
+	}
+
+	slot = hash_slot(parent, addr);
+	if (hash[slot] >= 0)
+		return hash[slot];
+
+	if (node_count == node_space) {
+		node_space = node_space ? 2 * node_space : 1024;
+		nodes = realloc(nodes, node_space * sizeof(sample_node_t));
+		if (nodes == NULL)
+			os_fatal("Out of memory");
+	}
+	nodes[node_count].parent = parent;
+	nodes[node_count].addr = addr;
+	nodes[node_count].self = 0;
+	nodes[node_count].total = 0;
+	hash[slot] = node_count;
+	return node_count++;
+} /* find_node */
+
+
+/*
+ * add_sample
+ *
+ * Charge one sample to its call path and to the routines on it.
+ *
+ */
+static void add_sample(volatile sample_t *sample)
+{
+	long routines[SAMPLE_DEPTH + 1];
+	long node;
+	int count = 0;
+	int i, j;
+
+	/* Outermost first: the last return address is outside routines */
+	if (sample->truncated)
+		routines[count++] = UNKNOWN;
+	else
+		routines[count++] = TOP;
+	for (i = sample->depth - (sample->truncated ? 1 : 2); i >= 0; i--)
+		routines[count++] = routine_of(sample->addr[i]);
+
+	node = ROUTINE_KEY - 1;
+	for (i = 0; i < count; i++) {
+		node = find_node(node, routines[i]);
+		nodes[node].total++;
+	}
+	nodes[node].self++;
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < i && routines[j] != routines[i]; j++)
+			;
+		if (j == i)
+			nodes[find_node(ROUTINE_KEY, routines[i])].total++;
+	}
+	nodes[find_node(ROUTINE_KEY, routines[count - 1])].self++;
+	samples++;
+} /* add_sample */
+
+
+/*
+ * addr_name
+ *
+ * Return the name of a routine as it appears in the report.
+ *
+ */
+static const char *addr_name(long addr)
+{
+	static char name[16];
+
+	if (addr == TOP)
+		return "(top)";
+	if (addr == UNKNOWN)
+		return "(unknown)";
+	sprintf(name, "0x%05lx", addr);
+	return name;
+} /* addr_name */
+
+
+/*
+ * print_path
+ *
+ * Print the call path leading to a node, outermost routine first.
+ *
+ */
+static void print_path(FILE *out, long node)
+{
+	long path[SAMPLE_DEPTH + 1];
+	int n = 0;
+
+	for (; node >= 0 && n <= SAMPLE_DEPTH; node = nodes[node].parent)
+		path[n++] = node;
+	while (n-- > 0) {
+		fprintf(out, "%s%s", addr_name(nodes[path[n]].addr),
+			n > 0 ? ";" : "");
+	}
+} /* print_path */
+
+
+/*
+ * compare_routines
+ *
+ * Order routines by samples in the routine itself, most first.
+ *
+ */
+static int compare_routines(const void *a, const void *b)
+{
+	zlong x = nodes[*(const long *) a].self;
+	zlong y = nodes[*(const long *) b].self;
+
+	return (x < y) - (x > y);
+} /* compare_routines */
+
+
+/*
+ * write_report
+ *
+ * Write the collapsed stacks and the routine table.
+ *
+ */
+static void write_report(void)
+{
+	long *routines;
+	long count = 0;
+	long i;
+	char *name;
+	FILE *out;
+
+	last_report = time(NULL);
+
+	routines = malloc((node_count + 1) * sizeof(long));
+	name = malloc(strlen(f_setup.sample_file) + 10);
+	if (routines == NULL || name == NULL)
+		os_fatal("Out of memory");
+
+	if ((out = fopen(f_setup.sample_file, "w")) != NULL) {
+		for (i = 0; i < node_count; i++) {
+			if (nodes[i].parent != ROUTINE_KEY && nodes[i].self > 0) {
+				print_path(out, i);
+				fprintf(out, " %lu\n", nodes[i].self);
+			}
+		}
+		fclose(out);
+	}
+
+	for (i = 0; i < node_count; i++) {
+		if (nodes[i].parent == ROUTINE_KEY)
+			routines[count++] = i;
+	}
+
+	qsort(routines, count, sizeof(long), compare_routines);
+	sprintf(name, "%s.routines", f_setup.sample_file);
+	if ((out = fopen(name, "w")) != NULL) {
+		fprintf(out, "# %lu samples, %d a second asked for, %lu dropped\n",
+			samples, SAMPLE_HZ, dropped);
+		fprintf(out, "# %-9s %10s %10s %8s %8s\n", "routine",
+			"self", "total", "self %", "total %");
+		for (i = 0; i < count; i++) {
+			sample_node_t *r = &nodes[routines[i]];
+
+			fprintf(out, "%-11s %10lu %10lu %8.2f %8.2f\n",
+				addr_name(r->addr), r->self, r->total,
+				100.0 * r->self / samples,
+				100.0 * r->total / samples);
+		}
+		fclose(out);
+	}
+
+	free(routines);
+	free(name);
+} /* write_report */
+
+
+/*
+ * sampler_drain
+ *
+ * Move the samples in the ring into the report, and rewrite the report
+ * if it is due.
+ *
+ */
+void sampler_drain(void)
+{
+	unsigned tail = ring_tail;
+
+	while (tail != ring_head) {
+		add_sample(&ring[tail & (RING_SIZE - 1)]);
+		ring_tail = ++tail;
+	}
+	if (time(NULL) - last_report >= REPORT_INTERVAL)
+		write_report();
+} /* sampler_drain */
+
+
+/*
+ * set_timer
+ *
+ * Make SIGPROF arrive every interval microseconds of CPU time, or stop
+ * it if the interval is 0.
+ *
+ */
+static void set_timer(long interval)
+{
+	struct itimerval value;
+
+	value.it_interval.tv_sec = interval / 1000000;
+	value.it_interval.tv_usec = interval % 1000000;
+	value.it_value = value.it_interval;
+	setitimer(ITIMER_PROF, &value, NULL);
+} /* set_timer */
+
+
+/*
+ * sampler_close
+ *
+ * Called at exit to stop the timer and write the final report.
+ *
+ */
+static void sampler_close(void)
+{
+	set_timer(0);
+	sampler_drain();
+	write_report();
+} /* sampler_close */
+
+
+/*
+ * sampler_open
+ *
+ * Start sampling if a sample file was asked for.
+ *
+ */
+void sampler_open(void)
+{
+	struct sigaction sa;
+	long i;
+
+	if (f_setup.sample_file == NULL || sampling)
+		return;
+
+	ring = calloc(RING_SIZE, sizeof(sample_t));
+	routine_map = calloc(story_size / 8 + 1, 1);
+	if (ring == NULL || routine_map == NULL)
+		os_fatal("Out of memory");
+	for (i = 0; symbols != NULL && i < story_size; i++) {
+		if (symbols[i] & SYM_ROUTINE)
+			routine_map[i >> 3] |= 1 << (i & 7);
+	}
+
+	sampling = TRUE;
+	last_report = time(NULL);
+	atexit(sampler_close);
+
+	/* Restart, so that reading the keyboard is not cut short */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = take_sample;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGPROF, &sa, NULL);
+
+	set_timer(1000000 / SAMPLE_HZ);
+} /* sampler_open */
+
+#endif /* NO_SAMPLING */
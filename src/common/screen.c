@@ -750,6 +750,11 @@ void restart_screen(void)
 		cwp->attribute = 8;
 	}
 
+	/* Select window 0 before anything moves the cursor of the one
+	 * selected, which may be another if the story is restarting */
+	cwin = 0;
+	cwp = wp;
+
 	/* Prepare lower/upper windows and status line */
 	wp[0].attribute = 15;
 
@@ -1176,6 +1181,7 @@ void z_print_table(void)
 	zword addr = zargs[0];
 	zword x;
 	int i, j;
+	long span;
 
 	flush_buffer();
 
@@ -1185,6 +1191,13 @@ void z_print_table(void)
 	if (zargc < 4)
 		zargs[3] = 0;
 
+	/* The table must lie in the lower 64KB; a broken story may ask for
+	 * billions of characters, which would take hours to print */
+	span = (long) zargs[1] + zargs[3];
+	if ((long) addr + zargs[1] > 0x10000 || (zargs[2] > 1 && span > 0 &&
+	    zargs[2] - 1 > (0x10000L - addr - zargs[1]) / span))
+		runtime_error(ERR_ILL_PRINT_ADDR);
+
 	/* Write text in width x height rectangle */
 	x = cwp->x_cursor;
 
@@ -1584,6 +1597,10 @@ void z_show_status(void)
 	if (z_header.version >= V4)
 		return;
 
+	/* Fast-forward shows nothing; the next prompt redraws it */
+	if (fast_forward)
+		return;
+
 	/* Read all relevant global variables from the memory of the
 	   Z-machine into local variables */
 	addr = z_header.globals;
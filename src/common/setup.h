@@ -63,6 +63,28 @@ typedef struct frotz_setup_struct {
 	bool bot_mode;     /* for use with bot wrapper scripts */
 	char *bot_command;
 	bool bot_status;
+	char *bot_server;  /* resident bot mode: "-" or a socket path */
+	int bot_keyframes; /* resident bot mode: saves per delta chain */
+	char *bot_collapse; /* save chain to write out as one save */
+	char *save_store;  /* directory of the shared save store, if any */
+	bool record_binary; /* record commands in the binary format */
+	char *replay_file;  /* command file to fast-forward through */
+	bool replay_hash;   /* report a hash of the fast-forward output */
+	char *profile_file; /* write a routine profile here */
+	int opcode_sample;  /* time one instruction in this many */
+	char *sample_file;  /* write a sampling profile here */
+	char *telemetry;    /* where to send per-turn telemetry */
+	char *coverage_file; /* add the code and text reached to this map */
+	char *symbol_cache; /* analyse the story, keeping the result here */
+	bool trusted;       /* leave out the checks proven needless at load */
+	char *lockstep_file; /* write a trace of the machine state here */
+	zlong lockstep_every; /* a line every this many instructions */
+	zlong lockstep_from; /* starting with this instruction */
+	zlong lockstep_to;  /* and stopping the story after this one */
+	char *fuzz_path;    /* corpus directory, or a test case to run */
+	zlong fuzz_runs;    /* stop fuzzing after this many runs */
+	zlong fuzz_steps;   /* end a run after this many instructions */
+	bool crash_report;  /* write <story>.crash if the interpreter dies */
 	bool use_blorb;
 	bool exec_in_blorb;
 } f_setup_t;
@@ -0,0 +1,839 @@
+/* store.c - Content-addressed store for saved games
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * When f_setup.save_store names a directory, saved games go there
+ * instead of into files of their own.  Many players of one story sit
+ * in the same few states, so the store keeps each piece of save data
+ * only once:
+ *
+ *	<store>/saves/<name>	one manifest per saved game
+ *	<store>/chunks/xx/...	pieces of save data, named by hash
+ *	<store>/lock		taken while the store is used
+ *
+ * A save is made as an ordinary Quetzal image.  The body of each of
+ * its chunks (`CMem', `Stks' and so on) is cut into pieces at points
+ * chosen by the content itself, so that an insertion or change early
+ * in a chunk does not move the cuts further on.  Each piece is keyed
+ * by its 128-bit FNV-1a hash.  The manifest is a text file of lines
+ * with two words each: "IFZS 0" to start, then for every chunk a line
+ * with its id and length, followed by a line with the key and length
+ * of each of its pieces.  Bodies too short to be worth a file of their
+ * own, like `IFhd', are written inline as "= <hex digits>".
+ *
+ * Each piece file starts with a count of the manifest entries that
+ * use it, and is removed when the count drops to zero.  A crash can
+ * leave counts too high; store_collect recounts them from the
+ * manifests and removes whatever is no longer used.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frotz.h"
+
+#ifndef MSDOS_16BIT
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Pieces are cut between these sizes, averaging about 512 bytes */
+#define PIECE_MIN	64
+#define PIECE_MAX	4096
+#define PIECE_MASK	0x1ff
+
+#define KEY_SIZE	16
+#define KEY_CHARS	(2 * KEY_SIZE)
+
+/* Words in a manifest are at most 2 * PIECE_MIN characters */
+#define WORD_SIZE	(2 * PIECE_MIN + 1)
+#define SCAN_WORDS	"%128s %128s"
+
+typedef struct {
+	zbyte key[KEY_SIZE];
+	long count;
+} store_ref_t;
+
+static zlong gear[256];
+static bool gear_ready = FALSE;
+
+
+/*
+ * make_gear
+ *
+ * Fill the table of random values used to find cut points.  They come
+ * from a fixed generator, since the cuts must be the same every run.
+ *
+ */
+static void make_gear(void)
+{
+	zlong x = 0x2545f491UL;
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		x ^= (x << 13) & 0xffffffffUL;
+		x ^= x >> 17;
+		x ^= (x << 5) & 0xffffffffUL;
+		gear[i] = x;
+	}
+	gear_ready = TRUE;
+} /* make_gear */
+
+
+/*
+ * next_cut
+ *
+ * Return the length of the piece starting at data, which is followed
+ * by size bytes in all.
+ *
+ */
+static long next_cut(const zbyte *data, long size)
+{
+	zlong h = 0;
+	long i;
+
+	if (size <= PIECE_MIN)
+		return size;
+	if (size > PIECE_MAX)
+		size = PIECE_MAX;
+
+	for (i = 0; i < size; i++) {
+		h = ((h << 1) + gear[data[i]]) & 0xffffffffUL;
+		if (i >= PIECE_MIN && (h & PIECE_MASK) == 0)
+			return i + 1;
+	}
+	return size;
+} /* next_cut */
+
+
+/*
+ * piece_key
+ *
+ * Set key to the 128-bit FNV-1a hash of a piece, most significant byte
+ * first.  The sum is kept in 16-bit limbs, least significant first, so
+ * no integer type wider than 32 bits is needed.
+ *
+ */
+static void piece_key(const zbyte *data, long size, zbyte *key)
+{
+	static const zlong basis[8] = {
+		0xc58d, 0x6295, 0x2175, 0x62b8,
+		0x0142, 0x07bb, 0x272e, 0x6c62
+	};
+	zlong h[8], r[8];
+	zlong carry;
+	long n;
+	int i;
+
+	memcpy(h, basis, sizeof(h));
+	for (n = 0; n < size; n++) {
+		h[0] ^= data[n];
+
+		/* The FNV prime is 2^88 + 0x13b */
+		for (i = 0, carry = 0; i < 8; i++) {
+			carry += h[i] * 0x13b;
+			r[i] = carry & 0xffff;
+			carry >>= 16;
+		}
+		for (i = 5, carry = 0; i < 8; i++) {
+			carry += r[i] + ((h[i - 5] << 8) & 0xffff);
+			if (i > 5)
+				carry += h[i - 6] >> 8;
+			r[i] = carry & 0xffff;
+			carry >>= 16;
+		}
+		memcpy(h, r, sizeof(h));
+	}
+
+	for (i = 0; i < 8; i++) {
+		key[2 * i] = (zbyte) (h[7 - i] >> 8);
+		key[2 * i + 1] = (zbyte) h[7 - i];
+	}
+} /* piece_key */
+
+
+/*
+ * key_to_text, text_to_key
+ *
+ * Convert between a key and its name as hex digits.
+ *
+ */
+static void key_to_text(const zbyte *key, char *text)
+{
+	int i;
+
+	for (i = 0; i < KEY_SIZE; i++)
+		sprintf(text + 2 * i, "%02x", key[i]);
+} /* key_to_text */
+
+static bool text_to_key(const char *text, zbyte *key)
+{
+	unsigned int x;
+	int i;
+
+	if (strlen(text) != KEY_CHARS)
+		return FALSE;
+	for (i = 0; i < KEY_SIZE; i++) {
+		if (sscanf(text + 2 * i, "%2x", &x) != 1)
+			return FALSE;
+		key[i] = (zbyte) x;
+	}
+	return TRUE;
+} /* text_to_key */
+
+
+/*
+ * store_path
+ *
+ * Return the path of a file in the store, in a static buffer.  With a
+ * key, this is the file of that piece.
+ *
+ */
+static char *store_path(const char *dir, const char *name, const zbyte *key)
+{
+	static char *path = NULL;
+	static size_t path_size = 0;
+	char text[KEY_CHARS + 1];
+	size_t size;
+
+	size = strlen(f_setup.save_store) + strlen(dir) + KEY_CHARS + 8;
+	if (name != NULL)
+		size += strlen(name);
+	if (size > path_size) {
+		free(path);
+		if ((path = malloc(size)) == NULL)
+			os_fatal("Out of memory");
+		path_size = size;
+	}
+
+	if (key != NULL) {
+		key_to_text(key, text);
+		sprintf(path, "%s/%s/%.2s/%s", f_setup.save_store, dir,
+			text, text + 2);
+	} else if (name != NULL)
+		sprintf(path, "%s/%s/%s", f_setup.save_store, dir, name);
+	else
+		sprintf(path, "%s/%s", f_setup.save_store, dir);
+	return path;
+} /* store_path */
+
+
+/*
+ * save_key
+ *
+ * Turn a save file name into the name of its manifest.  Only the last
+ * part of the path is used.  Return NULL if nothing is left.
+ *
+ */
+static const char *save_key(const char *file_name)
+{
+	const char *name = strrchr(file_name, '/');
+
+	name = (name != NULL) ? name + 1 : file_name;
+	if (*name == '\0' || !strcmp(name, ".") || !strcmp(name, ".."))
+		return NULL;
+	return name;
+} /* save_key */
+
+
+/*
+ * lock_store
+ *
+ * Lock the store, creating it if need be, for reading or for writing.
+ * Return the descriptor to give to unlock_store, or -1 on failure.
+ *
+ */
+static int lock_store(bool write)
+{
+	struct flock lock;
+	int fd;
+
+	if (write) {
+		mkdir(f_setup.save_store, 0777);
+		mkdir(store_path("saves", NULL, NULL), 0777);
+		mkdir(store_path("chunks", NULL, NULL), 0777);
+	}
+
+	if ((fd = open(store_path("lock", NULL, NULL), O_RDWR | O_CREAT,
+	    0666)) < 0)
+		return -1;
+
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = write ? F_WRLCK : F_RDLCK;
+	lock.l_whence = SEEK_SET;
+	while (fcntl(fd, F_SETLKW, &lock) < 0) {
+		if (errno != EINTR) {
+			close(fd);
+			return -1;
+		}
+	}
+	return fd;
+} /* lock_store */
+
+static void unlock_store(int fd)
+{
+	close(fd);
+} /* unlock_store */
+
+
+/*
+ * read_count, write_count
+ *
+ * Read and write the use count at the start of a piece file.
+ *
+ */
+static bool read_count(FILE *fp, long *count)
+{
+	zbyte b[4];
+
+	if (fseek(fp, 0, SEEK_SET) != 0 || fread(b, 1, 4, fp) != 4)
+		return FALSE;
+	*count = ((long) b[0] << 24) | ((long) b[1] << 16) |
+		((long) b[2] << 8) | (long) b[3];
+	return TRUE;
+} /* read_count */
+
+static bool write_count(FILE *fp, long count)
+{
+	zbyte b[4];
+
+	b[0] = (zbyte) (count >> 24);
+	b[1] = (zbyte) (count >> 16);
+	b[2] = (zbyte) (count >> 8);
+	b[3] = (zbyte) count;
+	return fseek(fp, 0, SEEK_SET) == 0 && fwrite(b, 1, 4, fp) == 4;
+} /* write_count */
+
+
+/*
+ * add_piece
+ *
+ * Count one more use of a piece, writing it to the store if it is
+ * new.  Return FALSE on failure.
+ *
+ */
+static bool add_piece(const zbyte *data, long size, const zbyte *key)
+{
+	char *path = store_path("chunks", NULL, key);
+	char *new_path;
+	FILE *fp;
+	long count;
+	bool ok;
+
+	if ((fp = fopen(path, "r+b")) != NULL) {
+		ok = read_count(fp, &count) && write_count(fp, count + 1);
+		return (fclose(fp) == 0) && ok;
+	}
+
+	/* Write the new piece under a temporary name, then move it */
+	*strrchr(path, '/') = '\0';
+	mkdir(path, 0777);
+	path[strlen(path)] = '/';
+
+	if ((new_path = malloc(strlen(path) + 5)) == NULL)
+		return FALSE;
+	sprintf(new_path, "%s.new", path);
+	if ((fp = fopen(new_path, "wb")) == NULL) {
+		free(new_path);
+		return FALSE;
+	}
+	ok = write_count(fp, 1) &&
+		fwrite(data, 1, size, fp) == (size_t) size;
+	ok = (fclose(fp) == 0) && ok && rename(new_path, path) == 0;
+	if (!ok)
+		remove(new_path);
+	free(new_path);
+	return ok;
+} /* add_piece */
+
+
+/*
+ * drop_piece
+ *
+ * Count one use less of a piece, removing it when it is not used.
+ *
+ */
+static void drop_piece(const zbyte *key)
+{
+	char *path = store_path("chunks", NULL, key);
+	FILE *fp;
+	long count;
+
+	if ((fp = fopen(path, "r+b")) == NULL)
+		return;
+	if (read_count(fp, &count) && count > 1) {
+		write_count(fp, count - 1);
+		fclose(fp);
+	} else {
+		fclose(fp);
+		remove(path);
+	}
+} /* drop_piece */
+
+
+/*
+ * reserve
+ *
+ * Make room for n more bytes in a buffer.
+ *
+ */
+static bool reserve(membuf_t *buf, long n)
+{
+	zbyte *data;
+	long alloc;
+
+	if (buf->size + n <= buf->alloc)
+		return TRUE;
+	alloc = (buf->alloc != 0) ? 2 * buf->alloc : 0x1000;
+	if (alloc < buf->size + n)
+		alloc = buf->size + n;
+	if ((data = realloc(buf->data, alloc)) == NULL)
+		return FALSE;
+	buf->data = data;
+	buf->alloc = alloc;
+	return TRUE;
+} /* reserve */
+
+
+/*
+ * read_piece
+ *
+ * Append a piece to a buffer, checking it against its key.  Return
+ * FALSE if it is missing or damaged.
+ *
+ */
+static bool read_piece(const zbyte *key, membuf_t *buf)
+{
+	zbyte check[KEY_SIZE];
+	FILE *fp;
+	long size;
+	bool ok;
+
+	if ((fp = fopen(store_path("chunks", NULL, key), "rb")) == NULL)
+		return FALSE;
+	if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp) - 4) < 0 ||
+	    fseek(fp, 4, SEEK_SET) != 0) {
+		fclose(fp);
+		return FALSE;
+	}
+
+	if (!reserve(buf, size)) {
+		fclose(fp);
+		return FALSE;
+	}
+	ok = fread(buf->data + buf->size, 1, size, fp) == (size_t) size;
+	fclose(fp);
+
+	piece_key(buf->data + buf->size, size, check);
+	if (!ok || memcmp(check, key, KEY_SIZE))
+		return FALSE;
+	buf->size += size;
+	return TRUE;
+} /* read_piece */
+
+
+/*
+ * get_long, put_long
+ *
+ * Read and write the big-endian longs of an IFF image.
+ *
+ */
+static zlong get_long(const zbyte *p)
+{
+	return ((zlong) p[0] << 24) | ((zlong) p[1] << 16) |
+		((zlong) p[2] << 8) | (zlong) p[3];
+} /* get_long */
+
+static void put_long(zbyte *p, zlong l)
+{
+	p[0] = (zbyte) (l >> 24);
+	p[1] = (zbyte) (l >> 16);
+	p[2] = (zbyte) (l >> 8);
+	p[3] = (zbyte) l;
+} /* put_long */
+
+
+/*
+ * for_each_piece
+ *
+ * Call fn with the key of every piece a manifest uses.
+ *
+ */
+static void for_each_piece(FILE *fp, void (*fn)(const zbyte *))
+{
+	char word[WORD_SIZE], value[WORD_SIZE];
+	zbyte key[KEY_SIZE];
+
+	while (fscanf(fp, SCAN_WORDS, word, value) == 2)
+		if (text_to_key(word, key))
+			fn(key);
+} /* for_each_piece */
+
+
+/*
+ * store_save
+ *
+ * Save the game in the store under the given file name, replacing any
+ * save of that name.  Return 1 if OK, 0 if failed.
+ *
+ */
+zword store_save(const char *file_name)
+{
+	membuf_t image = { NULL, 0, 0 };
+	const char *name = save_key(file_name);
+	zbyte key[KEY_SIZE];
+	char text[KEY_CHARS + 1];
+	char *new_path = NULL;
+	FILE *fp = NULL;
+	FILE *old_fp;
+	long pos, end, len, cut;
+	int lock = -1;
+	bool ok = FALSE;
+
+	if (name == NULL || !save_frotz_mem(&image))
+		goto done;
+	if (!gear_ready)
+		make_gear();
+	if ((lock = lock_store(TRUE)) < 0)
+		goto done;
+
+	if ((new_path = malloc(strlen(store_path("saves", name, NULL)) + 5))
+	    == NULL)
+		goto done;
+	sprintf(new_path, "%s.new", store_path("saves", name, NULL));
+	if ((fp = fopen(new_path, "w")) == NULL)
+		goto done;
+
+	/* Write the manifest, adding every piece to the store */
+	fprintf(fp, "IFZS 0\n");
+	for (pos = 12; pos + 8 <= image.size; pos = end + (len & 1)) {
+		len = get_long(image.data + pos + 4);
+		pos += 8;
+		if ((end = pos + len) > image.size)
+			goto done;
+		fprintf(fp, "%.4s %ld\n", (char *) image.data + pos - 8, len);
+
+		/* An empty chunk, such as CMem of unchanged memory, needs
+		 * nothing more than its length */
+		if (len > 0 && len <= PIECE_MIN) {
+			fputs("= ", fp);
+			for (; pos < end; pos++)
+				fprintf(fp, "%02x", image.data[pos]);
+			fputc('\n', fp);
+		}
+		for (; pos < end; pos += cut) {
+			cut = next_cut(image.data + pos, end - pos);
+			piece_key(image.data + pos, cut, key);
+			if (!add_piece(image.data + pos, cut, key))
+				goto done;
+			key_to_text(key, text);
+			fprintf(fp, "%s %ld\n", text, cut);
+		}
+	}
+	ok = (fclose(fp) == 0);
+	fp = NULL;
+
+	/*
+	 * Put the manifest in place, then drop the pieces of the old one,
+	 * which can still be read through its open file.
+	 */
+	old_fp = fopen(store_path("saves", name, NULL), "r");
+	ok = ok && rename(new_path, store_path("saves", name, NULL)) == 0;
+	if (old_fp != NULL) {
+		if (ok)
+			for_each_piece(old_fp, drop_piece);
+		fclose(old_fp);
+	}
+
+done:
+	if (fp != NULL)
+		fclose(fp);
+	if (!ok && new_path != NULL)
+		remove(new_path);
+	if (lock >= 0)
+		unlock_store(lock);
+	free(new_path);
+	free(image.data);
+	return ok ? 1 : 0;
+} /* store_save */
+
+
+/*
+ * read_manifest
+ *
+ * Build the Quetzal image of a save back from its manifest.  Return
+ * FALSE if the manifest or one of its pieces is damaged.
+ *
+ */
+static bool read_manifest(FILE *fp, membuf_t *image)
+{
+	char word[WORD_SIZE], value[WORD_SIZE];
+	zbyte key[KEY_SIZE];
+	unsigned int x;
+	long start = 0, length = 0;
+	long n;
+	char *p;
+
+	if (fscanf(fp, SCAN_WORDS, word, value) != 2 || strcmp(word, "IFZS"))
+		return FALSE;
+	if (!reserve(image, 12))
+		return FALSE;
+	memcpy(image->data, "FORM", 4);
+	memcpy(image->data + 8, "IFZS", 4);
+	image->size = 12;
+
+	for (;;) {
+		n = fscanf(fp, SCAN_WORDS, word, value);
+
+		/* Finish the last chunk before starting another */
+		if (image->size > 12 && (n != 2 || strlen(word) == 4)) {
+			if (image->size - start != length)
+				return FALSE;
+			if ((length & 1) && reserve(image, 1))
+				image->data[image->size++] = 0;
+		}
+		if (n != 2)
+			break;
+
+		if (strlen(word) == 4) {
+			length = strtol(value, &p, 10);
+			if (*p != '\0' || length < 0 || !reserve(image, 8))
+				return FALSE;
+			memcpy(image->data + image->size, word, 4);
+			put_long(image->data + image->size + 4, length);
+			image->size += 8;
+			start = image->size;
+		} else if (!strcmp(word, "=")) {
+			if (image->size == 12 || !reserve(image, strlen(value) / 2))
+				return FALSE;
+			for (p = value; p[0] != '\0' && p[1] != '\0'; p += 2) {
+				if (sscanf(p, "%2x", &x) != 1)
+					return FALSE;
+				image->data[image->size++] = (zbyte) x;
+			}
+		} else if (image->size == 12 || !text_to_key(word, key) ||
+		    !read_piece(key, image))
+			return FALSE;
+
+		if (image->size - start > length)
+			return FALSE;
+	}
+
+	put_long(image->data + 4, image->size - 8);
+	return TRUE;
+} /* read_manifest */
+
+
+/*
+ * store_restore
+ *
+ * Restore the game saved in the store under the given file name.
+ * Return 2 if OK, 0 if nothing was changed, or -1 if the game state
+ * is now undefined, like restore_quetzal.
+ *
+ */
+zword store_restore(const char *file_name)
+{
+	membuf_t image = { NULL, 0, 0 };
+	const char *name = save_key(file_name);
+	FILE *fp;
+	int lock;
+	zword success = 0;
+	bool ok = FALSE;
+
+	if (name == NULL || (lock = lock_store(FALSE)) < 0)
+		return 0;
+	if ((fp = fopen(store_path("saves", name, NULL), "r")) != NULL) {
+		ok = read_manifest(fp, &image);
+		fclose(fp);
+	}
+	unlock_store(lock);
+
+	if (ok)
+		success = restore_frotz_mem(image.data, image.size);
+	free(image.data);
+	return success;
+} /* store_restore */
+
+
+/*
+ * store_exists
+ *
+ * Return TRUE if the store holds a save under the given file name.
+ *
+ */
+bool store_exists(const char *file_name)
+{
+	const char *name = save_key(file_name);
+	struct stat st;
+
+	return name != NULL && stat(store_path("saves", name, NULL), &st) == 0;
+} /* store_exists */
+
+
+/*
+ * find_ref, count_ref
+ *
+ * Count one use of a piece in the table store_collect builds, an open
+ * hash table with linear probing.
+ *
+ */
+static store_ref_t *refs = NULL;
+static long refs_size = 0;
+static long refs_used = 0;
+
+static store_ref_t *find_ref(const zbyte *key)
+{
+	long i = (long) (get_long(key) % (zlong) refs_size);
+
+	while (refs[i].count != 0 && memcmp(refs[i].key, key, KEY_SIZE))
+		i = (i + 1) % refs_size;
+	return &refs[i];
+} /* find_ref */
+
+static void count_ref(const zbyte *key)
+{
+	store_ref_t *old = refs;
+	store_ref_t *ref;
+	long old_size = refs_size;
+	long i;
+
+	if (2 * (refs_used + 1) > refs_size) {
+		refs_size = (refs_size != 0) ? 2 * refs_size : 0x400;
+		if ((refs = calloc(refs_size, sizeof(store_ref_t))) == NULL)
+			os_fatal("Out of memory");
+		for (i = 0; i < old_size; i++)
+			if (old[i].count != 0)
+				*find_ref(old[i].key) = old[i];
+		free(old);
+	}
+
+	ref = find_ref(key);
+	if (ref->count == 0) {
+		memcpy(ref->key, key, KEY_SIZE);
+		refs_used++;
+	}
+	ref->count++;
+} /* count_ref */
+
+
+/*
+ * leftover
+ *
+ * Return TRUE for the name of a file left by an interrupted save.
+ *
+ */
+static bool leftover(const char *name)
+{
+	size_t len = strlen(name);
+
+	return len > 4 && !strcmp(name + len - 4, ".new");
+} /* leftover */
+
+
+/*
+ * store_collect
+ *
+ * Count again the uses of every piece in the store, going by the
+ * manifests, and remove the pieces nothing uses along with any files
+ * left behind by an interrupted save.  Return the number of pieces
+ * removed, or -1 if the store could not be read.
+ *
+ */
+long store_collect(void)
+{
+	DIR *dir, *sub;
+	struct dirent *d, *e;
+	zbyte key[KEY_SIZE];
+	char text[KEY_CHARS + 1];
+	char name[KEY_CHARS + 8];
+	FILE *fp;
+	long count;
+	long removed = -1;
+	int lock;
+
+	if ((lock = lock_store(TRUE)) < 0)
+		return -1;
+
+	/* Mark: count the uses in every manifest */
+	if ((dir = opendir(store_path("saves", NULL, NULL))) == NULL)
+		goto done;
+	while ((d = readdir(dir)) != NULL) {
+		if (*d->d_name == '.')
+			continue;
+		if (leftover(d->d_name)) {
+			remove(store_path("saves", d->d_name, NULL));
+			continue;
+		}
+		if ((fp = fopen(store_path("saves", d->d_name, NULL), "r"))
+		    == NULL)
+			continue;
+		for_each_piece(fp, count_ref);
+		fclose(fp);
+	}
+	closedir(dir);
+
+	/* Sweep: fix the count in every piece, removing unused ones */
+	if ((dir = opendir(store_path("chunks", NULL, NULL))) == NULL)
+		goto done;
+	removed = 0;
+	while ((d = readdir(dir)) != NULL) {
+		if (strlen(d->d_name) != 2 ||
+		    (sub = opendir(store_path("chunks", d->d_name, NULL))) == NULL)
+			continue;
+		while ((e = readdir(sub)) != NULL) {
+			if (strlen(e->d_name) > KEY_CHARS + 2)
+				continue;
+			sprintf(name, "%s/%s", d->d_name, e->d_name);
+			if (leftover(e->d_name)) {
+				remove(store_path("chunks", name, NULL));
+				continue;
+			}
+			if (strlen(e->d_name) != KEY_CHARS - 2)
+				continue;
+			sprintf(text, "%s%s", d->d_name, e->d_name);
+			if (!text_to_key(text, key))
+				continue;
+
+			count = (refs_size != 0) ? find_ref(key)->count : 0;
+			if (count == 0) {
+				remove(store_path("chunks", NULL, key));
+				removed++;
+			} else if ((fp = fopen(store_path("chunks", NULL, key),
+			    "r+b")) != NULL) {
+				write_count(fp, count);
+				fclose(fp);
+			}
+		}
+		closedir(sub);
+	}
+	closedir(dir);
+
+done:
+	free(refs);
+	refs = NULL;
+	refs_size = refs_used = 0;
+	unlock_store(lock);
+	return removed;
+} /* store_collect */
+
+#endif /* MSDOS_16BIT */
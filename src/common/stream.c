@@ -51,6 +51,8 @@ extern void screen_write_input(const zchar *, zchar);
 extern void screen_erase_input(const zchar *);
 extern void screen_mssg_on(void);
 extern void screen_mssg_off(void);
+extern void fast_forward_char(zchar);
+extern void fast_forward_word(const zchar *);
 
 extern zchar replay_read_key(void);
 extern zchar replay_read_input(zchar *);
@@ -70,7 +72,7 @@ void stream_mssg_on(void)
 {
 	flush_buffer();
 
-	if (ostream_screen)
+	if (ostream_screen && !fast_forward)
 		screen_mssg_on();
 	if (ostream_script && enable_scripting)
 		script_mssg_on();
@@ -89,7 +91,7 @@ void stream_mssg_off(void)
 {
 	flush_buffer();
 
-	if (ostream_screen)
+	if (ostream_screen && !fast_forward)
 		screen_mssg_off();
 	if (ostream_script && enable_scripting)
 		script_mssg_off();
@@ -151,7 +153,12 @@ void z_output_stream(void)
  */
 void stream_char(zchar c)
 {
-	if (ostream_screen)
+	turn_stats.printed++;
+	if (lockstep)
+		lockstep_char(c);
+	if (ostream_screen && fast_forward)
+		fast_forward_char(c);
+	else if (ostream_screen)
 		screen_char(c);
 	if (ostream_script && enable_scripting)
 		script_char(c);
@@ -166,10 +173,19 @@ void stream_char(zchar c)
  */
 void stream_word(const zchar * s)
 {
+	const zchar *c;
+
 	if (ostream_memory && !message)
 		memory_word(s);
 	else {
-		if (ostream_screen)
+		/* Count characters the way stream_char does */
+		for (c = s; *c != 0; c++)
+			if (lockstep)
+				lockstep_char(*c);
+		turn_stats.printed += c - s;
+		if (ostream_screen && fast_forward)
+			fast_forward_word(s);
+		else if (ostream_screen)
 			screen_word(s);
 		if (ostream_script && enable_scripting)
 			script_word(s);
@@ -188,7 +204,12 @@ void stream_new_line(void)
 	if (ostream_memory && !message)
 		memory_new_line();
 	else {
-		if (ostream_screen)
+		turn_stats.printed++;
+		if (lockstep)
+			lockstep_char('\n');
+		if (ostream_screen && fast_forward)
+			fast_forward_char('\n');
+		else if (ostream_screen)
 			screen_new_line();
 		if (ostream_script && enable_scripting)
 			script_new_line();
@@ -224,6 +245,15 @@ zchar stream_read_key(zword timeout, zword routine, bool hot_keys)
 	zchar key = ZC_BAD;
 	flush_buffer();
 
+	if (telemetry)
+		telemetry_input();
+#ifndef NO_SAMPLING
+	if (sampling)
+		sampler_drain();
+#endif
+	if (coverage)
+		cover_write(FALSE);
+
 	/* Read key from current input stream */
 continue_input:
 	do {
@@ -268,6 +298,8 @@ continue_input:
 	}
 
 	/* Return key */
+	if (telemetry)
+		telemetry_resume();
 	return key;
 } /* stream_read_key */
 
@@ -286,10 +318,19 @@ zchar stream_read_input(int max, zchar * buf,
 
 	flush_buffer();
 
+	if (telemetry)
+		telemetry_input();
+#ifndef NO_SAMPLING
+	if (sampling)
+		sampler_drain();
+#endif
+	if (coverage)
+		cover_write(FALSE);
+
 	/* Remove initial input from the transcript file or from the screen */
 	if (ostream_script && enable_scripting && !no_scripting)
 		script_erase_input(buf);
-	if (istream_replay)
+	if (istream_replay && !fast_forward)
 		screen_erase_input(buf);
 
 	/* Read input line from current input stream */
@@ -338,9 +379,13 @@ continue_input:
 	/* Copy input line to transcript file or to the screen */
 	if (ostream_script && enable_scripting && !no_scripting)
 		script_write_input(buf, key);
-	if (istream_replay)
+	if (istream_replay && fast_forward)
+		fast_forward_word(buf);
+	else if (istream_replay)
 		screen_write_input(buf, key);
 
 	/* Return terminating key */
+	if (telemetry)
+		telemetry_resume();
 	return key;
 } /* stream_read_input */
@@ -0,0 +1,805 @@
+/* symbols.c - Static analysis of the story file
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * If a symbol cache directory is given, or trusted mode is asked for,
+ * the story is disassembled when it is loaded.  Starting from the
+ * initial PC, every instruction is decoded and the calls, branches and
+ * jumps with constant targets are followed, as are the strings printed
+ * by address.  The result is
+ * symbols[], one byte of SYM_ flags for every byte of the story, which
+ * tells where routines, instructions and strings start and which bytes
+ * are code or text rather than data.  The profilers, the coverage map
+ * and the crash recorder all look things up here.
+ *
+ * Routines only ever called through a variable cannot be found this
+ * way, so the table is a lower bound on the code in the story.
+ *
+ * Large stories take a while to analyse, so the table is kept in the
+ * cache directory in a file named for the story's release, serial
+ * number and checksum, and read from there on later starts.  The file
+ * is "ZSYM", the release (2 bytes), serial (6), checksum (2) and story
+ * size (4), then symbols[] as it is.
+ *
+ * In trusted mode, every instruction found in static memory, which the
+ * story cannot change, is then checked against what its handler checks
+ * at run time.  A call to a routine found here, a jump that stays in
+ * the story, a store to a constant address in dynamic memory and an
+ * attribute of a constant object are sure to pass, and are marked with
+ * SYM_SAFE, and interpret() runs them with handlers that leave the
+ * checks out.  Everything else, and anything with an operand that is
+ * not a constant, goes through the usual handlers and is reported as
+ * -Z says.  The stack checks stay everywhere, as how deep the stack
+ * is depends on the path taken to the instruction.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "frotz.h"
+
+#define KEY_SIZE 18
+
+/* What an opcode does besides take operands */
+#define OP_STORE	0x01
+#define OP_BRANCH	0x02
+#define OP_TEXT		0x04	/* Followed by a string */
+#define OP_CALL		0x08	/* The first operand is a routine */
+#define OP_JUMP		0x10	/* The first operand is an offset */
+#define OP_PADDR	0x20	/* The first operand is a packed string */
+#define OP_ADDR		0x40	/* The first operand is a string */
+#define OP_STOP		0x80	/* The next instruction is not run */
+#define OP_ILLEGAL	0x100
+
+typedef struct {
+	int opcode;		/* The first byte */
+	int flags;		/* OP_ flags of the opcode */
+	int count;		/* Number of operands */
+	bool constant[8];	/* Which operands are constants */
+	zword value[8];		/* and what they are */
+	long target;		/* Where a branch or jump goes, or -1 */
+	long text;		/* Where the string in it starts, or -1 */
+} insn_t;
+
+zbyte *symbols = NULL;
+
+static long first_string;	/* The lowest packed string found */
+static long *pending = NULL;
+static long pending_count = 0;
+static long pending_space = 0;
+
+static const int op2_flags[0x20] = {
+	OP_ILLEGAL, OP_BRANCH, OP_BRANCH, OP_BRANCH,		/* je ... */
+	OP_BRANCH, OP_BRANCH, OP_BRANCH, OP_BRANCH,		/* dec_chk ... */
+	OP_STORE, OP_STORE, OP_BRANCH, 0,			/* or ... */
+	0, 0, 0, OP_STORE,					/* clear_attr ... */
+	OP_STORE, OP_STORE, OP_STORE, OP_STORE,			/* loadb ... */
+	OP_STORE, OP_STORE, OP_STORE, OP_STORE,			/* add ... */
+	OP_STORE, OP_STORE | OP_CALL, OP_CALL, 0,		/* mod ... */
+	OP_STOP, OP_ILLEGAL, OP_ILLEGAL, OP_ILLEGAL		/* throw ... */
+};
+
+static const int op1_flags[0x10] = {
+	OP_BRANCH, OP_STORE | OP_BRANCH, OP_STORE | OP_BRANCH,	/* jz ... */
+	OP_STORE, OP_STORE, 0, 0, OP_ADDR,			/* get_parent ... */
+	OP_STORE | OP_CALL, 0, 0, OP_STOP,			/* call_1s ... */
+	OP_JUMP | OP_STOP, OP_PADDR, OP_STORE, OP_CALL		/* jump ... */
+};
+
+static const int op0_flags[0x10] = {
+	OP_STOP, OP_STOP, OP_TEXT, OP_TEXT | OP_STOP,		/* rtrue ... */
+	0, OP_ILLEGAL, OP_ILLEGAL, OP_STOP,			/* nop ... */
+	OP_STOP, OP_STORE, OP_STOP, 0,				/* ret_popped ... */
+	0, OP_BRANCH, OP_ILLEGAL, OP_BRANCH			/* show_status ... */
+};
+
+static const int var_flags[0x20] = {
+	OP_STORE | OP_CALL, 0, 0, 0,				/* call_vs ... */
+	OP_STORE, 0, 0, OP_STORE,				/* read ... */
+	0, 0, 0, 0,						/* push ... */
+	OP_STORE | OP_CALL, 0, 0, 0,				/* call_vs2 ... */
+	0, 0, 0, 0,						/* get_cursor ... */
+	0, 0, OP_STORE, OP_STORE | OP_BRANCH,			/* input_stream ... */
+	OP_STORE, OP_CALL, OP_CALL, 0,				/* not ... */
+	0, 0, 0, OP_BRANCH					/* encode_text ... */
+};
+
+static const int ext_flags[0x1d] = {
+	OP_STORE, OP_STORE, OP_STORE, OP_STORE,			/* save ... */
+	OP_STORE, 0, OP_BRANCH, 0,				/* set_font ... */
+	0, OP_STORE, OP_STORE, 0,				/* set_margins ... */
+	OP_STORE, 0, OP_ILLEGAL, OP_ILLEGAL,			/* check_unicode ... */
+	0, 0, 0, OP_STORE,					/* move_window ... */
+	0, 0, 0, 0,						/* scroll_window ... */
+	OP_BRANCH, 0, 0, OP_BRANCH,				/* push_stack ... */
+	0							/* picture_table */
+};
+
+
+/*
+ * opcode_flags
+ *
+ * Return what an opcode does in the story's version of the Z-machine.
+ * ext is the extended opcode if opcode is 0xbe.
+ *
+ */
+static int opcode_flags(int opcode, int ext)
+{
+	zbyte version = z_header.version;
+
+	if (opcode < 0x80 || (opcode >= 0xc0 && opcode < 0xe0)) {
+		if ((opcode & 0x1f) == 0x19 && version < V4)
+			return OP_ILLEGAL;
+		if ((opcode & 0x1f) >= 0x1a && version < V5)
+			return OP_ILLEGAL;
+		return op2_flags[opcode & 0x1f];
+	}
+	if (opcode < 0xb0) {
+		if ((opcode & 0x0f) == 0x0f && version < V5)
+			return OP_STORE;	/* not */
+		return op1_flags[opcode & 0x0f];
+	}
+	if (opcode < 0xc0) {
+		switch (opcode) {
+		case 0xb5:		/* save */
+		case 0xb6:		/* restore */
+			if (version <= V3)
+				return OP_BRANCH;
+			return version == V4 ? OP_STORE : OP_ILLEGAL;
+		case 0xb9:		/* pop, or catch from V5 on */
+			return version < V5 ? 0 : OP_STORE;
+		case 0xbe:		/* extended */
+			if (version < V5)
+				return OP_ILLEGAL;
+			/* Those from 0x1d on are reserved, and skipped */
+			return ext < 0x1d ? ext_flags[ext] : 0;
+		default:
+			return op0_flags[opcode - 0xb0];
+		}
+	}
+	switch (opcode) {
+	case 0xe4:			/* read */
+		return version < V5 ? 0 : OP_STORE;
+	case 0xe9:			/* pull */
+		return version == V6 ? OP_STORE : 0;
+	default:
+		return var_flags[opcode - 0xe0];
+	}
+} /* opcode_flags */
+
+
+/*
+ * unpack
+ *
+ * Turn a packed address into a byte address.
+ *
+ */
+static long unpack(zword packed, zword offset)
+{
+	if (z_header.version <= V3)
+		return (long) packed << 1;
+	else if (z_header.version <= V5)
+		return (long) packed << 2;
+	else if (z_header.version <= V7)
+		return ((long) packed << 2) + ((long) offset << 3);
+	else
+		return (long) packed << 3;
+} /* unpack */
+
+
+/*
+ * push_code
+ *
+ * Remember to decode the instructions at an address.
+ *
+ */
+static void push_code(long addr)
+{
+	if (addr < 64 || addr >= story_size || (symbols[addr] & SYM_INSN))
+		return;
+	if (pending_count == pending_space) {
+		pending_space = pending_space ? 2 * pending_space : 1024;
+		pending = realloc(pending, pending_space * sizeof(long));
+		if (pending == NULL)
+			os_fatal("Out of memory");
+	}
+	pending[pending_count++] = addr;
+} /* push_code */
+
+
+/*
+ * add_string
+ *
+ * Mark a string, and return the address after it or -1 if it runs off
+ * the end of the story.
+ *
+ */
+static long add_string(long addr)
+{
+	if (addr < 64 || addr >= story_size)
+		return -1;
+	symbols[addr] |= SYM_STRING;
+	for (; addr + 1 < story_size; addr += 2) {
+		symbols[addr] |= SYM_TEXT;
+		symbols[addr + 1] |= SYM_TEXT;
+		if (zmp[addr] & 0x80)
+			return addr + 2;
+	}
+	return -1;
+} /* add_string */
+
+
+/*
+ * add_routine
+ *
+ * Mark a routine header and remember to decode the code after it.
+ *
+ */
+static void add_routine(long addr)
+{
+	long end;
+	long i;
+
+	if (addr < 64 || addr >= story_size || (symbols[addr] & SYM_ROUTINE))
+		return;
+	if (zmp[addr] > 15)
+		return;
+	end = addr + 1;
+	if (z_header.version <= V4)
+		end += 2 * zmp[addr];
+	if (end >= story_size)
+		return;
+
+	symbols[addr] |= SYM_ROUTINE;
+	for (i = addr; i < end; i++)
+		symbols[i] |= SYM_CODE;
+	push_code(end);
+} /* add_routine */
+
+
+/*
+ * read_operands
+ *
+ * Read the operands given by a type specifier byte into insn, and
+ * return the address after them.
+ *
+ */
+static long read_operands(long pc, zbyte specifier, insn_t *insn)
+{
+	int i;
+
+	for (i = 6; i >= 0; i -= 2) {
+		int type = (specifier >> i) & 3;
+
+		if (type == 3)
+			break;
+		insn->constant[insn->count] = type != 2;
+		insn->value[insn->count] = (type == 0) ?
+			(zword) (zmp[pc] << 8 | zmp[pc + 1]) : zmp[pc];
+		pc += (type == 0) ? 2 : 1;
+		insn->count++;
+	}
+	return pc;
+} /* read_operands */
+
+
+/*
+ * decode
+ *
+ * Decode the instruction at addr into insn.  Return the address after
+ * it, or -1 if it is not a legal instruction.
+ *
+ */
+static long decode(long addr, insn_t *insn)
+{
+	long pc = addr;
+	int opcode;
+	int ext = 0;
+
+	/* Leave room for the longest instruction short of its text */
+	if (addr < 64 || addr + 23 > story_size)
+		return -1;
+
+	insn->count = 0;
+	insn->constant[0] = FALSE;
+	insn->target = -1;
+	insn->text = -1;
+
+	opcode = zmp[pc++];
+	insn->opcode = opcode;
+	if (opcode < 0x80) {
+		pc = read_operands(pc, (zbyte) (((opcode & 0x40) ? 0x80 : 0x40) |
+					       ((opcode & 0x20) ? 0x20 : 0x10) |
+					       0x0f), insn);
+	} else if (opcode < 0xb0) {
+		pc = read_operands(pc, (zbyte) (((opcode >> 4) & 3) << 6 | 0x3f),
+				   insn);
+	} else if (opcode < 0xc0) {
+		if (opcode == 0xbe && z_header.version >= V5) {
+			ext = zmp[pc++];
+			pc = read_operands(pc + 1, zmp[pc], insn);
+		}
+	} else {
+		zbyte specifier1 = zmp[pc++];
+		zbyte specifier2 = 0xff;
+
+		if (opcode == 0xec || opcode == 0xfa)
+			specifier2 = zmp[pc++];
+		pc = read_operands(pc, specifier1, insn);
+		if (insn->count == 4)
+			pc = read_operands(pc, specifier2, insn);
+	}
+
+	insn->flags = opcode_flags(opcode, ext);
+	if (insn->flags & OP_ILLEGAL)
+		return -1;
+
+	if (insn->flags & OP_STORE)
+		pc++;
+	if (insn->flags & OP_BRANCH) {
+		zbyte b = zmp[pc++];
+		long offset = b & 0x3f;
+
+		if (!(b & 0x40)) {
+			offset = (offset << 8) | zmp[pc++];
+			if (offset & 0x2000)
+				offset -= 0x4000;
+		}
+		if (offset > 1 || offset < 0)
+			insn->target = pc + offset - 2;
+	}
+	if (insn->flags & OP_TEXT) {
+		insn->text = pc;
+		for (; pc + 1 < story_size && !(zmp[pc] & 0x80); pc += 2)
+			;
+		if ((pc += 2) > story_size)
+			return -1;
+	}
+	if ((insn->flags & OP_JUMP) && insn->constant[0])
+		insn->target = pc + (short) insn->value[0] - 2;
+	return pc;
+} /* decode */
+
+
+/*
+ * walk_instruction
+ *
+ * Decode the instruction at addr, mark it and note where it leads.
+ * Return the address of the next instruction, or -1 if the code does
+ * not go on to it.
+ *
+ */
+static long walk_instruction(long addr)
+{
+	insn_t insn;
+	long pc;
+	long i;
+
+	if ((pc = decode(addr, &insn)) < 0)
+		return -1;
+
+	symbols[addr] |= SYM_INSN;
+	for (i = addr; i < pc; i++)
+		symbols[i] |= SYM_CODE;
+
+	if (insn.target >= 0)
+		push_code(insn.target);
+	if (insn.text >= 0)
+		add_string(insn.text);
+
+	/* Only constant operands say where things are */
+	if (insn.constant[0]) {
+		if ((insn.flags & OP_CALL) && insn.value[0] != 0)
+			add_routine(unpack(insn.value[0],
+					   z_header.functions_offset));
+		if (insn.flags & OP_PADDR) {
+			i = unpack(insn.value[0], z_header.strings_offset);
+			if (add_string(i) >= 0 && i > z_header.resident_size &&
+			    i < first_string)
+				first_string = i;
+		}
+		if (insn.flags & OP_ADDR)
+			add_string(insn.value[0]);
+	}
+
+	return (insn.flags & OP_STOP) ? -1 : pc;
+} /* walk_instruction */
+
+
+/*
+ * walk_pending
+ *
+ * Decode all the code waiting to be decoded, and all it leads to.
+ *
+ */
+static void walk_pending(void)
+{
+	long addr;
+
+	while (pending_count > 0) {
+		addr = pending[--pending_count];
+		while (addr >= 0 && !(symbols[addr] & SYM_INSN))
+			addr = walk_instruction(addr);
+	}
+} /* walk_pending */
+
+
+/*
+ * code_end
+ *
+ * Decode the code at pc, in a routine starting at start, straight
+ * through until an instruction that does not go on is followed by
+ * nothing any branch or jump leads to.  Return the address after it,
+ * or -1 if anything on the way is not a legal instruction or leads
+ * out of the routine backwards.
+ *
+ */
+static long code_end(long pc, long start)
+{
+	insn_t insn;
+	long furthest = pc;
+
+	for (;;) {
+		if ((pc = decode(pc, &insn)) < 0)
+			return -1;
+		if (insn.target >= 0 && insn.target <= start)
+			return -1;
+		if (insn.target > furthest)
+			furthest = insn.target;
+		if ((insn.flags & OP_STOP) && pc > furthest)
+			return pc;
+	}
+} /* code_end */
+
+
+/*
+ * routine_end
+ *
+ * Return the end of what would be a routine at addr, or -1 if it
+ * cannot be one.
+ *
+ */
+static long routine_end(long addr)
+{
+	long pc;
+
+	if (addr < 64 || addr >= story_size || zmp[addr] > 15)
+		return -1;
+	pc = addr + 1;
+	if (z_header.version <= V4)
+		pc += 2 * zmp[addr];
+	return code_end(pc, addr);
+} /* routine_end */
+
+
+/*
+ * analyse
+ *
+ * Walk the story from its initial PC and its abbreviations.
+ *
+ */
+static void analyse(void)
+{
+	long addr;
+	long end;
+	long last = 0;
+	long routine;
+	int align;
+	int i;
+
+	if (z_header.version == V6)
+		add_routine(unpack(z_header.start_pc,
+				   z_header.functions_offset));
+	else {
+		/* The main routine has no locals and so a one byte header */
+		addr = z_header.start_pc - 1;
+		if (addr >= 64 && zmp[addr] == 0)
+			symbols[addr] |= SYM_ROUTINE | SYM_CODE;
+		push_code(z_header.start_pc);
+	}
+
+	if (z_header.abbreviations != 0) {
+		for (i = 0; i < 96; i++) {
+			addr = z_header.abbreviations + 2 * i;
+			if (addr + 1 < story_size)
+				add_string((long) (zmp[addr] << 8 |
+						   zmp[addr + 1]) << 1);
+		}
+	}
+
+	first_string = story_size;
+	walk_pending();
+
+	/*
+	 * Most routines in a story are only called through variables and
+	 * properties.  Compilers lay routines end to end from the start
+	 * of high memory, each at the first packed address after the
+	 * last, and put the strings after them, so look for one after
+	 * each routine, and skip to the next routine already known where
+	 * there is none.
+	 */
+	align = z_header.version <= V3 ? 2 : z_header.version <= V7 ? 4 : 8;
+	addr = ((long) z_header.resident_size + align - 1) & ~(long) (align - 1);
+	routine = -1;
+	while (addr < first_string) {
+		if ((end = routine_end(addr)) >= 0) {
+			add_routine(addr);
+			routine = addr;
+		} else if (routine >= 0 && (end = code_end(last, routine)) >= 0) {
+			/* More of the last routine, after code that never
+			   goes on, such as the return compilers add at the end */
+			push_code(last);
+		} else {
+			routine = -1;
+			for (addr++; addr < first_string; addr++) {
+				if (symbols[addr] & SYM_ROUTINE)
+					break;
+			}
+			continue;
+		}
+		walk_pending();
+		last = end;
+		addr = (end + align - 1) & ~(long) (align - 1);
+	}
+
+	free(pending);
+	pending = NULL;
+	pending_space = 0;
+} /* analyse */
+
+
+/*
+ * proven
+ *
+ * Return TRUE if the instruction at addr, decoded into insn, cannot
+ * fail any check its handler makes other than those on the stack.
+ * Code in dynamic memory could be changed after it is looked at, so
+ * only code in static memory is.
+ *
+ */
+static bool proven(long addr, const insn_t *insn)
+{
+	zword limit = (z_header.version <= V3) ? 255 : MAX_OBJECT;
+	int opcode = insn->opcode;
+	long target;
+	zword addr2;
+
+	if (addr < z_header.dynamic_size || insn->count == 0 ||
+	    !insn->constant[0])
+		return FALSE;
+
+	/* A call to a routine header, which cannot change either.  The
+	 * flag may come from a cache, so the header is looked at too */
+	if (insn->flags & OP_CALL) {
+		target = unpack(insn->value[0], z_header.functions_offset);
+		return insn->value[0] != 0 &&
+			target >= z_header.dynamic_size && target < story_size &&
+			(symbols[target] & SYM_ROUTINE) && zmp[target] <= 15;
+	}
+
+	/* A jump to somewhere in the story */
+	if (insn->flags & OP_JUMP)
+		return insn->target >= 0 && insn->target < story_size;
+
+	if (insn->count < 2 || !insn->constant[1])
+		return FALSE;
+
+	/* test_attr, set_attr and clear_attr of a legal object */
+	if (opcode < 0x80 || (opcode >= 0xc0 && opcode < 0xe0)) {
+		switch (opcode & 0x1f) {
+		case 0x0a:
+		case 0x0b:
+		case 0x0c:
+			return insn->value[0] != 0 && insn->value[0] <= limit &&
+				insn->value[1] <=
+				((z_header.version <= V3) ? 31 : 47);
+		default:
+			return FALSE;
+		}
+	}
+
+	/* storew and storeb to a table entry in dynamic memory */
+	if (opcode == 0xe1) {
+		addr2 = insn->value[0] + 2 * insn->value[1];
+		return insn->count >= 3 &&
+			(long) addr2 + 1 < z_header.dynamic_size;
+	}
+	if (opcode == 0xe2) {
+		addr2 = insn->value[0] + insn->value[1];
+		return insn->count >= 3 && addr2 < z_header.dynamic_size;
+	}
+	return FALSE;
+} /* proven */
+
+
+/*
+ * verify
+ *
+ * Mark the instructions that are proven safe.
+ *
+ */
+static void verify(void)
+{
+	insn_t insn;
+	long addr;
+
+	for (addr = 0; addr < story_size; addr++) {
+		symbols[addr] &= ~SYM_SAFE;
+		if ((symbols[addr] & SYM_INSN) && decode(addr, &insn) >= 0 &&
+		    proven(addr, &insn))
+			symbols[addr] |= SYM_SAFE;
+	}
+} /* verify */
+
+
+/*
+ * make_key
+ *
+ * Fill in the header that ties a cache file to the story.
+ *
+ */
+static void make_key(zbyte *key)
+{
+	memcpy(key, "ZSYM", 4);
+	key[4] = (zbyte) (z_header.release >> 8);
+	key[5] = (zbyte) z_header.release;
+	memcpy(key + 6, z_header.serial, 6);
+	key[12] = (zbyte) (z_header.checksum >> 8);
+	key[13] = (zbyte) z_header.checksum;
+	key[14] = (zbyte) (story_size >> 24);
+	key[15] = (zbyte) (story_size >> 16);
+	key[16] = (zbyte) (story_size >> 8);
+	key[17] = (zbyte) story_size;
+} /* make_key */
+
+
+/*
+ * cache_name
+ *
+ * Return the name of the cache file for the story.
+ *
+ */
+static char *cache_name(void)
+{
+	const char *dir = f_setup.symbol_cache;
+	char serial[7];
+	char *name;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		serial[i] = isalnum(z_header.serial[i]) ?
+			(char) z_header.serial[i] : '_';
+	serial[6] = 0;
+
+	if ((name = malloc(strlen(dir) + 32)) == NULL)
+		os_fatal("Out of memory");
+	sprintf(name, "%s/%u-%s-%04x.zsym", dir, (unsigned) z_header.release,
+		serial, (unsigned) z_header.checksum);
+	return name;
+} /* cache_name */
+
+
+/*
+ * read_cache, write_cache
+ *
+ * Load the table from the cache file, or save it there.  A cache file
+ * that does not match the story is ignored, and overwritten.  A new
+ * file is written under another name and then renamed, so that
+ * another interpreter never reads half of one.
+ *
+ */
+static bool read_cache(const char *name)
+{
+	zbyte want[KEY_SIZE];
+	zbyte key[KEY_SIZE];
+	bool ok;
+	FILE *in;
+
+	if ((in = fopen(name, "rb")) == NULL)
+		return FALSE;
+	make_key(want);
+	ok = fread(key, 1, KEY_SIZE, in) == KEY_SIZE &&
+		memcmp(key, want, KEY_SIZE) == 0 &&
+		fread(symbols, 1, story_size, in) == (size_t) story_size;
+	fclose(in);
+	return ok;
+} /* read_cache */
+
+static void write_cache(const char *name)
+{
+	zbyte key[KEY_SIZE];
+	char *temp;
+	bool ok;
+	FILE *out;
+
+	if ((temp = malloc(strlen(name) + 5)) == NULL)
+		return;
+	sprintf(temp, "%s.new", name);
+	if ((out = fopen(temp, "wb")) != NULL) {
+		make_key(key);
+		ok = fwrite(key, 1, KEY_SIZE, out) == KEY_SIZE &&
+			fwrite(symbols, 1, story_size, out) ==
+			(size_t) story_size;
+		if (fclose(out) == 0 && ok) {
+			remove(name);
+			rename(temp, name);
+		} else
+			remove(temp);
+	}
+	free(temp);
+} /* write_cache */
+
+
+/*
+ * init_symbols
+ *
+ * Build the symbol table, or load it from the cache, if a cache
+ * directory was given or trusted mode asked for.  In trusted mode,
+ * verify the instructions and switch to the unchecked handlers.
+ *
+ */
+void init_symbols(void)
+{
+	char *name;
+
+	if ((f_setup.symbol_cache == NULL && !f_setup.trusted) ||
+	    symbols != NULL)
+		return;
+
+	if ((symbols = calloc(story_size, 1)) == NULL)
+		os_fatal("Out of memory");
+
+	if (f_setup.symbol_cache == NULL)
+		analyse();
+	else {
+		name = cache_name();
+		if (!read_cache(name)) {
+			memset(symbols, 0, story_size);
+			analyse();
+			write_cache(name);
+		}
+		free(name);
+	}
+
+	if (f_setup.trusted) {
+		verify();
+		trust_opcodes();
+	}
+} /* init_symbols */
+
+
+/*
+ * symbol_routine
+ *
+ * Return the start of the routine holding an address, or -1 if the
+ * address is not in any routine found.
+ *
+ */
+long symbol_routine(long addr)
+{
+	if (symbols == NULL || addr < 0 || addr >= story_size ||
+	    !(symbols[addr] & SYM_CODE))
+		return -1;
+	for (; addr >= 0; addr--) {
+		if (symbols[addr] & SYM_ROUTINE)
+			return addr;
+	}
+	return -1;
+} /* symbol_routine */
@@ -18,8 +18,57 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <string.h>
 #include "frotz.h"
 
+/* A block of bytes lies within memory, without wrapping around 64K */
+#define IN_MEMORY(addr, size) ((long) (addr) + (size) <= story_size && \
+	(long) (addr) + (size) <= 0x10000L)
+
+
+/*
+ * copy_table_fast
+ *
+ * Carry out @copy_table with memset or memmove.  Return false, leaving
+ * the work to the byte by byte loops, if the table doesn't fit within
+ * memory or touches the flags register.
+ *
+ * A negative size asks for a forward copy even when the tables
+ * overlap, which repeats the start of the source; memmove would not,
+ * so that case is copied forwards by hand.
+ *
+ */
+static bool copy_table_fast(void)
+{
+	zword src = zargs[0];
+	zword dst = zargs[1];
+	zword size = zargs[2];
+	zword i;
+
+	if (dst == 0) {		/* zero table */
+		if (!range_writable(src, size))
+			return FALSE;
+		memset(zmp + src, 0, size);
+		range_written(src, size);
+		return TRUE;
+	}
+
+	if ((short) size < 0)
+		size = -(short) size;
+
+	if (!IN_MEMORY(src, size) || !range_writable(dst, size))
+		return FALSE;
+
+	if ((short) zargs[2] < 0 && dst > src && dst < (long) src + size) {
+		for (i = 0; i < size; i++)
+			zmp[dst + i] = zmp[src + i];
+	} else
+		memmove(zmp + dst, zmp + src, size);
+
+	range_written(dst, size);
+	return TRUE;
+} /* copy_table_fast */
+
 
 /*
  * z_copy_table, copy a table or fill it with zeroes.
@@ -39,6 +88,11 @@ void z_copy_table(void)
 	zbyte value;
 	int i;
 
+	/* Copy or fill the whole table at once if it lies within memory
+	 * and storeb has nothing special to do for its bytes */
+	if (copy_table_fast())
+		return;
+
 	if (zargs[1] == 0)	/* zero table */
 		for (i = 0; i < size; i++)
 			storeb((zword) (zargs[0] + i), 0);
@@ -95,6 +149,50 @@ void z_loadw(void)
 } /* z_loadw */
 
 
+/*
+ * scan_table_fast
+ *
+ * Carry out @scan_table for a byte array with step 1 or a word array
+ * with step 2, using memchr for bytes.  Store the address found (or 0)
+ * in *addr and return true, or return false if the table is of another
+ * kind or doesn't fit within memory.
+ *
+ */
+static bool scan_table_fast(zword *addr)
+{
+	zword table = zargs[1];
+	zword count = zargs[2];
+	zbyte *p;
+	zbyte *end;
+
+	if (zargs[3] == 0x01) {		/* byte array */
+		if (!IN_MEMORY(table, count))
+			return FALSE;
+		p = NULL;
+		if (zargs[0] <= 0xff && count != 0)
+			p = memchr(zmp + table, zargs[0], count);
+		*addr = (p != NULL) ? (zword) (p - zmp) : 0;
+		return TRUE;
+	}
+
+	if (zargs[3] == 0x82) {		/* word array */
+		if (!IN_MEMORY(table, 2L * count))
+			return FALSE;
+		end = zmp + table + 2L * count;
+		for (p = zmp + table; p < end; p += 2) {
+			if (p[0] == hi(zargs[0]) && p[1] == lo(zargs[0])) {
+				*addr = (zword) (p - zmp);
+				return TRUE;
+			}
+		}
+		*addr = 0;
+		return TRUE;
+	}
+
+	return FALSE;
+} /* scan_table_fast */
+
+
 /*
  * z_scan_table, find and store the address of a target within a table.
  *
@@ -116,6 +214,10 @@ void z_scan_table(void)
 	if (zargc < 4)
 		zargs[3] = 0x82;
 
+	/* Search plain byte and word arrays directly in memory */
+	if (scan_table_fast(&addr))
+		goto finished;
+
 	/* Scan byte or word array */
 	for (i = 0; i < zargs[2]; i++) {
 		if (zargs[3] & 0x80) {	/* scan word array */
@@ -145,12 +247,21 @@ finished:
  *	zargs[1] = index of table entry
  *	zargs[2] = value to be written
  *
+ * z_storeb_unchecked is for stores proven to be in dynamic memory.
+ *
  */
 void z_storeb(void)
 {
+	turn_stats.storeb++;
 	storeb((zword) (zargs[0] + zargs[1]), zargs[2]);
 } /* z_storeb */
 
+void z_storeb_unchecked(void)
+{
+	turn_stats.storeb++;
+	storeb_unchecked((zword) (zargs[0] + zargs[1]), zargs[2]);
+} /* z_storeb_unchecked */
+
 
 /*
  * z_storew, write a word into a table of words.
@@ -159,8 +270,17 @@ void z_storeb(void)
  *	zargs[1] = index of table entry
  *	zargs[2] = value to be written
  *
+ * z_storew_unchecked is for stores proven to be in dynamic memory.
+ *
  */
 void z_storew(void)
 {
+	turn_stats.storew++;
 	storew((zword) (zargs[0] + 2 * zargs[1]), zargs[2]);
 } /* z_storew */
+
+void z_storew_unchecked(void)
+{
+	turn_stats.storew++;
+	storew_unchecked((zword) (zargs[0] + 2 * zargs[1]), zargs[2]);
+} /* z_storew_unchecked */
@@ -0,0 +1,360 @@
+/* telemetry.c - Per-turn telemetry
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * A turn runs from the moment input is handed to the story until the
+ * story asks for input again, so time spent waiting for the player is
+ * not part of any turn.  The interpreter keeps count in turn_stats of
+ * what happens during a turn, and at the end of each one, if telemetry
+ * was asked for, a line like this is sent to the sink:
+ *
+ *	turn 12 instructions=10433 wall_us=377 printed=212 storeb=3
+ *	storew=17 undo_bytes=1166 undo_us=9 saves=0 save_bytes=0
+ *
+ * all on one line.  Turn 0 is the start of the game up to the first
+ * input.  The names and their order stay as they are; new values, if
+ * any, will be added at the end.  When the interpreter exits a summary
+ * of the distribution of turn times follows:
+ *
+ *	summary turns=40 wall_us_p50=310 wall_us_p90=802 wall_us_p99=2410
+ *	wall_us_max=2410 instructions_p99=61922
+ *
+ * The sink is named by f_setup.telemetry: "-" for standard error,
+ * "unix:" and a path for a Unix domain socket to connect to, or else a
+ * file to append to.  Saves written on the background thread are
+ * counted in saves but not in save_bytes, as their size is not known
+ * until later.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frotz.h"
+
+#ifndef MSDOS_16BIT
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+typedef struct {
+	const char *prefix;	/* Start of the sink names this kind takes */
+	bool whole;		/* The prefix is the whole name */
+	bool (*open)(const char *);
+	void (*write)(const char *, int);
+} sink_t;
+
+bool telemetry = FALSE;
+turn_stats_t turn_stats;
+
+static const sink_t *sink = NULL;
+static FILE *sink_fp = NULL;
+static int sink_socket = -1;
+
+static bool in_turn = FALSE;
+static long turn = 0;
+static zlong turn_start;
+static zlong turn_instructions;
+
+static zlong *wall_times = NULL;
+static zlong *instructions = NULL;
+static long times_space = 0;
+
+
+/*
+ * telemetry_usec
+ *
+ * Return the time in microseconds from some fixed point.
+ *
+ */
+zlong telemetry_usec(void)
+{
+#ifndef MSDOS_16BIT
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (zlong) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	return (zlong) time(NULL) * 1000000;
+#endif
+} /* telemetry_usec */
+
+
+/*
+ * open_stderr, write_stderr
+ *
+ * The sink "-", standard error.
+ *
+ */
+static bool open_stderr(const char * UNUSED (name))
+{
+	return TRUE;
+} /* open_stderr */
+
+static void write_stderr(const char *line, int length)
+{
+	fwrite(line, 1, length, stderr);
+	fflush(stderr);
+} /* write_stderr */
+
+
+#ifndef MSDOS_16BIT
+/*
+ * open_socket, write_socket
+ *
+ * The sink "unix:<path>", a stream socket some collector listens on.
+ * If the collector goes away, lines are dropped.
+ *
+ */
+static bool open_socket(const char *name)
+{
+	struct sockaddr_un addr;
+
+	name += strlen("unix:");
+	if (strlen(name) >= sizeof(addr.sun_path))
+		return FALSE;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, name);
+
+	if ((sink_socket = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return FALSE;
+	if (connect(sink_socket, (struct sockaddr *) &addr,
+		    sizeof(addr)) < 0) {
+		close(sink_socket);
+		sink_socket = -1;
+		return FALSE;
+	}
+	return TRUE;
+} /* open_socket */
+
+static void write_socket(const char *line, int length)
+{
+	ssize_t n;
+
+	while (sink_socket >= 0 && length > 0) {
+		n = send(sink_socket, line, length, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			close(sink_socket);
+			sink_socket = -1;
+			return;
+		}
+		line += n;
+		length -= n;
+	}
+} /* write_socket */
+#endif
+
+
+/*
+ * open_file, write_file
+ *
+ * Any other sink name is a file, which lines are added to.
+ *
+ */
+static bool open_file(const char *name)
+{
+	return (sink_fp = fopen(name, "a")) != NULL;
+} /* open_file */
+
+static void write_file(const char *line, int length)
+{
+	fwrite(line, 1, length, sink_fp);
+	fflush(sink_fp);
+} /* write_file */
+
+
+/* Tried in order; the first whose prefix matches is used */
+static const sink_t sinks[] = {
+	{ "-", TRUE, open_stderr, write_stderr },
+#ifndef MSDOS_16BIT
+	{ "unix:", FALSE, open_socket, write_socket },
+#endif
+	{ "", FALSE, open_file, write_file }
+};
+
+
+/*
+ * send_line
+ *
+ * Format a line and send it to the sink.
+ *
+ */
+static void send_line(const char *format, ...)
+{
+	char line[512];
+	va_list args;
+	int length;
+
+	va_start(args, format);
+	length = vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	if (length >= (int) sizeof(line))
+		length = sizeof(line) - 1;
+	if (length > 0)
+		sink->write(line, length);
+} /* send_line */
+
+
+/*
+ * compare_zlongs
+ *
+ * Order numbers from small to large.
+ *
+ */
+static int compare_zlongs(const void *a, const void *b)
+{
+	zlong x = *(const zlong *) a;
+	zlong y = *(const zlong *) b;
+
+	return (x > y) - (x < y);
+} /* compare_zlongs */
+
+
+/*
+ * percentile
+ *
+ * Return the p-th percentile of count sorted numbers, by the nearest
+ * rank.
+ *
+ */
+static zlong percentile(const zlong *sorted, long count, int p)
+{
+	long rank = (count * p + 99) / 100;
+
+	return sorted[rank > 0 ? rank - 1 : 0];
+} /* percentile */
+
+
+/*
+ * telemetry_close
+ *
+ * Called at exit to end the last turn and send the summary.
+ *
+ */
+static void telemetry_close(void)
+{
+	if (in_turn)
+		telemetry_input();
+	if (turn == 0)
+		return;
+
+	qsort(wall_times, turn, sizeof(zlong), compare_zlongs);
+	qsort(instructions, turn, sizeof(zlong), compare_zlongs);
+	send_line("summary turns=%ld wall_us_p50=%lu wall_us_p90=%lu "
+		  "wall_us_p99=%lu wall_us_max=%lu instructions_p99=%lu\n",
+		  turn, percentile(wall_times, turn, 50),
+		  percentile(wall_times, turn, 90),
+		  percentile(wall_times, turn, 99), wall_times[turn - 1],
+		  percentile(instructions, turn, 99));
+} /* telemetry_close */
+
+
+/*
+ * telemetry_open
+ *
+ * Open the sink, if telemetry was asked for, and start turn 0.
+ *
+ */
+void telemetry_open(void)
+{
+	int i;
+
+	if (f_setup.telemetry == NULL || telemetry)
+		return;
+
+	for (i = 0; sink == NULL; i++) {
+		if (sinks[i].whole ?
+		    strcmp(f_setup.telemetry, sinks[i].prefix) == 0 :
+		    strncmp(f_setup.telemetry, sinks[i].prefix,
+			    strlen(sinks[i].prefix)) == 0)
+			sink = &sinks[i];
+	}
+	if (!sink->open(f_setup.telemetry))
+		os_fatal("Can't open the telemetry sink (-E).");
+
+	telemetry = TRUE;
+	atexit(telemetry_close);
+	telemetry_resume();
+} /* telemetry_open */
+
+
+/*
+ * telemetry_input
+ *
+ * The story asks for input: end the turn and report it.
+ *
+ */
+void telemetry_input(void)
+{
+	zlong wall;
+
+	if (!in_turn)
+		return;
+	in_turn = FALSE;
+
+	wall = telemetry_usec() - turn_start;
+	turn_instructions = instruction_count - turn_instructions;
+
+	if (turn == times_space) {
+		times_space = times_space ? 2 * times_space : 1024;
+		wall_times = realloc(wall_times, times_space * sizeof(zlong));
+		instructions = realloc(instructions,
+				       times_space * sizeof(zlong));
+		if (wall_times == NULL || instructions == NULL)
+			os_fatal("Out of memory");
+	}
+	wall_times[turn] = wall;
+	instructions[turn] = turn_instructions;
+
+	send_line("turn %ld instructions=%lu wall_us=%lu printed=%lu "
+		  "storeb=%lu storew=%lu undo_bytes=%lu undo_us=%lu "
+		  "saves=%lu save_bytes=%lu\n", turn, turn_instructions,
+		  wall, turn_stats.printed, turn_stats.storeb,
+		  turn_stats.storew, turn_stats.undo_bytes,
+		  turn_stats.undo_usec, turn_stats.saves,
+		  turn_stats.save_bytes);
+	turn++;
+} /* telemetry_input */
+
+
+/*
+ * telemetry_resume
+ *
+ * Input has been handed to the story: start a new turn.
+ *
+ */
+void telemetry_resume(void)
+{
+	if (in_turn)
+		return;
+	in_turn = TRUE;
+	memset(&turn_stats, 0, sizeof(turn_stats));
+	turn_instructions = instruction_count;
+	turn_start = telemetry_usec();
+} /* telemetry_resume */
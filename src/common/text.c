@@ -30,6 +30,9 @@ extern zword get_window_font(zword);
 static zchar decoded[10];
 static zword encoded[3];
 
+/* Words read for the string being decoded, with its abbreviations */
+static long string_words;
+
 /*
  * According to Matteo De Luigi <matteo.de.luigi@libero.it>,
  * 0xab and 0xbb were in each other's proper positions.
@@ -377,7 +380,9 @@ void z_encode_text(void)
  * The last type is only used for word completion.
  *
  */
-#define outchar(c)	if (st==VOCABULARY) *ptr++=c; else print_char(c)
+/* A dictionary word is at most 9 characters, if the story is sound */
+#define outchar(c)	if (st==VOCABULARY) { if (ptr < decoded + 9) *ptr++=c; } \
+			else print_char(c)
 static void decode_text(enum string_type st, zword addr)
 {
 	zchar *ptr;
@@ -392,6 +397,9 @@ static void decode_text(enum string_type st, zword addr)
 	ptr = NULL;		/* makes compilers shut up */
 	byte_addr = 0;
 
+	if (st != ABBREVIATION)
+		string_words = 0;
+
 	/* Calculate the byte address if necessary */
 	if (st == ABBREVIATION)
 		byte_addr = (long)addr << 1;
@@ -413,22 +421,54 @@ static void decode_text(enum string_type st, zword addr)
 
 	}
 
+	/* Note where the string starts in the coverage map */
+	if (coverage && st != VOCABULARY) {
+		long start;
+
+		if (st == LOW_STRING)
+			start = addr;
+		else if (st == EMBEDDED_STRING)
+			GET_PC(start)
+		else
+			start = byte_addr;
+		if (start < story_size)
+			COVER_MARK(cover_text, start)
+	}
+
 	/* Loop until a 16bit word has the highest bit set */
 	if (st == VOCABULARY)
 		ptr = decoded;
 
 	do {
 		int i;
+		long pc;
 
-		/* Fetch the next 16bit word */
+		/* Fetch the next 16bit word.  A broken story's string may
+		 * have no end, and go round the lower 64KB or off the end of
+		 * memory, or be made of long abbreviations, so no string is
+		 * let run to more than 32K words, far beyond any real one. */
+		if (++string_words > 0x8000) {
+			runtime_error(ERR_ILL_PRINT_ADDR);
+			break;
+		}
 		if (st == LOW_STRING || st == VOCABULARY) {
 			LOW_WORD(addr, code)
 			addr += 2;
 		} else if (st == HIGH_STRING || st == ABBREVIATION) {
+			if (byte_addr + 1 >= story_size) {
+				runtime_error(ERR_ILL_PRINT_ADDR);
+				break;
+			}
 			HIGH_WORD(byte_addr, code)
 			byte_addr += 2;
-		} else
+		} else {
+			GET_PC(pc)
+			if (pc + 1 >= story_size) {
+				runtime_error(ERR_ILL_PRINT_ADDR);
+				break;
+			}
 			CODE_WORD(code)
+		}
 			/* Read its three Z-characters */
 		for (i = 10; i >= 0; i -= 5) {
 			zword abbr_addr;
@@ -466,6 +506,13 @@ static void decode_text(enum string_type st, zword addr)
 				shift_state = shift_lock;
 				break;
 			case 1:	/* abbreviation */
+				/* One may not use another, and a broken
+				 * story's may use itself for ever */
+				if (st == ABBREVIATION) {
+					runtime_error(ERR_ILL_PRINT_ADDR);
+					status = 0;
+					break;
+				}
 				ptr_addr =
 				    z_header.abbreviations + 64 * (prev_c -
 						    1) + 2 * c;
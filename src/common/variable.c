@@ -31,9 +31,10 @@ void z_dec(void)
 {
 	zword value;
 
-	if (zargs[0] == 0)
+	if (zargs[0] == 0) {
+		CHECK_POP(1)
 		(*sp)--;
-	else if (zargs[0] < 16)
+	} else if (zargs[0] < 16)
 		(*(fp - zargs[0]))--;
 	else {
 		zword addr = z_header.globals + 2 * (zargs[0] - 16);
@@ -55,9 +56,10 @@ void z_dec_chk(void)
 {
 	zword value;
 
-	if (zargs[0] == 0)
+	if (zargs[0] == 0) {
+		CHECK_POP(1)
 		value = --(*sp);
-	else if (zargs[0] < 16)
+	} else if (zargs[0] < 16)
 		value = --(*(fp - zargs[0]));
 	else {
 		zword addr = z_header.globals + 2 * (zargs[0] - 16);
@@ -79,9 +81,10 @@ void z_inc(void)
 {
 	zword value;
 
-	if (zargs[0] == 0)
+	if (zargs[0] == 0) {
+		CHECK_POP(1)
 		(*sp)++;
-	else if (zargs[0] < 16)
+	} else if (zargs[0] < 16)
 		(*(fp - zargs[0]))++;
 	else {
 		zword addr = z_header.globals + 2 * (zargs[0] - 16);
@@ -104,9 +107,10 @@ void z_inc_chk(void)
 {
 	zword value;
 
-	if (zargs[0] == 0)
+	if (zargs[0] == 0) {
+		CHECK_POP(1)
 		value = ++(*sp);
-	else if (zargs[0] < 16)
+	} else if (zargs[0] < 16)
 		value = ++(*(fp - zargs[0]));
 	else {
 		zword addr = z_header.globals + 2 * (zargs[0] - 16);
@@ -128,9 +132,10 @@ void z_load(void)
 {
 	zword value;
 
-	if (zargs[0] == 0)
+	if (zargs[0] == 0) {
+		CHECK_POP(1)
 		value = *sp;
-	else if (zargs[0] < 16)
+	} else if (zargs[0] < 16)
 		value = *(fp - zargs[0]);
 	else {
 		zword addr = z_header.globals + 2 * (zargs[0] - 16);
@@ -148,6 +153,7 @@ void z_load(void)
  */
 void z_pop(void)
 {
+	CHECK_POP(1)
 	sp++;
 } /* z_pop */
 
@@ -169,8 +175,10 @@ void z_pop_stack(void)
 		LOW_WORD(addr, size)
 		size += zargs[0];
 		storew(addr, size);
-	} else
+	} else {
+		CHECK_POP(zargs[0])
 		sp += zargs[0];	/* it's the game stack */
+	}
 } /* z_pop_stack */
 
 
@@ -191,6 +199,7 @@ void z_pull(void)
 	zword value;
 
 	if (z_header.version != V6) {	/* not a V6 game, pop stack and write */
+		CHECK_POP(zargs[0] == 0 ? 2 : 1)
 		value = *sp++;
 		if (zargs[0] == 0)
 			*sp = value;
@@ -211,8 +220,10 @@ void z_pull(void)
 
 			addr += 2 * size;
 			LOW_WORD(addr, value)
-		} else
+		} else {
+			CHECK_POP(1)
 			value = *sp++;	/* it's the game stack */
+		}
 		store(value);
 	}
 } /* z_pull */
@@ -226,6 +237,7 @@ void z_pull(void)
  */
 void z_push(void)
 {
+	CHECK_PUSH
 	*--sp = zargs[0];
 } /* z_push */
 
@@ -263,9 +275,10 @@ void z_store(void)
 {
 	zword value = zargs[1];
 
-	if (zargs[0] == 0)
+	if (zargs[0] == 0) {
+		CHECK_POP(1)
 		*sp = value;
-	else if (zargs[0] < 16)
+	} else if (zargs[0] < 16)
 		*(fp - zargs[0]) = value;
 	else {
 		zword addr = z_header.globals + 2 * (zargs[0] - 16);
@@ -163,6 +163,7 @@ void os_fatal (const char *s, ...)
 		} else {
 			os_reset_screen();
 			ux_blorb_stop();
+			flight_dump(s);
 			os_quit(EXIT_FAILURE);
 		}
 	}
@@ -176,6 +177,7 @@ void os_fatal (const char *s, ...)
 
 	fputs ("\n\n", stderr);
 
+	flight_dump(s);
 	os_quit (EXIT_FAILURE);
 } /* os_fatal */
 
@@ -309,6 +309,7 @@ static int unix_read_char(int extkeys)
 			case 'x': return ZC_HKEY_QUIT;
 			case 'd': return ZC_HKEY_DEBUG;
 			case 'h': return ZC_HKEY_HELP;
+			case 'o': return ZC_HKEY_OPCODES;
 			case 'f': return ZC_WORD_RIGHT;
 			case 'b': return ZC_WORD_LEFT;
 			default: continue;	/* Ignore unknown combinations. */
@@ -352,6 +353,7 @@ static int unix_read_char(int extkeys)
 		case MOD_META | 'x': return ZC_HKEY_QUIT;
 		case MOD_META | 'd': return ZC_HKEY_DEBUG;
 		case MOD_META | 'h': return ZC_HKEY_HELP;
+		case MOD_META | 'o': return ZC_HKEY_OPCODES;
 		case MOD_META | 'f': return ZC_WORD_RIGHT;
 		case MOD_META | 'b': return ZC_WORD_LEFT;
 
@@ -636,6 +638,7 @@ static void utf8_mvaddstr(int y, int x, zchar * buf)
  *     ZC_HKEY_QUIT (Alt-X, "exit game")
  *     ZC_HKEY_DEBUGGING (Alt-D)
  *     ZC_HKEY_HELP (Alt-H)
+ *     ZC_HKEY_OPCODES (Alt-O)
  *
  * If the timeout argument is not zero, the input gets interrupted
  * after timeout/10 seconds (and the return value is ZC_TIME_OUT).
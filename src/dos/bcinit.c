@@ -274,6 +274,9 @@ void os_fatal(const char *s, ...)
 	fputs(s, stderr);
 	fputs("\n", stderr);
 
+	/* Write out what led up to it */
+	flight_dump(s);
+
 	/* Abort program */
 	exit(EXIT_FAILURE);
 } /* os_fatal */
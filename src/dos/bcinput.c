@@ -210,7 +210,7 @@ static int get_key(bool cursor)
 	static byte special_key_map[] = {0x47, 0x4f, 0x73, 0x74, 0x53,
 					0x52, 0x49, 0x51, 0x0f};
 	static byte hot_key_map[] = {0x13, 0x19, 0x1f, 0x16,
-				     0x31, 0x2d, 0x20, 0x23};
+				     0x31, 0x2d, 0x20, 0x23, 0x18};
 	static byte function_key_map[] = {0x3B, 0x3C, 0x3D, 0x3E, 0x3F, 0x40,
 	                                  0x41, 0x42, 0x43, 0x44, 0x85, 0x86};
 
@@ -698,6 +698,7 @@ no_further:
  *     ZC_HKEY_QUIT (Alt-X, "exit game")
  *     ZC_HKEY_DEBUGGING (Alt-D)
  *     ZC_HKEY_HELP (Alt-H)
+ *     ZC_HKEY_OPCODES (Alt-O)
  *
  * If the timeout argument is not zero, the input gets interrupted
  * after timeout/10 seconds (and the return value is 0).
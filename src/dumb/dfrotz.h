@@ -33,9 +33,11 @@ bool is_terminator (zchar);
 /* dumb-input.c */
 bool dumb_handle_setting(const char *setting, bool show_cursor, bool startup);
 void dumb_init_input(void);
+void dumb_reset_input(void);
 
 /* dumb-output.c */
 void dumb_init_output(void);
+void dumb_reset_screen(void);
 bool dumb_output_handle_setting(const char *setting, bool show_cursor,
 				bool startup);
 void dumb_show_screen(bool show_cursor);
@@ -49,4 +51,22 @@ void dumb_set_picture_cell(int row, int col, zchar c);
 /* dumb-pic.c */
 bool dumb_init_pictures(void);
 
+/* dserve.c */
+void dumb_serve(void);
+bool dumb_serving(void);
+void dumb_end_request(bool ok);
+void dumb_collapse(void);
+
+/* dfuzz.c */
+#define FUZZ_DONE	1	/* How a fuzzing run ended: the input ran out, */
+#define FUZZ_QUIT	2	/* the story quit, */
+#define FUZZ_FATAL	3	/* a fatal error, */
+#define FUZZ_HANG	4	/* or it ran for too long */
+extern zlong dumb_fuzz_stop;
+extern zlong dumb_fuzz_print;
+void dumb_fuzz(void);
+bool dumb_fuzzing(void);
+void dumb_fuzz_end(int outcome);
+int dumb_fuzz_getchar(void);
+
 #endif
@@ -0,0 +1,944 @@
+/*
+ * dfuzz.c - Dumb interface, coverage-guided fuzzer
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * crashme.z5 in src/test tries the interpreter on random code, but each
+ * try costs a process.  With -z the process stays up and runs the story
+ * over and over, each time from a fresh start made in memory: dynamic
+ * memory is copied back from the copy kept by fastmem.c, the stack is
+ * cleared, streams, screen and undo are reset, and the rest of the story is
+ * copied back from one kept here.  That undoes the last run's patches
+ * and whatever a broken story wrote where it should not have, which
+ * the interpreter does not always stop.  Nothing is loaded or exec'd
+ * again, so a short run costs little more than its instructions.
+ *
+ * A test case is the keyboard input for a run, which may be followed by
+ * a zero byte and patches to the story, four bytes each: an address,
+ * three bytes big-endian and taken modulo the size of the story, and
+ * the byte to put there.  The header is never patched.  Any file is a
+ * test case, so the command files in src/test/input make good seeds.
+ * Backslashes in the input are read as slashes, so that it cannot reach
+ * dfrotz's own commands and hotkeys, and every file name the story asks
+ * for is refused.  The random seed is 1 unless -s gives another.
+ *
+ * A run ends when the input does, when the story quits, at a fatal
+ * error, after FUZZ_STEPS instructions, unless -j gives another number,
+ * or when it has printed FUZZ_PRINT characters for each of those, as
+ * one instruction can print a great deal; none of these is a failure.
+ * A crash of the interpreter is, and so is a run that takes more than
+ * FUZZ_TIMEOUT seconds, which means some instruction is all but endless.
+ *
+ * -z names a directory holding the corpus.  Everything in it is run
+ * first.  Then test cases are picked from the corpus at random, changed
+ * and run, and any that reaches something no run before it has is added
+ * to the corpus, in memory and as a file named after a hash of it.
+ * What a run reaches is read from two maps: the Z-code instructions it
+ * ran, from cover.c, which adds them to the -X file if there is one;
+ * and, in the build made by "make zfuzz", the edges between blocks of
+ * the interpreter's own C code, which the compiler reports through
+ * __sanitizer_cov_trace_pc().  Edges are counted per run and the counts
+ * put in buckets as AFL does, so a loop going round more often is news.
+ *
+ * A test case is changed a few times over by flipping, changing,
+ * adding or taking out bytes, putting in a word from the story's
+ * dictionary or a piece of another test case, or adding a patch, most
+ * often on or just after an instruction some run has reached.
+ *
+ * If the interpreter crashes, the test case is written to crash-<hash>
+ * in the current directory before the flight recorder (flight.c) makes
+ * its report, if -Q was given; one that times out is written to
+ * timeout-<hash>.  Given
+ * a file rather than a directory, -z runs just that test case with its
+ * output shown, to see what it does.  Progress goes to standard error;
+ * everything the story prints goes nowhere.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "dfrotz.h"
+
+extern void interpret(void);
+extern void memory_close(void);
+
+#ifndef FUZZ_STEPS
+#define FUZZ_STEPS	100000	/* Instructions in a run */
+#endif
+#ifndef FUZZ_TIMEOUT
+#define FUZZ_TIMEOUT	10	/* Seconds a run may take */
+#endif
+#define FUZZ_PRINT	10	/* Characters a run may print per instruction */
+#define FUZZ_MAX_SIZE	4096	/* Largest test case made by a change */
+#define FUZZ_EDGES	65536	/* Must be a power of two */
+#define FUZZ_CHANGES	4	/* Most changes made at a time */
+
+typedef struct {
+	zbyte *data;
+	long size;
+} testcase_t;
+
+static const char *outcome_names[] = {
+	"", "ran out of input", "quit", "had a fatal error", "ran too long"
+};
+
+zlong dumb_fuzz_stop = 0;
+zlong dumb_fuzz_print = 0;
+
+static bool fuzzing = FALSE;
+static bool running = FALSE;
+static jmp_buf run_done;
+static volatile sig_atomic_t stopping = 0;
+static unsigned run_timeout = 0;
+static FILE *report = NULL;
+static zlong seed;
+
+static testcase_t *corpus = NULL;
+static long corpus_size = 0;
+static long corpus_space = 0;
+
+/* The test case being run */
+static const zbyte *current;
+static long current_size;
+static long input_size;
+static long input_pos;
+
+/* The story from the end of dynamic memory on, as it was loaded */
+static zbyte *story_static = NULL;
+static long static_start;
+
+/* What has been reached */
+static zbyte edge_hits[FUZZ_EDGES];
+static zbyte edge_seen[FUZZ_EDGES];
+static unsigned long last_edge;
+static zbyte *code_seen;
+static long code_map_size;
+static long edge_count = 0;
+static long code_count = 0;
+static zlong outcomes[5];
+
+/* Words from the dictionary, at most nine letters each */
+static char (*words)[10] = NULL;
+static long word_count = 0;
+
+static void (*old_handlers[MAX_CRASH_SIGNALS])(int);
+
+
+/*
+ * __sanitizer_cov_trace_pc
+ *
+ * Called by the compiler at every edge of code built with
+ * -fsanitize-coverage=trace-pc.  The edge is named by hashing where it
+ * was called from together with the edge before, as AFL does.  This
+ * file is never built that way, or this would call itself.
+ *
+ */
+void __sanitizer_cov_trace_pc(void)
+{
+	unsigned long here = (unsigned long) __builtin_return_address(0);
+	zbyte *hits;
+
+	here = ((here * 2654435761UL) >> 12) & (FUZZ_EDGES - 1);
+	hits = &edge_hits[here ^ last_edge];
+	if (*hits != 0xff)
+		(*hits)++;
+	last_edge = here >> 1;
+} /* __sanitizer_cov_trace_pc */
+
+
+/*
+ * next_random
+ *
+ * Return the next number from the fuzzer's own generator.
+ *
+ */
+static zlong next_random(void)
+{
+	return xorshift(&seed);
+} /* next_random */
+
+
+/*
+ * hash_testcase
+ *
+ * Return a hash of a test case, to name its file.
+ *
+ */
+static zlong hash_testcase(const zbyte *data, long size)
+{
+	return hash_bytes(HASH_START, data, size);
+} /* hash_testcase */
+
+
+/*
+ * dumb_fuzz_end
+ *
+ * End the run going on, if there is one, in the given way.  Does not
+ * return while a run is going on.
+ *
+ */
+void dumb_fuzz_end(int outcome)
+{
+	if (!running)
+		return;
+	longjmp(run_done, outcome);
+} /* dumb_fuzz_end */
+
+
+/*
+ * dumb_fuzz_getchar
+ *
+ * Return the next character of the run's input, ending the run when
+ * there is no more.
+ *
+ */
+int dumb_fuzz_getchar(void)
+{
+	int c;
+
+	if (input_pos >= input_size) {
+		dumb_fuzz_end(FUZZ_DONE);
+		return '\n';
+	}
+	c = current[input_pos++];
+	return c == '\\' ? '/' : c;
+} /* dumb_fuzz_getchar */
+
+
+/*
+ * apply_patches
+ *
+ * Patch the story as the test case asks.
+ *
+ */
+static void apply_patches(void)
+{
+	const zbyte *p;
+	long addr;
+	bool patched = FALSE;
+
+	for (p = current + input_size + 1; p + 4 <= current + current_size;
+	     p += 4) {
+		addr = ((long) p[0] << 16 | (long) p[1] << 8 | p[2]) %
+			story_size;
+		if (addr < 64)
+			continue;
+		zmp[addr] = p[3];
+		patched = TRUE;
+	}
+	if (patched) {
+		reset_property_index();
+		reset_object_tree();
+	}
+} /* apply_patches */
+
+
+/*
+ * run
+ *
+ * Start the Z-machine afresh and run one test case.  Return how the
+ * run ended.
+ *
+ */
+static int run(const zbyte *data, long size)
+{
+	static int outcome;
+	const zbyte *end;
+
+	current = data;
+	current_size = size;
+	end = memchr(data, 0, size);
+	input_size = end != NULL ? end - data : size;
+	input_pos = 0;
+
+	if ((outcome = setjmp(run_done)) == 0) {
+		memcpy(zmp + static_start, story_static,
+		       story_size - static_start);
+		/* A broken story may read words it never put on the stack */
+		memset(stack, 0, sizeof(stack));
+		init_buffer();
+		init_err();
+		init_process();
+		dumb_reset_input();
+		dumb_reset_screen();
+		ostream_screen = TRUE;
+		while (ostream_memory)
+			memory_close();
+		z_restart();
+		clear_undo();
+		apply_patches();
+
+		running = TRUE;
+		dumb_fuzz_stop = instruction_count + f_setup.fuzz_steps;
+		dumb_fuzz_print = FUZZ_PRINT * f_setup.fuzz_steps;
+		alarm(run_timeout);
+		interpret();
+		outcome = FUZZ_QUIT;
+	}
+	alarm(0);
+	running = FALSE;
+	dumb_fuzz_stop = 0;
+	dumb_fuzz_print = 0;
+	return outcome;
+} /* run */
+
+
+/*
+ * bucket
+ *
+ * Put the number of times an edge was taken in a run in one of eight
+ * buckets, as a bit: 1, 2, 3, 4-7, 8-15, 16-31, 32-127 or 128 and up.
+ *
+ */
+static zbyte bucket(zbyte hits)
+{
+	if (hits <= 2)
+		return hits;
+	if (hits == 3)
+		return 4;
+	if (hits <= 7)
+		return 8;
+	if (hits <= 15)
+		return 16;
+	if (hits <= 31)
+		return 32;
+	if (hits <= 127)
+		return 64;
+	return 128;
+} /* bucket */
+
+
+/*
+ * new_coverage
+ *
+ * Return how many things the last run reached that no run before it
+ * had, and clear the counts of edges for the next.
+ *
+ */
+static long new_coverage(void)
+{
+	long found = 0;
+	long i;
+	zbyte b;
+
+	for (i = 0; i < FUZZ_EDGES; i++) {
+		if (edge_hits[i] == 0)
+			continue;
+		b = bucket(edge_hits[i]);
+		if (!(edge_seen[i] & b)) {
+			if (edge_seen[i] == 0)
+				edge_count++;
+			edge_seen[i] |= b;
+			found++;
+		}
+	}
+	memset(edge_hits, 0, sizeof(edge_hits));
+	last_edge = 0;
+
+	for (i = 0; i < code_map_size; i++) {
+		b = cover_code[i] & ~code_seen[i];
+		if (b == 0)
+			continue;
+		code_seen[i] |= b;
+		for (; b != 0; b &= b - 1) {
+			code_count++;
+			found++;
+		}
+	}
+	return found;
+} /* new_coverage */
+
+
+/*
+ * reached_address
+ *
+ * Return the address of an instruction some run has reached, or one
+ * of the three bytes after it, or any address if none has been.
+ *
+ */
+static long reached_address(void)
+{
+	long start = next_random() % code_map_size;
+	long i = start;
+	int bit;
+
+	do {
+		if (code_seen[i] != 0) {
+			do
+				bit = next_random() & 7;
+			while (!(code_seen[i] & (1 << bit)));
+			return (i * 8 + bit + next_random() % 4) % story_size;
+		}
+		i = (i + 1) % code_map_size;
+	} while (i != start);
+	return next_random() % story_size;
+} /* reached_address */
+
+
+/*
+ * insert_bytes
+ *
+ * Make room for and copy in bytes at pos of a test case in buf,
+ * keeping it within FUZZ_MAX_SIZE.  Return the new size.
+ *
+ */
+static long insert_bytes(zbyte *buf, long size, long pos,
+			 const void *bytes, long length)
+{
+	if (size + length > FUZZ_MAX_SIZE)
+		length = FUZZ_MAX_SIZE - size;
+	if (length <= 0)
+		return size;
+	memmove(buf + pos + length, buf + pos, size - pos);
+	memcpy(buf + pos, bytes, length);
+	return size + length;
+} /* insert_bytes */
+
+
+/*
+ * change
+ *
+ * Make one random change to the test case in buf.  Return its new
+ * size.
+ *
+ */
+static long change(zbyte *buf, long size)
+{
+	static const char typed[] = "abcdefghijklmnopqrstuvwxyz ,.\n";
+	const testcase_t *other;
+	zbyte *end = memchr(buf, 0, size);
+	long input = end != NULL ? end - buf : size;
+	long pos, length, addr;
+	zbyte bytes[4];
+
+	switch (next_random() % 8) {
+	case 0:		/* Flip a bit */
+		if (size > 0)
+			buf[next_random() % size] ^= 1 << (next_random() & 7);
+		break;
+	case 1:		/* Change a byte */
+		if (size > 0)
+			buf[next_random() % size] = (zbyte) next_random();
+		break;
+	case 2:		/* Type a character */
+		bytes[0] = typed[next_random() % (sizeof(typed) - 1)];
+		size = insert_bytes(buf, size, next_random() % (input + 1),
+				    bytes, 1);
+		break;
+	case 3:		/* Take out some bytes */
+		if (size > 0) {
+			pos = next_random() % size;
+			length = 1 + next_random() % 8;
+			if (length > size - pos)
+				length = size - pos;
+			memmove(buf + pos, buf + pos + length,
+				size - pos - length);
+			size -= length;
+		}
+		break;
+	case 4:		/* Type a word from the dictionary */
+		if (word_count > 0) {
+			const char *word = words[next_random() % word_count];
+			pos = next_random() % (input + 1);
+			bytes[0] = (next_random() & 1) ? ' ' : '\n';
+			size = insert_bytes(buf, size, pos, bytes, 1);
+			size = insert_bytes(buf, size, pos, word,
+					    strlen(word));
+		}
+		break;
+	case 5:		/* Copy in a piece of another test case */
+		other = &corpus[next_random() % corpus_size];
+		if (other->size > 0) {
+			pos = next_random() % other->size;
+			length = 1 + next_random() % 32;
+			if (length > other->size - pos)
+				length = other->size - pos;
+			size = insert_bytes(buf, size,
+					    next_random() % (size + 1),
+					    other->data + pos, length);
+		}
+		break;
+	default:	/* Patch the story */
+		if (end == NULL) {
+			bytes[0] = 0;
+			size = insert_bytes(buf, size, size, bytes, 1);
+		}
+		addr = reached_address();
+		bytes[0] = (addr >> 16) & 0xff;
+		bytes[1] = (addr >> 8) & 0xff;
+		bytes[2] = addr & 0xff;
+		bytes[3] = (zbyte) next_random();
+		if (size + 4 <= FUZZ_MAX_SIZE)
+			size = insert_bytes(buf, size, size, bytes, 4);
+		break;
+	}
+	return size;
+} /* change */
+
+
+/*
+ * write_testcase
+ *
+ * Write a test case to a file named after its hash, with prefix in
+ * front.  Return FALSE if it could not be written.  This is called from
+ * the crash handler, perhaps with the heap in ruins, so it neither
+ * allocates memory nor uses stdio.
+ *
+ */
+static bool write_testcase(const char *prefix, const zbyte *data,
+			   long size)
+{
+	char name[FILENAME_MAX];
+	int fd;
+	bool ok;
+
+	snprintf(name, sizeof(name), "%s%08lx", prefix,
+		 hash_testcase(data, size));
+	if ((fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+		return FALSE;
+	ok = write(fd, data, size) == size;
+	ok = close(fd) == 0 && ok;
+	return ok;
+} /* write_testcase */
+
+
+/*
+ * add_testcase
+ *
+ * Add a copy of a test case to the corpus in memory.
+ *
+ */
+static void add_testcase(const zbyte *data, long size)
+{
+	testcase_t *t;
+
+	if (corpus_size == corpus_space) {
+		corpus_space = corpus_space ? 2 * corpus_space : 64;
+		corpus = realloc(corpus, corpus_space * sizeof(testcase_t));
+		if (corpus == NULL)
+			os_fatal("Out of memory");
+	}
+	t = &corpus[corpus_size++];
+	if ((t->data = malloc(size + 1)) == NULL)
+		os_fatal("Out of memory");
+	memcpy(t->data, data, size);
+	t->size = size;
+} /* add_testcase */
+
+
+/*
+ * read_testcase
+ *
+ * Read up to FUZZ_MAX_SIZE bytes of a file into buf.  Return the
+ * number read, or -1 if the file could not be read.
+ *
+ */
+static long read_testcase(const char *name, zbyte *buf)
+{
+	FILE *in;
+	long size;
+
+	if ((in = fopen(name, "rb")) == NULL)
+		return -1;
+	size = fread(buf, 1, FUZZ_MAX_SIZE, in);
+	fclose(in);
+	return size;
+} /* read_testcase */
+
+
+/*
+ * crash_handler
+ *
+ * Keep the test case that crashed the interpreter, then let the flight
+ * recorder report the crash if asked to (-Q).
+ *
+ */
+static void crash_handler(int sig)
+{
+	char name[32];
+	int i;
+
+	for (i = 0; i < crash_signal_count; i++)
+		if (crash_signals[i] == sig)
+			signal(sig, old_handlers[i]);
+
+	sprintf(name, "crash-%08lx", hash_testcase(current, current_size));
+	if (running && write_testcase("crash-", current, current_size))
+		fprintf(report, "==%ld== signal %d: the test case is in %s\n",
+			(long) getpid(), sig, name);
+	fflush(report);
+	raise(sig);
+} /* crash_handler */
+
+
+/*
+ * timeout_handler
+ *
+ * A run that takes too long inside one instruction, such as printing
+ * a table of 65535 by 65535 characters, never gets back to os_tick()
+ * to be cut short.  Like a crash, it is kept and ends the fuzzing.
+ *
+ */
+static void timeout_handler(int UNUSED (sig))
+{
+	char name[32];
+
+	if (!running)
+		return;
+	sprintf(name, "timeout-%08lx", hash_testcase(current, current_size));
+	if (write_testcase("timeout-", current, current_size))
+		fprintf(report, "==%ld== a run took over %d seconds: the test "
+			"case is in %s\n", (long) getpid(), FUZZ_TIMEOUT, name);
+	fflush(report);
+	_exit(EXIT_FAILURE);
+} /* timeout_handler */
+
+
+/*
+ * stop_handler
+ *
+ * Stop fuzzing after the run going on.
+ *
+ */
+static void stop_handler(int UNUSED (sig))
+{
+	stopping = 1;
+} /* stop_handler */
+
+
+/*
+ * letter
+ *
+ * Return the character a Z-character stands for in one of the three
+ * alphabets.  Only V5 and later stories may have alphabets of their
+ * own; the ones here are those of V2 and later.
+ *
+ */
+static char letter(int set, int c)
+{
+	static const char *alphabets[] = {
+		"abcdefghijklmnopqrstuvwxyz",
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZ",
+		"  0123456789.,!?_#'\"/\\-:()"
+	};
+
+	if (z_header.version >= V5 && z_header.alphabet != 0)
+		return zmp[z_header.alphabet + 26 * set + c - 6];
+	return alphabets[set][c - 6];
+} /* letter */
+
+
+/*
+ * decode_word
+ *
+ * Decode a dictionary entry of the given number of bytes into out.
+ * Return FALSE if it holds anything but printable ASCII.
+ *
+ */
+static bool decode_word(long addr, int bytes, char *out)
+{
+	zbyte zchars[9];
+	int n = 0;
+	int set = 0;
+	int c, i;
+
+	for (i = 0; i < bytes; i += 2) {
+		zword w = zmp[addr + i] << 8 | zmp[addr + i + 1];
+		zchars[n++] = (w >> 10) & 0x1f;
+		zchars[n++] = (w >> 5) & 0x1f;
+		zchars[n++] = w & 0x1f;
+	}
+
+	for (i = 0; i < n; i++) {
+		c = zchars[i];
+		if (c == 4 || c == 5) {
+			set = c - 3;
+			continue;
+		}
+		if (c == 0)
+			c = ' ';
+		else if (c < 4)
+			return FALSE;
+		else if (set == 2 && c == 6 && i + 2 < n) {
+			c = zchars[i + 1] << 5 | zchars[i + 2];
+			i += 2;
+		} else if (set == 2 && c == 7)
+			return FALSE;
+		else
+			c = letter(set, c);
+		if (c < 32 || c > 126)
+			return FALSE;
+		*out++ = c;
+		set = 0;
+	}
+	*out = '\0';
+	return TRUE;
+} /* decode_word */
+
+
+/*
+ * read_words
+ *
+ * Decode the words of the story's dictionary, to be typed.
+ *
+ */
+static void read_words(void)
+{
+	long addr = z_header.dictionary;
+	int bytes = z_header.version <= V3 ? 4 : 6;
+	int entry_length;
+	long count, i;
+
+	if (addr == 0 || addr + zmp[addr] + 4 > story_size)
+		return;
+	addr += zmp[addr] + 1;
+	entry_length = zmp[addr];
+	count = (short) (zmp[addr + 1] << 8 | zmp[addr + 2]);
+	if (count < 0)
+		count = -count;
+	addr += 3;
+	if (entry_length < bytes || addr + count * entry_length > story_size)
+		return;
+
+	if ((words = malloc((count + 1) * sizeof(*words))) == NULL)
+		os_fatal("Out of memory");
+	for (i = 0; i < count; i++, addr += entry_length)
+		if (decode_word(addr, bytes, words[word_count]) &&
+		    words[word_count][0] != '\0')
+			word_count++;
+} /* read_words */
+
+
+/*
+ * run_one
+ *
+ * Run the test case given to -z with its output shown, and quit.
+ *
+ */
+static void run_one(void)
+{
+	static zbyte buf[FUZZ_MAX_SIZE];
+	long size;
+	int outcome;
+
+	if ((size = read_testcase(f_setup.fuzz_path, buf)) < 0)
+		os_fatal("Can't read the test case (-z).");
+	outcome = run(buf, size);
+	flush_buffer();
+	os_reset_screen();
+	fflush(stdout);
+	fprintf(stderr, "[%s; %lu instructions]\n",
+		outcome_names[outcome], instruction_count);
+	os_quit(EXIT_SUCCESS);
+} /* run_one */
+
+
+/*
+ * read_corpus
+ *
+ * Run everything in the corpus directory, keeping what reaches
+ * something new.  Keep an empty test case if nothing does.
+ *
+ */
+static void read_corpus(void)
+{
+	static zbyte buf[FUZZ_MAX_SIZE];
+	struct dirent *entry;
+	char *name;
+	DIR *dir;
+	long size;
+	long read = 0;
+
+	if ((dir = opendir(f_setup.fuzz_path)) == NULL)
+		os_fatal("Can't read the corpus (-z).");
+	while ((entry = readdir(dir)) != NULL && !stopping) {
+		if (entry->d_name[0] == '.')
+			continue;
+		name = malloc(strlen(f_setup.fuzz_path) +
+			      strlen(entry->d_name) + 2);
+		if (name == NULL)
+			os_fatal("Out of memory");
+		sprintf(name, "%s/%s", f_setup.fuzz_path, entry->d_name);
+		size = read_testcase(name, buf);
+		free(name);
+		if (size < 0)
+			continue;
+		read++;
+		run(buf, size);
+		if (new_coverage() > 0)
+			add_testcase(buf, size);
+	}
+	closedir(dir);
+
+	if (corpus_size == 0)
+		add_testcase(buf, 0);
+	fprintf(report, "INFO: %ld test cases read, %ld kept\n", read,
+		corpus_size);
+} /* read_corpus */
+
+
+/*
+ * show_progress
+ *
+ * Report how far fuzzing has got, libFuzzer fashion.
+ *
+ */
+static void show_progress(zlong runs, const char *what,
+			  struct timeval *start)
+{
+	struct timeval now;
+	double seconds;
+
+	gettimeofday(&now, NULL);
+	seconds = (now.tv_sec - start->tv_sec) +
+		(now.tv_usec - start->tv_usec) / 1e6;
+	fprintf(report, "#%lu\t%s\tcode: %ld edges: %ld corp: %ld "
+		"exec/s: %.0f\n", runs, what, code_count, edge_count,
+		corpus_size, seconds > 0 ? runs / seconds : 0.0);
+	fflush(report);
+} /* show_progress */
+
+
+/*
+ * dumb_fuzz
+ *
+ * Fuzz the story until -j runs have been made or the fuzzer is
+ * interrupted, then quit.  This is called once the story is ready to
+ * start, and does not return.
+ *
+ */
+void dumb_fuzz(void)
+{
+	static zbyte buf[FUZZ_MAX_SIZE];
+	struct timeval start;
+	struct stat st;
+	const testcase_t *base;
+	zlong runs = 0;
+	zlong next_report = 1;
+	char *prefix;
+	long size;
+	int changes;
+	int i;
+	int null_fd;
+
+	fuzzing = TRUE;
+	if (f_setup.fuzz_steps == 0)
+		f_setup.fuzz_steps = FUZZ_STEPS;
+
+	static_start = z_header.dynamic_size;
+	if ((story_static = malloc(story_size - static_start)) == NULL)
+		os_fatal("Out of memory");
+	memcpy(story_static, zmp + static_start, story_size - static_start);
+
+	if (stat(f_setup.fuzz_path, &st) != 0)
+		os_fatal("Can't find the corpus (-z).");
+	if (!S_ISDIR(st.st_mode))
+		run_one();
+
+	/* Keep standard error for reports and send the story nowhere */
+	fflush(stdout);
+	fflush(stderr);
+	null_fd = open("/dev/null", O_WRONLY);
+	if (null_fd < 0 || (report = fdopen(dup(STDERR_FILENO), "w")) == NULL ||
+	    dup2(null_fd, STDOUT_FILENO) < 0 ||
+	    dup2(null_fd, STDERR_FILENO) < 0)
+		os_fatal(strerror(errno));
+	close(null_fd);
+
+	cover_start();
+	code_map_size = (story_size + 7) / 8;
+	if ((code_seen = malloc(code_map_size)) == NULL)
+		os_fatal("Out of memory");
+	memcpy(code_seen, cover_code, code_map_size);
+
+	seed = ((zlong) time(NULL) ^ (zlong) getpid() << 16) & 0xffffffffUL;
+	if (seed == 0)
+		seed = 1;
+	fprintf(report, "INFO: seed %lu, %ld instructions a run\n", seed,
+		f_setup.fuzz_steps);
+	read_words();
+	fprintf(report, "INFO: %ld words in the dictionary\n", word_count);
+
+	for (i = 0; i < crash_signal_count; i++)
+		old_handlers[i] = signal(crash_signals[i], crash_handler);
+	signal(SIGINT, stop_handler);
+	signal(SIGTERM, stop_handler);
+	signal(SIGALRM, timeout_handler);
+	run_timeout = FUZZ_TIMEOUT;
+
+	gettimeofday(&start, NULL);
+	read_corpus();
+	show_progress(runs, "INITED", &start);
+	if (edge_count == 0)
+		fprintf(report, "INFO: no edges of C code are being seen; "
+			"\"make zfuzz\" builds a dfrotz that shows them\n");
+
+	if ((prefix = malloc(strlen(f_setup.fuzz_path) + 2)) == NULL)
+		os_fatal("Out of memory");
+	sprintf(prefix, "%s/", f_setup.fuzz_path);
+
+	gettimeofday(&start, NULL);
+	while (!stopping && (f_setup.fuzz_runs == 0 ||
+			     runs < f_setup.fuzz_runs)) {
+		base = &corpus[next_random() % corpus_size];
+		memcpy(buf, base->data, base->size);
+		size = base->size;
+		for (changes = 1 + next_random() % FUZZ_CHANGES; changes > 0;
+		     changes--)
+			size = change(buf, size);
+
+		outcomes[run(buf, size)]++;
+		runs++;
+		if (new_coverage() > 0) {
+			add_testcase(buf, size);
+			if (!write_testcase(prefix, buf, size))
+				fprintf(report, "Can't write to the corpus\n");
+			show_progress(runs, "NEW", &start);
+		} else if (runs == next_report) {
+			show_progress(runs, "pulse", &start);
+		}
+		if (runs == next_report)
+			next_report *= 2;
+	}
+	show_progress(runs, "DONE", &start);
+	fprintf(report, "INFO: of the runs, %lu %s, %lu %s, %lu %s and %lu %s\n",
+		outcomes[FUZZ_DONE], outcome_names[FUZZ_DONE],
+		outcomes[FUZZ_QUIT], outcome_names[FUZZ_QUIT],
+		outcomes[FUZZ_FATAL], outcome_names[FUZZ_FATAL],
+		outcomes[FUZZ_HANG], outcome_names[FUZZ_HANG]);
+
+	free(prefix);
+	os_quit(EXIT_SUCCESS);
+} /* dumb_fuzz */
+
+
+/*
+ * dumb_fuzzing
+ *
+ * Return true once the fuzzer has taken over.
+ *
+ */
+bool dumb_fuzzing(void)
+{
+	return fuzzing;
+} /* dumb_fuzzing */
@@ -20,7 +20,9 @@
  */
 
 #include <libgen.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include "dfrotz.h"
 #include "dblorb.h"
 
@@ -30,6 +32,7 @@ extern z_header_t z_header;
 
 static void usage(void);
 static void print_version(void);
+static void write_stats(void);
 
 #define INFORMATION "\
 An interpreter for all Infocom and other Z-Machine games.\n\
@@ -45,7 +48,18 @@ Syntax: dfrotz [options] story-file\n\
   -o   watch object movement      \t -v   show version information\n\
   -O   watch object locating      \t -w # screen width\n\
   -L <file> load this save file   \t -x   expand abbreviations g/x/z\n\
-  -m   turn off MORE prompts      \t -Z # error checking (see below)\n"
+  -m   turn off MORE prompts      \t -Z # error checking (see below)\n\
+  -D <path> resident bot mode     \t -k # delta saves per full save\n\
+  -C <file> collapse save chain   \t -T <dir> keep saves in a store\n\
+  -g   collect -T store garbage   \t -b   record commands in binary\n\
+  -F <file> fast-forward commands \t -H   hash fast-forward output\n\
+  -M <file> write run statistics  \t -c <file> profile Z-code routines\n\
+  -y # time one opcode in #       \t -e <file> sample the Z-code PC\n\
+  -E <sink> per-turn telemetry    \t -X <file> map the code reached\n\
+  -K <dir> cache story analysis   \t -U   skip checks proven needless\n\
+  -W <file> trace machine state   \t -n #[,#[,#]] trace every # from # to #\n\
+  -z <dir> fuzz with this corpus  \t -j #[,#] # runs of # instructions\n\
+  -Q   write a report if it dies\n"
 
 #define INFO2 "\
 Error checking: 0 none, 1 first only (default), 2 all, 3 exit after any error.\n\
@@ -58,6 +72,8 @@ static int user_text_height = 24;
 static int user_random_seed = -1;
 static int user_tandy_bit = 0;
 static bool plain_ascii = FALSE;
+static char *stats_file = NULL;
+static struct timeval stats_start;
 
 bool do_more_prompts;
 
@@ -73,13 +89,15 @@ void os_process_arguments(int argc, char *argv[])
 	int c, num;
 	char *p = NULL;
 	char *format_orig = NULL;
+	bool collect_store = FALSE;
+	long removed;
 
 	zoptarg = NULL;
 
 	do_more_prompts = TRUE;
 	/* Parse the options */
 	do {
-		c = zgetopt(argc, argv, "aAB:f:h:iI:L:moOpPs:r:R:S:tu:vw:xZ:");
+		c = zgetopt(argc, argv, "aAbB:c:C:D:e:E:f:F:gh:HiI:j:k:K:L:mM:n:oOpPQs:r:R:S:tT:u:Uvw:W:xX:y:z:Z:");
 		switch(c) {
 		case 'a':
 			f_setup.attribute_assignment = 1;
@@ -87,10 +105,40 @@ void os_process_arguments(int argc, char *argv[])
 		case 'A':
 			f_setup.attribute_testing = 1;
 			break;
+		case 'b':
+			f_setup.record_binary = TRUE;
+			break;
 		case 'B':
 			f_setup.bot_mode = TRUE;
 			f_setup.bot_command = strdup(zoptarg);
 			break;
+		case 'c':
+#ifdef PROFILING
+			f_setup.profile_file = strdup(zoptarg);
+#else
+			os_fatal("-c needs a dfrotz built with PROFILING");
+#endif
+			break;
+		case 'C':
+			f_setup.bot_mode = TRUE;
+			f_setup.bot_collapse = strdup(zoptarg);
+			f_setup.bot_status = BOT_LOAD;
+			break;
+		case 'D':
+			f_setup.bot_mode = TRUE;
+			f_setup.bot_server = strdup(zoptarg);
+			f_setup.bot_status = BOT_LOAD;
+			break;
+		case 'e':
+#ifndef NO_SAMPLING
+			f_setup.sample_file = strdup(zoptarg);
+#else
+			os_fatal("-e needs a dfrotz built without NO_SAMPLING");
+#endif
+			break;
+		case 'E':
+			f_setup.telemetry = strdup(zoptarg);
+			break;
 		case 'f':
 #ifdef DISABLE_FORMATS
 			f_setup.format = FORMAT_DISABLED;
@@ -109,15 +157,34 @@ void os_process_arguments(int argc, char *argv[])
 			} else
 				f_setup.format = FORMAT_UNKNOWN;
 			break;
+		case 'F':
+			f_setup.replay_file = strdup(zoptarg);
+			break;
+		case 'g':
+			collect_store = TRUE;
+			break;
 		case 'h':
 			user_text_height = atoi(zoptarg);
 			break;
+		case 'H':
+			f_setup.replay_hash = TRUE;
+			break;
 		case 'i':
 			f_setup.ignore_errors = 1;
 			break;
 		case 'I':
 			f_setup.interpreter_number = atoi(zoptarg);
 			break;
+		case 'j':
+			sscanf(zoptarg, "%lu,%lu", &f_setup.fuzz_runs,
+			       &f_setup.fuzz_steps);
+			break;
+		case 'k':
+			f_setup.bot_keyframes = atoi(zoptarg);
+			break;
+		case 'K':
+			f_setup.symbol_cache = strdup(zoptarg);
+			break;
 		case 'L':
 			f_setup.restore_mode = 1;
 			f_setup.bot_status = BOT_LOAD;
@@ -126,6 +193,13 @@ void os_process_arguments(int argc, char *argv[])
 		case 'm':
 			do_more_prompts = FALSE;
 			break;
+		case 'M':
+			stats_file = strdup(zoptarg);
+			break;
+		case 'n':
+			sscanf(zoptarg, "%lu,%lu,%lu", &f_setup.lockstep_every,
+			       &f_setup.lockstep_from, &f_setup.lockstep_to);
+			break;
 		case 'o':
 			f_setup.object_movement = 1;
 			break;
@@ -135,6 +209,9 @@ void os_process_arguments(int argc, char *argv[])
 		case 'P':
 			f_setup.piracy = 1;
 			break;
+		case 'Q':
+			f_setup.crash_report = TRUE;
+			break;
 		case 'p':
 			plain_ascii = 1;
 			break;
@@ -153,9 +230,15 @@ void os_process_arguments(int argc, char *argv[])
 		case 't':
 			user_tandy_bit = 1;
 			break;
+		case 'T':
+			f_setup.save_store = strdup(zoptarg);
+			break;
 		case 'u':
 			f_setup.undo_slots = atoi(zoptarg);
 			break;
+		case 'U':
+			f_setup.trusted = TRUE;
+			break;
 		case 'v':
 			print_version();
 			os_quit(EXIT_SUCCESS);
@@ -163,9 +246,25 @@ void os_process_arguments(int argc, char *argv[])
 		case 'w':
 			user_text_width = atoi(zoptarg);
 			break;
+		case 'W':
+			f_setup.lockstep_file = strdup(zoptarg);
+			break;
 		case 'x':
 			f_setup.expand_abbreviations = 1;
 			break;
+		case 'X':
+			f_setup.coverage_file = strdup(zoptarg);
+			break;
+		case 'y':
+#ifdef PROFILING
+			f_setup.opcode_sample = atoi(zoptarg);
+#else
+			os_fatal("-y needs a dfrotz built with PROFILING");
+#endif
+			break;
+		case 'z':
+			f_setup.fuzz_path = strdup(zoptarg);
+			break;
 		case 'Z':
 			f_setup.err_report_mode = atoi(zoptarg);
 			if ((f_setup.err_report_mode < ERR_REPORT_NEVER) ||
@@ -180,13 +279,48 @@ void os_process_arguments(int argc, char *argv[])
 		}
 	} while (c != EOF);
 
+	if (collect_store) {
+		if (f_setup.save_store == NULL)
+			os_fatal("Garbage collection (-g) needs a store (-T).");
+		if ((removed = store_collect()) < 0)
+			os_fatal("Can't read the save store.");
+		printf("Removed %ld unused pieces from %s.\n", removed,
+			f_setup.save_store);
+		os_quit(EXIT_SUCCESS);
+	}
+
 	if (argv[zoptind] == NULL) {
 		usage();
 		os_quit(EXIT_SUCCESS);
 	}
 
-	if (f_setup.bot_mode && !(f_setup.restore_mode && f_setup.restricted_path))
+	if (f_setup.bot_collapse != NULL) {
+		if (f_setup.restore_mode || f_setup.bot_command != NULL ||
+		    f_setup.bot_server != NULL)
+			os_fatal("Collapsing a save chain takes no -B, -D or -L.");
+	} else if (f_setup.bot_server != NULL) {
+		if (f_setup.restore_mode || !f_setup.restricted_path)
+			os_fatal("Resident bot mode requires -R and does not take -L.");
+	} else if (f_setup.bot_mode && !(f_setup.restore_mode && f_setup.restricted_path))
 		os_fatal("Bot mode requires arguments to both -L and -R options.");
+	if (f_setup.bot_keyframes != 0 && f_setup.bot_server == NULL)
+		os_fatal("Delta saves (-k) are only made in resident bot mode.");
+	if (f_setup.replay_hash && f_setup.replay_file == NULL)
+		os_fatal("Hashing output (-H) needs a command file (-F).");
+	if (f_setup.fuzz_path != NULL) {
+		if (f_setup.bot_mode || f_setup.restore_mode ||
+		    f_setup.replay_file != NULL || f_setup.trusted ||
+		    f_setup.lockstep_file != NULL)
+			os_fatal("Fuzzing (-z) takes none of -B, -C, -D, -F, -L, -U or -W.");
+		/* Runs must be repeatable */
+		if (user_random_seed == -1)
+			user_random_seed = 1;
+	}
+
+	if (stats_file != NULL) {
+		gettimeofday(&stats_start, NULL);
+		atexit(write_stats);
+	}
 
 	switch (f_setup.format) {
 	case FORMAT_IRC:
@@ -244,7 +378,7 @@ void os_process_arguments(int argc, char *argv[])
 	strncat(f_setup.command_name, EXT_COMMAND, strlen(EXT_COMMAND) + 1);
 
 	/* Set our auto load save as the name save */
-	if (f_setup.restore_mode || f_setup.bot_mode) {
+	if (f_setup.auto_save_name != NULL) {
 		f_setup.save_name = malloc((strlen(f_setup.auto_save_name) +
 			strlen(EXT_SAVE)) * sizeof(char) + 1);
 		memcpy(f_setup.save_name, f_setup.auto_save_name, (strlen(f_setup.auto_save_name) + strlen(EXT_SAVE)) * sizeof(char));
@@ -305,20 +439,67 @@ int os_random_seed (void)
  */
 void os_quit(int status)
 {
+	/* A fuzzing run just ends */
+	dumb_fuzz_end(FUZZ_QUIT);
 	exit(status);
 }
 
 
-void os_restart_game (int UNUSED (stage)) {}
+/*
+ * write_stats
+ *
+ * Called at exit when -M was given: write the number of instructions
+ * run, the time taken and the peak memory use to the named file, one
+ * "name value" pair per line.
+ *
+ */
+static void write_stats(void)
+{
+	struct timeval end;
+	struct rusage usage;
+	long max_rss = 0;
+	FILE *fp;
+
+	gettimeofday(&end, NULL);
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		max_rss = usage.ru_maxrss;
+#ifdef __APPLE__
+	max_rss /= 1024;	/* Reported in bytes rather than kilobytes */
+#endif
+
+	if ((fp = fopen(stats_file, "w")) == NULL)
+		return;
+	fprintf(fp, "instructions %lu\n", instruction_count);
+	fprintf(fp, "seconds %.6f\n", (end.tv_sec - stats_start.tv_sec) +
+		(end.tv_usec - stats_start.tv_usec) / 1e6);
+	fprintf(fp, "max_rss_kb %ld\n", max_rss);
+	fclose(fp);
+} /* write_stats */
+
+
+void os_restart_game (int stage)
+{
+	/* The fuzzer takes over once the story is ready to start */
+	if (stage == RESTART_END && f_setup.fuzz_path != NULL &&
+	    !dumb_fuzzing())
+		dumb_fuzz();
+}
 
 
 void os_fatal (const char *s, ...)
 {
 	fprintf(stderr, "\nFatal error: %s\n", s);
+	/* A fuzzing run just ends, unless told to carry on */
+	if (!f_setup.ignore_errors)
+		dumb_fuzz_end(FUZZ_FATAL);
 	if (f_setup.ignore_errors)
 		fprintf(stderr, "Continuing anyway...\n");
-	else
+	else {
+		flight_dump(s);
+		/* A resident bot server just fails the current request */
+		dumb_end_request(FALSE);
 		os_quit(EXIT_FAILURE);
+	}
 }
 
 
@@ -94,6 +94,14 @@ static void end_of_turn(void)
 
 
 	if (f_setup.bot_mode) {
+		/* Collapsing a chain of saves also waits for the first prompt */
+		if (f_setup.bot_collapse != NULL)
+			dumb_collapse();
+
+		/* In resident bot mode, the first prompt starts the server */
+		if (f_setup.bot_server != NULL && !dumb_serving())
+			dumb_serve();
+
 		/* Maybe not here... */
 		if (f_setup.bot_status == BOT_LOAD) {
 			f_setup.bot_status = BOT_NORMAL;
@@ -111,6 +119,26 @@ static void end_of_turn(void)
 //			f_setup.bot_command = strdup("SAVE");
 //			f_setup.bot_status = BOT_SAVE;
 
+			/* A resident server returns the save in memory */
+			if (f_setup.bot_server != NULL)
+				dumb_end_request(TRUE);
+
+			if (f_setup.save_store != NULL) {
+				save_done = TRUE;
+				if (!store_save(f_setup.save_name))
+					fprintf(stderr, "Can't write save\n");
+				os_quit(EXIT_SUCCESS);
+			}
+
+			/* Let the output go while the save is written */
+			if (save_frotz_later(f_setup.save_name)) {
+				save_done = TRUE;
+				fflush(stdout);
+				if (!bg_save_flush())
+					fprintf(stderr, "Can't write save\n");
+				os_quit(EXIT_SUCCESS);
+			}
+
 			save_fp = fopen(f_setup.save_name, "wb");
 			if (save_fp == NULL) {
 				fprintf(stderr, "Can't read save\n");
@@ -130,6 +158,9 @@ static int xgetchar(void)
 {
 	int c;
 
+	if (dumb_fuzzing())
+		return dumb_fuzz_getchar();
+
 	if (f_setup.bot_mode && !line_done) {
 		c = f_setup.bot_command[bot_char_count++];
 		if (c == '\0')
@@ -204,6 +235,7 @@ static void translate_special_chars(char *s)
 			case 'X': *dest++ = ZC_HKEY_QUIT; break;
 			case 'D': *dest++ = ZC_HKEY_DEBUG; break;
 			case 'H': *dest++ = ZC_HKEY_HELP; break;
+			case 'O': *dest++ = ZC_HKEY_OPCODES; break;
 			case '1': *dest++ = ZC_FKEY_F1; break;
 			case '2': *dest++ = ZC_FKEY_F2; break;
 			case '3': *dest++ = ZC_FKEY_F3; break;
@@ -324,7 +356,8 @@ static bool dumb_read_line(char *s, char *prompt, bool show_cursor,
 		if ((s[0] != '\\') || ((s[1] != '\0') && !islower(s[1]))) {
 			/* Is not a command line.  */
 			translate_special_chars(s);
-			if (timeout) {
+			/* A fuzzer's input comes at once, whatever the clock says */
+			if (timeout && !dumb_fuzzing()) {
 				int elapsed = (time(0) - start_time) * 10 * speed;
 				if (elapsed > timeout) {
 					time_ahead = elapsed - timeout;
@@ -489,7 +522,7 @@ zchar os_read_key (int timeout, bool show_cursor)
 }
 
 
-zchar os_read_line (int UNUSED (max), zchar *buf, int timeout, int UNUSED(width), int continued)
+zchar os_read_line (int max, zchar *buf, int timeout, int UNUSED(width), int continued)
 {
 	char *p;
 	int terminator;
@@ -528,22 +561,24 @@ zchar os_read_line (int UNUSED (max), zchar *buf, int timeout, int UNUSED(width)
 		}
 	}
 
-	/* TODO: Truncate to width and max.  */
+	/* TODO: Truncate to width.  */
 
 	/* copy to screen */
 	dumb_display_user_input(read_line_buffer);
 
-	/* copy to the buffer and save the rest for next time.  */
+	/* copy to the buffer, as much as it holds, and save the rest
+	 * for next time.  */
 #ifndef USE_UTF8
-	strncat((char*) buf, (char *) read_line_buffer,
-		INPUT_BUFFER_SIZE - strlen(read_line_buffer) - 1);
+	if ((int) strlen((char *) buf) < max)
+		strncat((char *) buf, (char *) read_line_buffer,
+			max - strlen((char *) buf));
 #else
 	for (len = 0;; len++) {
 		if (!buf[len])
 			break;
 	}
 	j = 0;
-	for (i = len; i < INPUT_BUFFER_SIZE - 2; i++) {
+	for (i = len; i < max && i < INPUT_BUFFER_SIZE - 2; i++) {
 		if (!read_line_buffer[j])
 			break;
 		j = utf8_to_zchar(&buf[i], read_line_buffer, j);
@@ -576,6 +611,10 @@ char *os_read_file_name (const char *default_name, int flag)
 	path_separator[0] = PATH_SEPARATOR;
 	path_separator[1] = 0;
 
+	/* The fuzzer's input must not name files to write over */
+	if (dumb_fuzzing())
+		return NULL;
+
 	/* If we're restoring a game before the interpreter starts,
  	 * our filename is already provided.  Just go ahead silently.
 	 * If we're in bot mode, we don't prompt for file names.
@@ -650,6 +689,18 @@ void os_more_prompt (void)
 }
 
 
+/* Forget any input left over, ready for a new resident bot request.  */
+void dumb_reset_input(void)
+{
+	bot_char_count = 0;
+	line_done = FALSE;
+	save_done = FALSE;
+	time_ahead = 0;
+	read_key_buffer[0] = '\0';
+	read_line_buffer[0] = '\0';
+}
+
+
 void dumb_init_input(void)
 {
 	if ((z_header.version >= V4) && (speed != 0))
@@ -668,5 +719,7 @@ zword os_read_mouse(void)
 
 void os_tick()
 {
-	/* Nothing here yet */
+	/* A fuzzing run that goes on too long is cut short */
+	if (dumb_fuzz_stop != 0 && instruction_count >= dumb_fuzz_stop)
+		dumb_fuzz_end(FUZZ_HANG);
 }
@@ -459,6 +459,10 @@ static void dumb_copy_cell(int dest_row, int dest_col,
  */
 void os_display_char (zchar c)
 {
+	/* A fuzzing run that prints too much is cut short */
+	if (dumb_fuzz_print != 0 && --dumb_fuzz_print == 0)
+		dumb_fuzz_end(FUZZ_HANG);
+
 	if (c >= ZC_LATIN1_MIN) {
 		if (plain_ascii) {
 			char *ptr = latin1_to_ascii + 4 * (c - ZC_LATIN1_MIN);
@@ -498,10 +502,21 @@ void os_display_string (const zchar *s)
 }
 
 
+/* Keep an area within the screen, whatever the story asked for.  */
+static void clip_area(int *top, int *left, int *bottom, int *right)
+{
+	if (*top < 0) *top = 0;
+	if (*left < 0) *left = 0;
+	if (*bottom >= z_header.screen_rows) *bottom = z_header.screen_rows - 1;
+	if (*right >= z_header.screen_cols) *right = z_header.screen_cols - 1;
+}
+
+
 void os_erase_area (int top, int left, int bottom, int right, int UNUSED (win))
 {
 	int row, col;
 	top--; left--; bottom--; right--;
+	clip_area(&top, &left, &bottom, &right);
 	for (row = top; row <= bottom; row++) {
 		for (col = left; col <= right; col++)
 			dumb_set_cell(row, col, make_cell(current_style, current_fg, current_bg, ' '));
@@ -514,6 +529,7 @@ void os_scroll_area (int top, int left, int bottom, int right, int units)
 	int row, col;
 
 	top--; left--; bottom--; right--;
+	clip_area(&top, &left, &bottom, &right);
 
 	if (units > 0) {
 		for (row = top; row <= bottom - units; row++) {
@@ -545,8 +561,11 @@ int os_font_data(int font, int *height, int *width)
 
 void os_set_colour (int newfg, int newbg)
 {
-	current_fg = frotz_to_dumb[newfg];
-	current_bg = frotz_to_dumb[newbg];
+	/* A story can ask for any number; those not in the table are ignored */
+	if (newfg >= 0 && newfg < 256)
+		current_fg = frotz_to_dumb[newfg];
+	if (newbg >= 0 && newbg < 256)
+		current_bg = frotz_to_dumb[newbg];
 }
 
 
@@ -610,6 +629,12 @@ void os_set_cursor(int row, int col)
 	cursor_row = row - 1; cursor_col = col - 1;
 	if (cursor_row >= z_header.screen_rows)
 		cursor_row = z_header.screen_rows - 1;
+	if (cursor_row < 0)
+		cursor_row = 0;
+	if (cursor_col >= z_header.screen_cols)
+		cursor_col = z_header.screen_cols - 1;
+	if (cursor_col < 0)
+		cursor_col = 0;
 }
 
 
@@ -731,6 +756,19 @@ void dumb_init_output(void)
 }
 
 
+/* Clear the screen and reset styles, ready for a new resident bot
+ * request.  */
+void dumb_reset_screen(void)
+{
+	current_style = 0;
+	current_fg = DEFAULT_DUMB_COLOUR;
+	current_bg = DEFAULT_DUMB_COLOUR;
+	cursor_row = cursor_col = 0;
+	os_erase_area(1, 1, z_header.screen_rows, z_header.screen_cols, -2);
+	memset(screen_changes, 0, screen_cells);
+}
+
+
 void dumb_display_user_input(char *s)
 {
 	/* copy to screen without marking it as a change.  */
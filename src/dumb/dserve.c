@@ -0,0 +1,433 @@
+/*
+ * dserve.c - Dumb interface, resident bot mode
+ *
+ * This file is part of Frotz.
+ *
+ * Frotz is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Frotz is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * In ordinary bot mode (-B) every turn costs a whole process: the
+ * story is loaded, a save file restored, one command run, a new save
+ * file written and the process exits.  In resident bot mode (-D) the
+ * process stays up and answers a stream of requests, each of which
+ * does the same work with saves passed in memory.
+ *
+ * A request is a header line followed by a saved game:
+ *
+ *	<session> <save size> <command>\n
+ *	<save size bytes of Quetzal data>
+ *
+ * A save size of 0 starts a new game; as with -B the command is then
+ * ignored and the reply holds the introduction.  The reply is
+ *
+ *	<session> <status> <output size> <save size>\n
+ *	<output size bytes of text><save size bytes of Quetzal data>
+ *
+ * where status is "ok", "quit" if the story ended, or "error" if the
+ * save could not be restored or a fatal error occurred.  Only "ok"
+ * comes with a new save.  The session is just echoed back; all state
+ * is in the save, so requests for different players can be mixed.
+ *
+ * With -k n, saves are kept small by making most of them delta saves,
+ * which hold only what changed since the save given with the request.
+ * The client appends each save it gets to the ones it sent, and sends
+ * the whole chain with the next request.  Every n-th save is a full
+ * save again; everything before it may then be dropped.  Bytes 34-37
+ * of a save from the server read "DMem" for a delta save and "CMem"
+ * for a full one.  dfrotz -C turns a chain into an ordinary save.
+ *
+ * Requests are read from stdin and answered on stdout when the path
+ * given to -D is "-".  Otherwise a Unix domain socket is created at
+ * that path and connections to it are served one at a time.
+ *
+ * The story runs up to its first prompt when the interpreter starts,
+ * and the server takes over from there.  Each request restarts the
+ * Z-machine from the copy of dynamic memory kept by fastmem.c, so the
+ * story file is not read again.
+ */
+
+#include <setjmp.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "dfrotz.h"
+
+extern void interpret(void);
+extern void memory_close(void);
+
+#define SERVE_OK	1
+#define SERVE_QUIT	2
+#define SERVE_ERROR	3
+
+#define SESSION_SIZE 64
+
+static char *status_names[] = { "", "ok", "quit", "error" };
+
+static bool serving = FALSE;
+static bool in_request = FALSE;
+static jmp_buf request_done;
+
+static FILE *request_in = NULL;
+static FILE *reply_out = NULL;
+static int real_stdout = -1;
+static FILE *capture = NULL;
+
+static char session[SESSION_SIZE];
+static zbyte *restore_data = NULL;
+static long restore_size = 0;
+static int chain_length = 0;
+static membuf_t save_data = { NULL, 0, 0 };
+static char *output = NULL;
+static long output_size = 0;
+
+
+/*
+ * read_request
+ *
+ * Read the next request.  Return FALSE at the end of the input.
+ *
+ */
+static bool read_request(void)
+{
+	char header[INPUT_BUFFER_SIZE + SESSION_SIZE + 32];
+	char *p;
+	int n;
+
+	do {
+		if (fgets(header, sizeof(header), request_in) == NULL)
+			return FALSE;
+		if ((p = strchr(header, '\n')) != NULL)
+			*p = '\0';
+	} while (*header == '\0');
+
+	n = 0;
+	if (sscanf(header, "%63s %ld %n", session, &restore_size, &n) < 2 ||
+	    n == 0 || restore_size < 0) {
+		fprintf(stderr, "DUMB-FROTZ: bad request: %s\n", header);
+		return FALSE;
+	}
+
+	free(restore_data);
+	restore_data = NULL;
+	if (restore_size > 0) {
+		if ((restore_data = malloc(restore_size)) == NULL)
+			os_fatal("Out of memory");
+		if (fread(restore_data, 1, restore_size, request_in) !=
+		    (size_t) restore_size)
+			return FALSE;
+	}
+
+	free(f_setup.bot_command);
+	f_setup.bot_command = strdup(header + n);
+	return TRUE;
+} /* read_request */
+
+
+/*
+ * start_capture
+ *
+ * Send everything written to stdout into the capture file.
+ *
+ */
+static void start_capture(void)
+{
+	fflush(stdout);
+	if (ftruncate(fileno(capture), 0) != 0 ||
+	    lseek(fileno(capture), 0, SEEK_SET) != 0 ||
+	    dup2(fileno(capture), STDOUT_FILENO) < 0)
+		os_fatal(strerror(errno));
+} /* start_capture */
+
+
+/*
+ * end_capture
+ *
+ * Put stdout back and read what was written to it.
+ *
+ */
+static void end_capture(void)
+{
+	long size;
+	long got;
+	ssize_t n;
+
+	fflush(stdout);
+	if ((size = lseek(fileno(capture), 0, SEEK_CUR)) < 0 ||
+	    dup2(real_stdout, STDOUT_FILENO) < 0 ||
+	    lseek(fileno(capture), 0, SEEK_SET) != 0)
+		os_fatal(strerror(errno));
+
+	if (size > output_size) {
+		free(output);
+		if ((output = malloc(size)) == NULL)
+			os_fatal("Out of memory");
+	}
+	output_size = size;
+
+	for (got = 0; got < size; got += n) {
+		n = read(fileno(capture), output + got, size - got);
+		if (n <= 0)
+			break;
+	}
+	output_size = got;
+} /* end_capture */
+
+
+/*
+ * run_request
+ *
+ * Start the Z-machine afresh, restore the save given with the request,
+ * if any, and run the command.  Return the status for the reply.
+ *
+ */
+static int run_request(void)
+{
+	int status;
+	zword success;
+
+	if ((status = setjmp(request_done)) != 0)
+		return status;
+
+	/* The last request may have been cut short anywhere, even in the
+	 * middle of a flush or with output redirected to memory */
+	init_buffer();
+	init_err();
+	init_process();
+	dumb_reset_input();
+	dumb_reset_screen();
+	ostream_screen = TRUE;
+	while (ostream_memory)
+		memory_close();
+	z_restart();
+	clear_undo();
+
+	if (restore_data == NULL) {
+		f_setup.bot_status = BOT_START;
+	} else {
+		f_setup.bot_status = BOT_LOAD;
+		chain_length = quetzal_chain_length(restore_data, restore_size);
+		success = restore_frotz_mem(restore_data, restore_size);
+		if ((short) success <= 0)
+			return SERVE_ERROR;
+
+		/* Finish the save instruction, as z_restore does */
+		if (z_header.version <= V3)
+			branch(success);
+		else
+			store(success);
+	}
+
+	interpret();
+	return SERVE_QUIT;
+} /* run_request */
+
+
+/*
+ * save_reply
+ *
+ * Save the game for the reply: a delta save against the save given
+ * with the request while the chain is shorter than -k asks, otherwise
+ * a full save.  Return FALSE if the game could not be saved.
+ *
+ */
+static bool save_reply(void)
+{
+	if (restore_data != NULL && chain_length < f_setup.bot_keyframes &&
+	    save_frotz_delta(&save_data))
+		return TRUE;
+	return save_frotz_mem(&save_data) != 0;
+} /* save_reply */
+
+
+/*
+ * serve_requests
+ *
+ * Answer requests until the end of the input.
+ *
+ */
+static void serve_requests(void)
+{
+	int status;
+
+	while (read_request()) {
+		start_capture();
+		save_data.size = 0;
+		in_request = TRUE;
+		status = run_request();
+		in_request = FALSE;
+		end_capture();
+
+		if (status != SERVE_OK)
+			save_data.size = 0;
+		fprintf(reply_out, "%s %s %ld %ld\n", session,
+			status_names[status], output_size, save_data.size);
+		if (output_size > 0)
+			fwrite(output, 1, output_size, reply_out);
+		if (save_data.size > 0)
+			fwrite(save_data.data, 1, save_data.size, reply_out);
+		if (fflush(reply_out) == EOF)
+			break;
+	}
+} /* serve_requests */
+
+
+/*
+ * open_socket
+ *
+ * Create a Unix domain socket at the given path and listen on it.
+ *
+ */
+static int open_socket(const char *path)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		os_fatal("Socket path too long");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	/* Replace a socket left behind by an earlier server */
+	if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+	    bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	    listen(fd, 1) < 0)
+		os_fatal(strerror(errno));
+
+	return fd;
+} /* open_socket */
+
+
+/*
+ * dumb_serve
+ *
+ * Answer requests until the input ends, then quit.  This is called at
+ * the first prompt of the story and does not return.
+ *
+ */
+void dumb_serve(void)
+{
+	int listen_fd;
+	int fd;
+
+	serving = TRUE;
+
+	if ((capture = tmpfile()) == NULL ||
+	    (real_stdout = dup(STDOUT_FILENO)) < 0)
+		os_fatal(strerror(errno));
+
+	if (!strcmp(f_setup.bot_server, "-")) {
+		request_in = stdin;
+		if ((reply_out = fdopen(real_stdout, "w")) == NULL)
+			os_fatal(strerror(errno));
+		serve_requests();
+	} else {
+		signal(SIGPIPE, SIG_IGN);
+		listen_fd = open_socket(f_setup.bot_server);
+		for (;;) {
+			if ((fd = accept(listen_fd, NULL, NULL)) < 0) {
+				if (errno == EINTR)
+					continue;
+				os_fatal(strerror(errno));
+			}
+			request_in = fdopen(fd, "r");
+			reply_out = fdopen(dup(fd), "w");
+			if (request_in != NULL && reply_out != NULL)
+				serve_requests();
+			if (request_in != NULL)
+				fclose(request_in);
+			if (reply_out != NULL)
+				fclose(reply_out);
+		}
+	}
+
+	os_quit(EXIT_SUCCESS);
+} /* dumb_serve */
+
+
+/*
+ * dumb_serving
+ *
+ * Return true once resident bot mode has started serving requests.
+ *
+ */
+bool dumb_serving(void)
+{
+	return serving;
+} /* dumb_serving */
+
+
+/*
+ * dumb_end_request
+ *
+ * The current request is over.  If it ended at a prompt, save the game
+ * for the reply; if it ended with a fatal error, reply with an error.
+ * Does not return while a request is running.
+ *
+ */
+void dumb_end_request(bool ok)
+{
+	if (!in_request)
+		return;
+
+	if (ok && !save_reply())
+		ok = FALSE;
+
+	longjmp(request_done, ok ? SERVE_OK : SERVE_ERROR);
+} /* dumb_end_request */
+
+
+/*
+ * dumb_collapse
+ *
+ * Restore the chain of saves in the file given to -C and write the
+ * result to stdout as a single full save, which any interpreter can
+ * restore.  Like dumb_serve, this is called at the first prompt and
+ * does not return.
+ *
+ */
+void dumb_collapse(void)
+{
+	FILE *fp;
+	long size = -1;
+
+	if ((fp = fopen(f_setup.bot_collapse, "rb")) == NULL ||
+	    fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 ||
+	    fseek(fp, 0, SEEK_SET) != 0)
+		os_fatal("Can't read save chain");
+
+	if ((restore_data = malloc(size + 1)) == NULL)
+		os_fatal("Out of memory");
+	if (fread(restore_data, 1, size, fp) != (size_t) size)
+		os_fatal("Can't read save chain");
+	fclose(fp);
+
+	if ((short) restore_frotz_mem(restore_data, size) <= 0)
+		os_fatal("Error reading save file");
+	if (!save_frotz_mem(&save_data) ||
+	    fwrite(save_data.data, 1, save_data.size, stdout) !=
+	    (size_t) save_data.size || fflush(stdout) == EOF)
+		os_fatal("Error writing save file");
+
+	os_quit(EXIT_SUCCESS);
+} /* dumb_collapse */
@@ -0,0 +1,154 @@
+#!/usr/bin/perl -w
+
+# Join the coverage maps that frotz writes with -X, so that the code and
+# text reached in many sessions, on many machines, can be looked at as
+# one.  All the maps must be for the same story.  Use it like this:
+#
+#   zcovmerge.pl all.cov monday.cov tuesday.cov ...
+#
+# to write all.cov with every address reached in any of the others.  An
+# existing all.cov is replaced, so name it among the inputs as well to
+# add to it.  With -l, nothing is written and the addresses in the maps
+# are listed instead, one per line, as "code" or "text" and the address
+# in hex, which can be set against the output of a disassembler such as
+# txd to find what no player has reached.  With -u and the story's
+# symbol table, which frotz keeps with -K, the addresses of the
+# instructions and strings in the table that are missing from the maps
+# are listed instead:
+#
+#   zcovmerge.pl -u symbols/1-180329-64ea.zsym all.cov
+#
+# The format of the files is described at the top of src/common/cover.c.
+
+use strict;
+
+my $list = 0;
+my $symbols;
+if (@ARGV && $ARGV[0] eq "-l") {
+	$list = 1;
+	shift @ARGV;
+} elsif (@ARGV > 1 && $ARGV[0] eq "-u") {
+	$list = 1;
+	shift @ARGV;
+	$symbols = read_file(shift @ARGV);
+}
+if ((!$list && @ARGV < 2) || ($list && @ARGV < 1)) {
+	print STDERR "usage: $0 output.cov input.cov ...\n";
+	print STDERR "       $0 -l input.cov ...\n";
+	print STDERR "       $0 -u story.zsym input.cov ...\n";
+	exit 1;
+}
+my $output = $list ? undef : shift @ARGV;
+
+my $key;
+my $size;
+my @maps = ("", "");
+
+foreach my $file (@ARGV) {
+	my $data = read_file($file);
+
+	length($data) >= 18 && substr($data, 0, 4) eq "ZCOV"
+		or die "$0: $file is not a coverage map\n";
+	my $this_key = substr($data, 4, 10);
+	my $this_size = unpack("N", substr($data, 14, 4));
+	if (!defined $key) {
+		$key = $this_key;
+		$size = $this_size;
+		@maps = ("\0" x (($size + 7) >> 3)) x 2;
+	} elsif ($this_key ne $key || $this_size != $size) {
+		die "$0: $file is for another story\n";
+	}
+
+	my $pos = 18;
+	foreach my $m (0, 1) {
+		my $length = unpack("N", substr($data, $pos, 4));
+		my $map = decode(substr($data, $pos + 4, $length));
+		length($map) == length($maps[$m])
+			or die "$0: $file is damaged\n";
+		$maps[$m] |= $map;
+		$pos += 4 + $length;
+	}
+}
+
+if (defined $symbols) {
+	substr($symbols, 0, 4) eq "ZSYM" && substr($symbols, 4, 14) eq
+		$key . pack("N", $size) && length($symbols) == 18 + $size
+		or die "$0: the symbol table is for another story\n";
+	# SYM_INSN and SYM_STRING in src/common/frotz.h
+	foreach my $m (0, 1) {
+		my $kind = $m ? "text" : "code";
+		my $flag = $m ? 0x04 : 0x01;
+		foreach my $addr (0 .. $size - 1) {
+			next unless ord(substr($symbols, 18 + $addr, 1)) & $flag;
+			printf "%s %06x\n", $kind, $addr
+				unless vec($maps[$m], $addr, 1);
+		}
+	}
+	exit 0;
+}
+
+if ($list) {
+	foreach my $m (0, 1) {
+		my $kind = $m ? "text" : "code";
+		foreach my $addr (grep { vec($maps[$m], $_, 1) } 0 .. $size - 1) {
+			printf "%s %06x\n", $kind, $addr;
+		}
+	}
+	exit 0;
+}
+
+open(my $out, ">", $output) or die "$0: can't write $output: $!\n";
+binmode $out;
+print $out "ZCOV", $key, pack("N", $size);
+foreach my $m (0, 1) {
+	my $encoded = encode($maps[$m]);
+	print $out pack("N", length($encoded)), $encoded;
+}
+close $out or die "$0: can't write $output: $!\n";
+
+printf STDERR "%d instructions and %d strings reached\n",
+	unpack("%32b*", $maps[0]), unpack("%32b*", $maps[1]);
+exit 0;
+
+
+sub read_file {
+	my ($file) = @_;
+
+	open(my $in, "<", $file) or die "$0: can't read $file: $!\n";
+	binmode $in;
+	local $/;
+	my $data = <$in>;
+	close $in;
+	return $data;
+}
+
+# A zero byte is followed by the count of further zero bytes, up to 255.
+sub decode {
+	my ($data) = @_;
+	my $map = "";
+	my $i = 0;
+
+	while ($i < length($data)) {
+		my $c = substr($data, $i++, 1);
+		if ($c ne "\0") {
+			$map .= $c;
+		} else {
+			$map .= "\0" x (1 + ord(substr($data, $i++, 1)));
+		}
+	}
+	return $map;
+}
+
+sub encode {
+	my ($map) = @_;
+	my $data = "";
+
+	while ($map =~ /\G(?:(\0{1,256})|([^\0]+))/gs) {
+		if (defined $1) {
+			$data .= "\0" . chr(length($1) - 1);
+		} else {
+			$data .= $2;
+		}
+	}
+	return $data;
+}
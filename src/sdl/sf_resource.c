@@ -772,6 +772,7 @@ void os_fatal(const char *s, ...)
 		os_reset_screen();
 		SDL_Quit();
 	}
+	flight_dump(s);
 	sf_cleanup_all();
 	exit(EXIT_FAILURE);
 }
@@ -770,6 +770,8 @@ static zword goodzkey(SDL_Event * e, int allowed)
 					return ZC_HKEY_DEBUG;
 				case 'h':
 					return ZC_HKEY_HELP;
+				case 'o':
+					return ZC_HKEY_OPCODES;
 				}
 			return 0;
 		} else
@@ -942,6 +944,7 @@ zchar os_read_key(int timeout, int cursor)
  *     ZC_HKEY_QUIT (Alt-X, "exit game")
  *     ZC_HKEY_DEBUG (Alt-D)
  *     ZC_HKEY_HELP (Alt-H)
+ *     ZC_HKEY_OPCODES (Alt-O)
  *
  * If the timeout argument is not zero, the input gets interrupted
  * after timeout/10 seconds (and the return value is 0).
@@ -0,0 +1,185 @@
+#!/bin/sh
+#
+# lockstep.sh - Run a story under two dfrotz setups and find where they part
+#
+# This file is part of Frotz.
+#
+# Usage: lockstep.sh [-n N] [-i input] [-F commands] [-o options]
+#                    "dfrotz-a [options]" "dfrotz-b [options]" story
+#
+# The story is run once with each of the two commands, which may be two
+# builds of dfrotz or one build with different options, such as
+# "./dfrotz" and "./dfrotz -U".  Both get the same input, screen size
+# and random seed, and write a trace (-W) of the state of the machine
+# every N instructions, 1000 unless -n says otherwise: the PC, the
+# stack and hashes of dynamic memory and of the text printed (see
+# src/common/lockstep.c).
+#
+# If the traces differ, both are run again from the last line that
+# matched to the first that did not, this time with a line for every
+# instruction, and the first instruction after which the two machines
+# are not the same is reported along with the ones that led up to it.
+# If the traces agree, the output of the two runs is compared as well.
+#
+#   -i input     Feed this file to the story as its keyboard.
+#   -F commands  Fast-forward through this recorded command file (text
+#                or binary, as dfrotz -F takes).
+#   -o options   Give these dfrotz options to both runs, such as "-Z 0".
+#
+# Exit 0 if the runs agree, 1 if they part, 2 if they could not be run.
+# The traces of runs that part are left in a temporary directory.
+
+every=1000
+input=/dev/null
+commands=
+options=
+
+usage() {
+	echo "usage: $0 [-n N] [-i input] [-F commands] [-o options]" \
+		"dfrotz-a dfrotz-b story" >&2
+	exit 2
+}
+
+while getopts n:i:F:o: opt; do
+	case $opt in
+	n) every=$OPTARG ;;
+	i) input=$OPTARG ;;
+	F) commands=$OPTARG ;;
+	o) options=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ $# -eq 3 ] || usage
+
+# Make a path relative to here absolute, as the runs are elsewhere.
+absolute() {
+	case $1 in
+	/*|"") echo "$1" ;;
+	*) echo "$(pwd)/$1" ;;
+	esac
+}
+
+# Only the first word of a command is a path.
+command_a=$(absolute "${1%% *}")${1#"${1%% *}"}
+command_b=$(absolute "${2%% *}")${2#"${2%% *}"}
+story=$(absolute "$3")
+input=$(absolute "$input")
+[ -n "$commands" ] && commands="-F $(absolute "$commands")"
+
+for c in "${command_a%% *}" "${command_b%% *}"; do
+	if [ ! -x "$c" ]; then
+		echo "$0: no dfrotz at $c" >&2
+		exit 2
+	fi
+done
+if [ ! -f "$story" ]; then
+	echo "$0: no story at $story" >&2
+	exit 2
+fi
+
+work=$(mktemp -d "${TMPDIR:-/tmp}/frotz-lockstep.XXXXXX") || exit 2
+
+# run <a|b> <-n argument>: run one side, leaving its trace in
+# $work/<side>/trace.  Each side has a directory of its own, so that
+# any files the story writes go nowhere.
+run() {
+	if [ $1 = a ]; then
+		command=$command_a
+	else
+		command=$command_b
+	fi
+	rm -rf "$work/$1"
+	mkdir "$work/$1"
+	cp "$story" "$work/$1/"
+	(cd "$work/$1" &&
+	 $command -m -w 80 -h 24 -s 1 -W trace -n "$2" $options $commands \
+		"$(basename "$story")" < "$input" > output 2> errors
+	 echo "[exit $?]" >> output)
+}
+
+# first_difference <trace> <trace>: print the number of the first line
+# that is not the same in both, counting a line missing from one.
+first_difference() {
+	awk 'NR == FNR { line[FNR] = $0; n = FNR; next }
+	     { m = FNR; if ($0 != line[FNR]) { print FNR; found = 1; exit } }
+	     END { if (!found && m != n) print (m < n ? m : n) + 1 }' "$1" "$2"
+}
+
+# count <trace> <line>: print the instruction count on a line, or
+# nothing if there is no such line.
+count() {
+	awk -v l=$2 'NR == l { print $1; exit }' "$1"
+}
+
+run a "$every"
+run b "$every"
+
+line=$(first_difference "$work/a/trace" "$work/b/trace")
+if [ -z "$line" ]; then
+	if cmp -s "$work/a/output" "$work/b/output"; then
+		echo "agree: $(tail -n 1 "$work/a/trace" | awk '{ print $1 }')" \
+			"instructions"
+		rm -rf "$work"
+		exit 0
+	fi
+	echo "the machines agree but the output differs; see $work/a/output" \
+		"and $work/b/output"
+	exit 1
+fi
+
+# Narrow it down to one instruction.
+if [ $line -gt 1 ]; then
+	from=$(($(count "$work/a/trace" $((line - 1))) + 1))
+else
+	from=1
+fi
+to_a=$(count "$work/a/trace" $line)
+to_b=$(count "$work/b/trace" $line)
+to=${to_a:-$to_b}
+if [ -n "$to_b" ] && [ "$to_b" -gt "$to" ]; then
+	to=$to_b
+fi
+mv "$work/a/trace" "$work/trace-a"
+mv "$work/b/trace" "$work/trace-b"
+run a "1,$from,$to"
+run b "1,$from,$to"
+
+echo "story: $story"
+echo "a: $1"
+echo "b: $2"
+echo "traces agree up to instruction $((from - 1)) and part by $to"
+line=$(first_difference "$work/a/trace" "$work/b/trace")
+if [ -z "$line" ]; then
+	echo "but they agree when traced from $from: the runs do not repeat"
+	echo "Traces are in $work" >&2
+	exit 1
+fi
+
+awk -v l=$line 'NR == FNR { a[FNR] = $0; next }
+	FNR == l {
+		split("instructions pc opcode stack-words frames " \
+		      "stack-hash memory-hash output-hash", name)
+		print "first difference at line " l " of the detailed trace:"
+		print "  a: " (l in a ? a[l] : "(ended)")
+		print "  b: " $0
+		if (l in a) {
+			n = split(a[l], x)
+			if (split($0, y) > n)
+				n = split($0, y)
+			diff = ""
+			for (i = 1; i <= n; i++)
+				if (x[i] != y[i])
+					diff = diff " " name[i]
+			print "  differs in:" diff
+		}
+		print "instructions before it (count, pc, opcode, ...):"
+		for (i = (l > 8 ? l - 8 : 1); i < l; i++)
+			print "  " a[i]
+		done = 1
+		exit
+	}
+	END { if (!done) print "b ended at line " l - 1 " of the detailed trace" }
+	' "$work/a/trace" "$work/b/trace"
+echo "Traces are in $work" >&2
+exit 1
@@ -0,0 +1,191 @@
+#!/bin/sh
+#
+# regress.sh - Run the test stories through dfrotz
+#
+# This file is part of Frotz.
+#
+# Usage: regress.sh test|bench|update [dfrotz]
+#        regress.sh lockstep [dfrotz [other]]
+#        regress.sh fuzz [dfrotz]
+#
+# Each story below is run without a terminal, with the commands in
+# input/<story>.in as its keyboard, a fixed screen size and a fixed
+# random seed.  The CRC of what it prints, and of how dfrotz exits, is
+# compared with the one kept in the file "golden".
+#
+#   test    Print PASS or FAIL for each story; exit non-zero on any FAIL.
+#   bench   Print one JSON object per story: instructions run, wall time,
+#           instructions per second and peak memory use, taken from the
+#           fastest of $RUNS runs (3 unless set), and whether the output
+#           matched.  Exit non-zero if any output did not match.
+#   update  Write new CRCs to "golden".  Do this only after checking that
+#           the new output is right.
+#   lockstep
+#           Print PASS or FAIL for each story as run by lockstep.sh under
+#           dfrotz and under other, which is "dfrotz -U" unless given and
+#           may be another build or have options of its own.  A FAIL
+#           comes with the first instruction at which the two parted.
+#   fuzz    Fuzz each story with dfrotz -z for $FUZZ_RUNS runs (2000 unless
+#           set), starting from its input, and print PASS with the runs
+#           made per second, or FAIL if the interpreter crashed.  zfuzz,
+#           built by "make zfuzz", sees coverage of its C code as well.
+#
+# The transcripts of failing stories are left in a temporary directory
+# so that they can be compared with a good build.
+
+STORIES="crashme etude gntests praxix random strictz unicode"
+
+mode=${1:-test}
+dfrotz=${2:-./dfrotz}
+other=${3:-"$dfrotz -U"}
+runs=${RUNS:-3}
+fuzz_runs=${FUZZ_RUNS:-2000}
+testdir=$(cd "$(dirname "$0")" && pwd)
+
+case $mode in
+test|update|lockstep|fuzz) runs=1 ;;
+bench) ;;
+*)
+	echo "usage: $0 test|bench|update [dfrotz]" >&2
+	echo "       $0 lockstep [dfrotz [other]]" >&2
+	echo "       $0 fuzz [dfrotz]" >&2
+	exit 2
+	;;
+esac
+
+case $dfrotz in
+/*) ;;
+*) dfrotz=$(pwd)/$dfrotz ;;
+esac
+if [ ! -x "$dfrotz" ]; then
+	echo "$0: no dfrotz at $dfrotz" >&2
+	exit 2
+fi
+
+# The story file and extra options for each story.  crashme runs random
+# code until the seed makes it hit a fatal error, so no errors are
+# reported on the way; strictz is there to report errors, so all are.
+story_file() {
+	case $1 in
+	etude) echo etude/etude.z5 ;;
+	*) echo $1.z5 ;;
+	esac
+}
+
+story_options() {
+	case $1 in
+	crashme) echo "-Z 0" ;;
+	strictz) echo "-Z 2" ;;
+	esac
+}
+
+work=$(mktemp -d "${TMPDIR:-/tmp}/frotz-test.XXXXXX") || exit 2
+failed=0
+new_golden=
+
+for story in $STORIES; do
+	file=$(story_file $story)
+	best=
+
+	if [ $mode = lockstep ]; then
+		if sh "$testdir/lockstep.sh" -i "$testdir/input/$story.in" \
+			-o "$(story_options $story)" "$dfrotz" "$other" \
+			"$testdir/$file" > "$work/$story.lockstep"; then
+			echo "PASS $story"
+			rm -f "$work/$story.lockstep"
+		else
+			echo "FAIL $story"
+			sed 's/^/  /' "$work/$story.lockstep"
+			failed=1
+		fi
+		continue
+	fi
+
+	if [ $mode = fuzz ]; then
+		rm -rf "$work/$story"
+		mkdir -p "$work/$story/corpus"
+		cp "$testdir/$file" "$work/$story/"
+		cp "$testdir/input/$story.in" "$work/$story/corpus/"
+		if (cd "$work/$story" &&
+		    "$dfrotz" -m -w 80 -h 24 $(story_options $story) \
+			-z corpus -j $fuzz_runs $(basename $file) \
+			> output 2> errors) &&
+		   [ -z "$(ls "$work/$story" | grep '^crash-')" ]; then
+			echo "PASS $story ($(awk '$2 == "DONE" { print $NF }' \
+				"$work/$story/errors") runs/s)"
+			rm -rf "$work/$story"
+		else
+			echo "FAIL $story"
+			tail -n 3 "$work/$story/errors" | sed 's/^/  /'
+			failed=1
+		fi
+		continue
+	fi
+
+	run=0
+	while [ $run -lt $runs ]; do
+		run=$((run + 1))
+
+		# Run from a directory of its own, so that the story is
+		# loaded by a name that does not depend on where the
+		# tree is, and any files it writes go nowhere.
+		rm -rf "$work/$story"
+		mkdir "$work/$story"
+		cp "$testdir/$file" "$work/$story/"
+		(cd "$work/$story" &&
+		 "$dfrotz" -m -w 80 -h 24 -s 1 -M stats \
+			$(story_options $story) $(basename $file) \
+			< "$testdir/input/$story.in" > output 2> errors
+		 echo "[exit $?]" >> output)
+
+		crc=$(cksum < "$work/$story/output" | awk '{ print $1 }')
+		stats=$(awk '{ printf "%s ", $2 }' "$work/$story/stats")
+		if [ -z "$best" ] ||
+		   awk -v a="$stats" -v b="$best" \
+			'BEGIN { split(a, x); split(b, y); exit !(x[2] < y[2]) }'; then
+			best=$stats
+		fi
+	done
+
+	golden=$(awk -v s=$story '$1 == s { print $2 }' "$testdir/golden")
+	if [ "$crc" = "$golden" ]; then
+		result=PASS
+		rm -rf "$work/$story"
+	else
+		result=FAIL
+		failed=1
+	fi
+
+	case $mode in
+	test)
+		echo "$result $story"
+		;;
+	bench)
+		echo "$best" | awk -v s=$story -v r=$result '{
+			printf "{\"story\": \"%s\", \"instructions\": %s, ", s, $1
+			printf "\"seconds\": %s, ", $2
+			printf "\"ips\": %.0f, ", ($2 > 0 ? $1 / $2 : 0)
+			printf "\"max_rss_kb\": %s, ", $3
+			printf "\"output\": \"%s\"}\n", r == "PASS" ? "ok" : "wrong"
+		}'
+		;;
+	update)
+		new_golden="$new_golden$story $crc
+"
+		;;
+	esac
+done
+
+if [ $mode = update ]; then
+	printf "%s" "$new_golden" > "$testdir/golden"
+	echo "Wrote $testdir/golden"
+	rm -rf "$work"
+	exit 0
+fi
+
+if [ $failed -ne 0 ]; then
+	echo "Transcripts of failing stories are in $work" >&2
+	exit 1
+fi
+rmdir "$work"
+exit 0